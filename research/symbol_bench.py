@@ -0,0 +1,48 @@
+#!/usr/bin/env python
+
+# $Id$
+#
+# Symbol-heavy benchmark source for DASM.
+#
+# I wrote this to see what the layout of SYMBOL costs us. The
+# generated source defines lots of labels and equates (most of
+# them with short names, some with long ones), references them
+# from everywhere, and uses enough forward references to need
+# a few passes. So we spend most of our time in find_symbol()
+# and friends, not in the mnemonic tables.
+#
+# Usage: python symbol_bench.py [symbols] > bench.asm
+#        time dasm bench.asm -f3 -obench.bin
+#
+# The default of 20000 symbols makes a source of about 100000
+# lines; that's bigger than anything real, which is the point.
+
+import random
+import sys
+
+def name(i):
+    # mostly short names like real sources, every 8th is long
+    if i % 8 == 7:
+        return "a_rather_long_symbol_name_number_%d" % i
+    return "s%d" % i
+
+def main(count):
+    random.seed(73)
+    out = sys.stdout
+    out.write("\tprocessor 6502\n")
+    out.write("\torg $1000\n")
+    for i in range(count):
+        # forward references to symbols defined later on
+        later = name(min(count - 1, i + random.randint(1, 64)))
+        out.write("%s\tsubroutine\n" % name(i))
+        out.write("\tlda %s\n" % later)
+        out.write("\tsta %s+1\n" % name(random.randint(0, i)))
+        out.write("\tldx %s_equ\n" % name(random.randint(0, i) & ~3))
+        out.write(".loop\tdex\n")
+        out.write("\tbne .loop\n")
+        if i % 4 == 0:
+            out.write("%s_equ\tequ (%s-%s) & $7f\n" % (name(i), later, name(i)))
+    out.write("\trts\n")
+
+if __name__ == "__main__":
+    main(int(sys.argv[1]) if len(sys.argv) > 1 else 20000)
@@ -0,0 +1,547 @@
+/*
+    $Id$
+
+    the DASM macro assembler (aka small systems cross assembler)
+
+    Copyright (c) 1988-2002 by Matthew Dillon.
+    Copyright (c) 1995 by Olaf "Rhialto" Seibert.
+    Copyright (c) 2003-2008 by Andrew Davie.
+    Copyright (c) 2008 by Peter H. Froehlich.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/**
+ * @file
+ */
+
+#include "addrmap.h"
+
+#include "dalloc.h"
+#include "errors.h"
+#include "files.h"
+#include "util.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+/* An instruction or data directive that generated bytes. */
+typedef struct
+{
+    unsigned long address;
+    unsigned long rorg; /* ADDRMAP_NONE if none */
+    size_t length;
+    size_t data; /* offset into bytes */
+    size_t segment; /* offset into strings */
+    size_t file; /* offset into strings */
+    unsigned long line;
+    size_t frame; /* index into frames, or ADDRMAP_NONE */
+}
+ENTRY;
+
+/* A macro or REPEAT being expanded, see intern_context(). */
+typedef struct
+{
+    size_t name; /* offset into strings */
+    unsigned long line;
+    unsigned long iteration; /* ADDRMAP_NONE for a macro */
+    size_t parent; /* index into frames, or ADDRMAP_NONE */
+}
+FRAME;
+
+/* Where a symbol was defined. */
+typedef struct
+{
+    const SYMBOL *symbol;
+    size_t file; /* offset into strings */
+    unsigned long line;
+    size_t frame; /* index into frames, or ADDRMAP_NONE */
+}
+DEFINITION;
+
+static const char *map_name = NULL;
+static const char *index_name = NULL;
+
+static ARRAY entries;
+static ARRAY frames;
+static ARRAY bytes;
+static ARRAY strings;
+static ARRAY definitions;
+
+/* Index + 1 into definitions by symbol number, 0 if not defined. */
+static ARRAY defined;
+
+/*
+  Hash tables for strings and frames we have already, open
+  addressing; a slot holds an offset or index + 1, 0 if empty.
+*/
+static size_t *string_slots = NULL;
+static size_t nof_string_slots = 0;
+static size_t *frame_slots = NULL;
+static size_t nof_frame_slots = 0;
+
+void set_address_map(const char *name)
+{
+    assert(name != NULL);
+    map_name = name;
+}
+
+void set_address_index(const char *name)
+{
+    assert(name != NULL);
+    index_name = name;
+}
+
+static bool map_needed(void)
+{
+    return map_name != NULL || index_name != NULL;
+}
+
+void begin_map_pass(void)
+{
+    const DEFINITION *definition = definitions.items;
+
+    for (size_t i = 0; i < definitions.count; i++, definition++) {
+        ((size_t *) defined.items)[definition->symbol->number] = 0;
+    }
+    definitions.count = 0;
+
+    entries.count = 0;
+    frames.count = 0;
+    bytes.count = 0;
+    strings.count = 0;
+    if (string_slots != NULL) {
+        memset(string_slots, 0, nof_string_slots * sizeof(size_t));
+    }
+    if (frame_slots != NULL) {
+        memset(frame_slots, 0, nof_frame_slots * sizeof(size_t));
+    }
+}
+
+/* Table with twice the slots, everything in it hashed again. */
+static size_t *rehash(size_t *slots, size_t *nof_slots, size_t (*hash)(size_t item))
+{
+    size_t nof_old = *nof_slots;
+    size_t *old = slots;
+
+    *nof_slots = (nof_old == 0) ? 256 : 2 * nof_old;
+    slots = dalloc(*nof_slots * sizeof(size_t));
+    for (size_t i = 0; i < nof_old; i++) {
+        if (old[i] != 0) {
+            size_t slot = hash(old[i] - 1) & (*nof_slots - 1);
+            while (slots[slot] != 0) {
+                slot = (slot + 1) & (*nof_slots - 1);
+            }
+            slots[slot] = old[i];
+        }
+    }
+    dfree(old);
+
+    return slots;
+}
+
+static size_t hash_stored_string(size_t offset)
+{
+    const char *s = (const char *) strings.items + offset;
+    return (size_t) hash_bytes(HASH_BYTES_INIT, s, strlen(s));
+}
+
+/* Offset of s in strings, added if it isn't there yet. */
+static size_t intern_string(const char *s)
+{
+    size_t length = strlen(s);
+    size_t hash = (size_t) hash_bytes(HASH_BYTES_INIT, s, length);
+    size_t slot;
+    size_t offset;
+
+    /* keep the table at most half full */
+    if (2 * (strings.count + 1) > nof_string_slots) {
+        string_slots = rehash(string_slots, &nof_string_slots, hash_stored_string);
+    }
+
+    for (slot = hash & (nof_string_slots - 1); string_slots[slot] != 0;
+         slot = (slot + 1) & (nof_string_slots - 1)) {
+        offset = string_slots[slot] - 1;
+        if (strcmp((const char *) strings.items + offset, s) == 0) {
+            return offset;
+        }
+    }
+
+    offset = strings.count;
+    memcpy(array_extend(&strings, length + 1, 1), s, length + 1);
+    string_slots[slot] = offset + 1;
+    return offset;
+}
+
+static size_t hash_frame(const FRAME *frame)
+{
+    uint64_t hash = HASH_BYTES_INIT;
+    hash = hash_bytes(hash, &frame->name, sizeof(frame->name));
+    hash = hash_bytes(hash, &frame->line, sizeof(frame->line));
+    hash = hash_bytes(hash, &frame->iteration, sizeof(frame->iteration));
+    hash = hash_bytes(hash, &frame->parent, sizeof(frame->parent));
+    return (size_t) hash;
+}
+
+static size_t hash_stored_frame(size_t index)
+{
+    return hash_frame((const FRAME *) frames.items + index);
+}
+
+/* Index of the frame, added if it isn't there yet. */
+static size_t intern_frame(const FRAME *frame)
+{
+    size_t slot;
+    size_t index;
+
+    if (2 * (frames.count + 1) > nof_frame_slots) {
+        frame_slots = rehash(frame_slots, &nof_frame_slots, hash_stored_frame);
+    }
+
+    for (slot = hash_frame(frame) & (nof_frame_slots - 1); frame_slots[slot] != 0;
+         slot = (slot + 1) & (nof_frame_slots - 1)) {
+        const FRAME *other = (const FRAME *) frames.items + frame_slots[slot] - 1;
+        if (other->name == frame->name && other->line == frame->line
+            && other->iteration == frame->iteration && other->parent == frame->parent) {
+            return frame_slots[slot] - 1;
+        }
+    }
+
+    index = frames.count;
+    *(FRAME *) array_extend(&frames, 1, sizeof(FRAME)) = *frame;
+    frame_slots[slot] = index + 1;
+    return index;
+}
+
+static size_t add_frame(const char *name, unsigned long line, unsigned long iteration,
+                        size_t parent)
+{
+    FRAME frame;
+
+    frame.name = intern_string(name);
+    frame.line = line;
+    frame.iteration = iteration;
+    frame.parent = parent;
+    return intern_frame(&frame);
+}
+
+/* Frames for the REPEATs from rp on that are in inc, outermost first. */
+static size_t intern_repeats(const REPLOOP *rp, const INCFILE *inc, size_t parent)
+{
+    if (rp == NULL) {
+        return parent;
+    }
+
+    parent = intern_repeats(rp->next, inc, parent);
+    if (rp->file == inc) {
+        parent = add_frame(inc->name, rp->lineno, rp->total - rp->count, parent);
+    }
+    return parent;
+}
+
+/*
+  Innermost frame for the macros and REPEATs being expanded in inc
+  and the files below it: REPEATs are inside whatever they are in,
+  so a macro's frame comes before the frames of REPEATs in its body.
+*/
+static size_t intern_context(const INCFILE *inc)
+{
+    size_t parent;
+
+    if (inc == NULL) {
+        return ADDRMAP_NONE;
+    }
+
+    parent = intern_context(inc->next);
+    if ((inc->flags & INF_MACRO) != 0) {
+        parent = add_frame(inc->name, inc->lineno, ADDRMAP_NONE, parent);
+    }
+    return intern_repeats(Reploop, inc, parent);
+}
+
+void map_append(unsigned long org, const unsigned char *data, size_t length)
+{
+    ENTRY *entry;
+    size_t file;
+    unsigned long line;
+    bool known;
+
+    if (!map_needed() || length == 0) {
+        return;
+    }
+
+    assert(data != NULL);
+
+    known = current_source_line(&file, &line);
+
+    entry = array_extend(&entries, 1, sizeof(ENTRY));
+    entry->address = org;
+    entry->rorg = ((Csegment->flags & SF_RORG) != 0) ? Csegment->rorg : ADDRMAP_NONE;
+    entry->length = length;
+    entry->segment = intern_string(Csegment->name);
+    entry->file = intern_string(known ? source_file_name(file) : "");
+    entry->line = known ? line : 0;
+    entry->frame = intern_context(pIncfile);
+    entry->data = bytes.count;
+    memcpy(array_extend(&bytes, length, 1), data, length);
+}
+
+void map_symbol(const SYMBOL *sym)
+{
+    DEFINITION *definition;
+    size_t *slots;
+    size_t file;
+    unsigned long line;
+
+    assert(sym != NULL);
+
+    /* -D and -M options define symbols before there's a source */
+    if (!map_needed() || !current_source_line(&file, &line)) {
+        return;
+    }
+
+    if (defined.count <= sym->number) {
+        size_t more = sym->number + 1 - defined.count;
+        memset(array_extend(&defined, more, sizeof(size_t)), 0, more * sizeof(size_t));
+    }
+    slots = defined.items;
+    if (slots[sym->number] != 0) {
+        return;
+    }
+
+    definition = array_extend(&definitions, 1, sizeof(DEFINITION));
+    definition->symbol = sym;
+    definition->file = intern_string(source_file_name(file));
+    definition->line = line;
+    definition->frame = intern_context(pIncfile);
+    slots[sym->number] = definitions.count;
+}
+
+/*
+  Macro frames from the outermost to frame, REPEATs left out; true
+  if there were any.
+*/
+static bool put_json_frames(size_t frame, FILE *out)
+{
+    const FRAME *f;
+    bool any;
+
+    if (frame == ADDRMAP_NONE) {
+        return false;
+    }
+
+    f = (const FRAME *) frames.items + frame;
+    any = put_json_frames(f->parent, out);
+    if (f->iteration != ADDRMAP_NONE) {
+        return any;
+    }
+    if (any) {
+        putc(',', out);
+    }
+    fputs("{\"name\":", out);
+    put_json_string((const char *) strings.items + f->name, out);
+    fprintf(out, ",\"line\":%lu}", f->line);
+    return true;
+}
+
+static void write_json(FILE *out)
+{
+    static const char digits[] = "0123456789abcdef";
+    const ENTRY *entry = entries.items;
+    const unsigned char *data = bytes.items;
+
+    for (size_t i = 0; i < entries.count; i++, entry++) {
+        fprintf(out, "{\"address\":%lu,\"rorg\":", entry->address);
+        if (entry->rorg != ADDRMAP_NONE) {
+            fprintf(out, "%lu", entry->rorg);
+        }
+        else {
+            fputs("null", out);
+        }
+        fputs(",\"segment\":", out);
+        put_json_string((const char *) strings.items + entry->segment, out);
+        fputs(",\"bytes\":\"", out);
+        for (size_t j = 0; j < entry->length; j++) {
+            putc(digits[data[entry->data + j] >> 4], out);
+            putc(digits[data[entry->data + j] & 0x0F], out);
+        }
+        fputs("\",\"file\":", out);
+        put_json_string((const char *) strings.items + entry->file, out);
+        fprintf(out, ",\"line\":%lu,\"macros\":[", entry->line);
+        (void) put_json_frames(entry->frame, out);
+        fputs("]}\n", out);
+    }
+}
+
+static void put_long(unsigned long value, FILE *out)
+{
+    unsigned char b[4] = {
+        value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF, (value >> 24) & 0xFF
+    };
+    (void) fwrite(b, sizeof(b), 1, out);
+}
+
+/* Sort by address, keep the order they were generated in otherwise. */
+static int compare_entries(const void *a, const void *b)
+{
+    const ENTRY *entry = entries.items;
+    size_t i = *(const size_t *) a;
+    size_t j = *(const size_t *) b;
+
+    if (entry[i].address != entry[j].address) {
+        return (entry[i].address < entry[j].address) ? -1 : 1;
+    }
+    return (i < j) ? -1 : (i > j);
+}
+
+/* Sort by name, they are all different. */
+static int compare_definitions(const void *a, const void *b)
+{
+    const DEFINITION *d = a;
+    const DEFINITION *e = b;
+
+    return strcmp(d->symbol->name, e->symbol->name);
+}
+
+static unsigned long symbol_flags(const SYMBOL *sym)
+{
+    unsigned long flags = 0;
+
+    if ((sym->flags & SYM_UNKNOWN) != 0) {
+        flags |= ADDRMAP_SYM_UNKNOWN;
+    }
+    if ((sym->flags & SYM_STRING) != 0) {
+        flags |= ADDRMAP_SYM_STRING;
+    }
+    if ((sym->flags & SYM_SET) != 0) {
+        flags |= ADDRMAP_SYM_SET;
+    }
+    return flags;
+}
+
+static void write_index(FILE *out)
+{
+    const ENTRY *entry = entries.items;
+    const FRAME *frame;
+    const DEFINITION *definition;
+    size_t *order = dalloc((entries.count + 1) * sizeof(size_t));
+    size_t *names = dalloc((definitions.count + 1) * sizeof(size_t));
+    unsigned long frames_at;
+    unsigned long symbols_at;
+    unsigned long strings_at;
+    unsigned long data_at;
+
+    for (size_t i = 0; i < entries.count; i++) {
+        order[i] = i;
+    }
+    qsort(order, entries.count, sizeof(size_t), compare_entries);
+
+    /* all strings have to be in before we know where the data goes */
+    if (definitions.count > 0) {
+        qsort(definitions.items, definitions.count, sizeof(DEFINITION), compare_definitions);
+    }
+    definition = definitions.items;
+    for (size_t i = 0; i < definitions.count; i++) {
+        names[i] = intern_string(definition[i].symbol->name);
+    }
+
+    frames_at = ADDRMAP_HEADER + entries.count * ADDRMAP_ENTRY;
+    symbols_at = frames_at + frames.count * ADDRMAP_FRAME;
+    strings_at = symbols_at + definitions.count * ADDRMAP_SYMBOL;
+    data_at = strings_at + strings.count;
+
+    (void) fwrite(ADDRMAP_MAGIC, 4, 1, out);
+    put_long(ADDRMAP_VERSION, out);
+    put_long(entries.count, out);
+    put_long(frames.count, out);
+    put_long(frames_at, out);
+    put_long(definitions.count, out);
+    put_long(symbols_at, out);
+    put_long(strings_at, out);
+    put_long(data_at, out);
+    put_long(0, out);
+
+    for (size_t i = 0; i < entries.count; i++) {
+        const ENTRY *e = &entry[order[i]];
+        put_long(e->address, out);
+        put_long(e->length, out);
+        put_long(e->rorg, out);
+        put_long(e->segment, out);
+        put_long(e->file, out);
+        put_long(e->line, out);
+        put_long(e->frame, out);
+        put_long(e->data, out);
+    }
+
+    frame = frames.items;
+    for (size_t i = 0; i < frames.count; i++) {
+        put_long(frame[i].name, out);
+        put_long(frame[i].line, out);
+        put_long(frame[i].iteration, out);
+        put_long(frame[i].parent, out);
+    }
+
+    for (size_t i = 0; i < definitions.count; i++) {
+        put_long(names[i], out);
+        put_long((unsigned long) definition[i].symbol->value, out);
+        put_long(symbol_flags(definition[i].symbol), out);
+        put_long(definition[i].file, out);
+        put_long(definition[i].line, out);
+        put_long(definition[i].frame, out);
+    }
+
+    /* nothing was ever added if the count is 0, items are NULL then */
+    if (strings.count > 0) {
+        (void) fwrite(strings.items, 1, strings.count, out);
+    }
+    if (bytes.count > 0) {
+        (void) fwrite(bytes.items, 1, bytes.count, out);
+    }
+
+    dfree(names);
+    dfree(order);
+}
+
+static void write_map(const char *name, void (*write)(FILE *out))
+{
+    FILE *out;
+
+    if (name == NULL) {
+        return;
+    }
+
+    out = create_output(name);
+    if (out == NULL) {
+        error_fmt("Unable to open address map '%s'.", name);
+        return;
+    }
+    write(out);
+    if (ferror(out)) {
+        error_fmt("Problem writing address map '%s'.", name);
+        (void) finish_output(out, false);
+        return;
+    }
+    if (!finish_output(out, true)) {
+        warning_fmt("Problem closing address map '%s'.", name);
+    }
+}
+
+void write_address_maps(void)
+{
+    write_map(map_name, write_json);
+    write_map(index_name, write_index);
+}
+
+/* vim: set tabstop=4 softtabstop=4 expandtab shiftwidth=4 autoindent: */
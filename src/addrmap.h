@@ -0,0 +1,149 @@
+#ifndef _DASM_ADDRMAP_H
+#define _DASM_ADDRMAP_H
+
+/*
+    $Id$
+
+    the DASM macro assembler (aka small systems cross assembler)
+
+    Copyright (c) 1988-2002 by Matthew Dillon.
+    Copyright (c) 1995 by Olaf "Rhialto" Seibert.
+    Copyright (c) 2003-2008 by Andrew Davie.
+    Copyright (c) 2008 by Peter H. Froehlich.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/**
+ * @file
+ *
+ * @brief Address maps, -a and -A options.
+ *
+ * Tools like debuggers and profilers want to know which source
+ * line generated which bytes; scraping the listing for that breaks
+ * whenever its layout changes. So we record one entry for every
+ * instruction or data directive that generates bytes in the final
+ * pass: address, relocatable address (if RORG is active), segment,
+ * the bytes, the file and line, and the macros being expanded.
+ *
+ * -a writes these as JSON lines, one object per entry in the order
+ * they were generated:
+ *
+ *   {"address":4096,"rorg":null,"segment":"CODE","bytes":"a905",
+ *    "file":"game.asm","line":12,"macros":[{"name":"load","line":2}]}
+ *
+ * file and line are the line in a source file the bytes came from;
+ * inside a macro that's where the (outermost) macro was used, and
+ * macros lists the macros being expanded, outermost first, with the
+ * line in each macro's body.
+ *
+ * -A writes the same entries as a binary index sorted by address,
+ * to be searched in place, along with what a source-level debugger
+ * needs besides: REPEAT loops around each entry next to its macros,
+ * and where each symbol was defined (see below).
+ */
+
+#include "asm.h"
+
+/*
+  Binary address index, all numbers 32 bits LSB first:
+
+    "DMAP" version count              header, 40 bytes
+    frame-count frame-offset
+    symbol-count symbol-offset
+    string-offset data-offset
+    pad (4 bytes)
+    address length rorg segment       entry, 32 bytes, count times,
+    file line frame data              sorted by address
+    name line iteration parent        frame, 16 bytes,
+                                      frame-count times
+    name value flags                  symbol, 24 bytes,
+    file line frame                   symbol-count times, sorted
+                                      by name
+    strings                           '\0' terminated
+    data                              the bytes of all entries
+
+  Entries come right after the header, so entry i is at 40 + 32 * i
+  and a binary search finds the entries for an address without
+  reading the rest; symbols can be searched by name the same way.
+  rorg is ADDRMAP_NONE if RORG wasn't active; segment, file, and
+  name are offsets into the strings; data is an offset into the
+  data.
+
+  frame is the innermost macro or REPEAT being expanded (or
+  ADDRMAP_NONE), and parent links each frame to the one around it.
+  A macro frame has iteration ADDRMAP_NONE, name is the macro and
+  line the line in its body; a REPEAT frame has the iteration,
+  counting from 0, name is the file or macro the REPEAT is in and
+  line where it is.
+
+  There's a symbol for every label, EQU, SET, and EQM the final pass
+  went through; file, line, and frame are where it was defined first
+  and value is its final value, as in the symbol file. Symbols only
+  defined on the command line aren't included. flags are the
+  ADDRMAP_SYM_* bits below.
+*/
+#define ADDRMAP_MAGIC "DMAP"
+#define ADDRMAP_VERSION 1
+#define ADDRMAP_HEADER 40
+#define ADDRMAP_ENTRY 32
+#define ADDRMAP_FRAME 16
+#define ADDRMAP_SYMBOL 24
+#define ADDRMAP_NONE 0xFFFFFFFFUL
+
+#define ADDRMAP_SYM_UNKNOWN 0x01 /* value not known */
+#define ADDRMAP_SYM_STRING 0x02 /* a string, value means nothing */
+#define ADDRMAP_SYM_SET 0x04 /* defined with SET, may change */
+
+/**
+ * @brief Write the address map as JSON lines to the named file at
+ * the end, -a option.
+ */
+void set_address_map(const char *name);
+
+/**
+ * @brief Write the binary address index to the named file at the
+ * end, -A option.
+ */
+void set_address_index(const char *name);
+
+/**
+ * @brief Start a new pass, call at the start of every pass;
+ * forgets what the previous pass generated.
+ */
+void begin_map_pass(void);
+
+/**
+ * @brief Remember that the current line generated the given bytes
+ * at org in the current segment.
+ * @note Does nothing unless some address map was requested.
+ */
+void map_append(unsigned long org, const unsigned char *data, size_t length);
+
+/**
+ * @brief Remember that the current line defined sym; only the first
+ * definition in a pass counts.
+ * @note Does nothing unless some address map was requested.
+ */
+void map_symbol(const SYMBOL *sym);
+
+/**
+ * @brief Write the address maps requested, after the final pass.
+ */
+void write_address_maps(void);
+
+#endif /* _DASM_ADDRMAP_H */
+
+/* vim: set tabstop=4 softtabstop=4 expandtab shiftwidth=4 autoindent: */
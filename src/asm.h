@@ -35,6 +35,7 @@
 
 #include "platform.h"
 
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -63,6 +64,9 @@ enum FORMAT
     FORMAT_DEFAULT = 1,
     FORMAT_RAS,
     FORMAT_RAW,
+    FORMAT_HEX, /* Intel HEX, written from the image */
+    FORMAT_SREC, /* Motorola S-records, written from the image */
+    FORMAT_RASX, /* extended RAS, written from the image */
     FORMAT_MAX
 };
 
@@ -93,7 +97,8 @@ typedef int dasm_flag_t;
         REASON_IF_NOT_RESOLVED = 1 << 11,
         REASON_REPEAT_NOT_RESOLVED = 1 << 12,
         REASON_FORWARD_REFERENCE = 1 << 13,
-        REASON_PHASE_ERROR = 1 << 14
+        REASON_PHASE_ERROR = 1 << 14,
+        REASON_INCBIN_NOT_RESOLVED = 1 << 15
     };
 
 
@@ -191,6 +196,9 @@ struct _STRLIST
   the reason (they share the same hashtable!).
 */
 
+/* Most addressing modes any one mnemonic supports. */
+#define MAX_OPCODES 8
+
 typedef struct _MNEMONIC MNEMONIC;
 struct _MNEMONIC
 {
@@ -203,11 +211,16 @@ struct _MNEMONIC
     /* special flags */
     dasm_flag_t flags;
     /* addressing modes ok for this mnemonic? see badcode() macro [phf] */
-    unsigned long okmask;
-    /* hex codes, byte or word (>xFF) opcodes */
-    unsigned int opcode[NUMOC];
+    uint32_t okmask;
+    /*
+      hex codes, byte or word (>xFF) opcodes, only for the addressing
+      modes in okmask and in the same order; see mnemonic_opcode()
+    */
+    uint16_t opcode[MAX_OPCODES];
 };
 
+unsigned int mnemonic_opcode(const MNEMONIC *mne, address_mode_t am);
+
 /* MNEMONIC with all fields 0, used as end-of-table marker. */
 #define MNEMONIC_NULL {NULL, NULL, NULL, 0, 0, {0,}}
 
@@ -266,8 +279,10 @@ struct _REPLOOP
 {
     /* previously pushed context */
     REPLOOP *next;
-    /* repeat count */
+    /* repeat count, what's left of it */
     unsigned long count;
+    /* repeat count we started with */
+    unsigned long total;
     /* seek to top of repeat */
     unsigned long seek;
     /* line number of line before */
@@ -306,8 +321,12 @@ struct _SEGMENT
 {
     /* next segment in segment list */
     SEGMENT *next;
+    /* next segment in hash chain, see find_segment() */
+    SEGMENT *hnext;
     /* name of segment */
     char *name;
+    /* order of creation from 0, index for tables by segment */
+    size_t number;
     /* for ORG */
     dasm_flag_t flags;
     /* for RORG */
@@ -330,23 +349,39 @@ struct _SEGMENT
 #define SYM_MACRO   0x20    /*      symbol is a macro    */
 #define SYM_MASREF  0x40    /*      master reference    */
 
+/* Names shorter than this are stored right inside the SYMBOL. */
+#define SYMBOL_SHORT_NAME 16
+
+/* SYMBOL.number of the special symbols find_symbol() makes up, "." and friends */
+#define SYMBOL_SPECIAL UINT32_MAX
+
+/*
+  Everything find_symbol() and eval() touch fits into one 64 byte
+  cache line (together with the dalloc() header), including short
+  names; stuff only needed between passes lives in parallel arrays
+  in symbols.c indexed by the symbol's number.
+*/
 typedef struct _SYMBOL SYMBOL;
 struct _SYMBOL
 {
     /* next symbol in hash list */
     SYMBOL *next;
-    /* symbol name or string if expr. */
+    /* current value, never EVER change this to unsigned! [phf] */
+    long value;
+    /* symbol name, points to short_name unless it's a long name */
     char *name;
     /* if symbol is actually a string */
     char *string;
-    /* flags */
-    dasm_flag_t flags;
-    /* addressing mode (expressions) */
-    address_mode_t addrmode;
-    /* current value, never EVER change this to unsigned! [phf] */
-    long value;
-    /* name length */
-    size_t namelen;
+    /* name length, at most MAX_SYM_LEN */
+    uint16_t namelen;
+    /* flags, only SYM_* bits */
+    uint8_t flags;
+    /* addressing mode (expressions), an address_mode_t */
+    uint8_t addrmode;
+    /* number of the symbol in creation order, see create_symbol(), or SYMBOL_SPECIAL */
+    uint32_t number;
+    /* storage for short names, see SYMBOL_SHORT_NAME */
+    char short_name[SYMBOL_SHORT_NAME];
 };
 
 extern MNEMONIC    *MHash[];
@@ -392,12 +427,12 @@ extern int   F_format;
 extern int F_verbose;
 extern const char    *F_outfile;
 /*@null@*/ extern char    *F_listfile;
-/*@null@*/ extern FILE    *FI_listfile;
 extern FILE    *FI_temp;
 extern bool Fisclear;
 extern unsigned long Plab;
 extern dasm_flag_t Pflags;
 extern bool    ListMode;
+extern bool    Echoed;
 
 extern unsigned long  CheckSum;
 
@@ -414,6 +449,9 @@ extern    int Glen;
 void    v_mexit(const char *str, MNEMONIC *);
 void    closegenerate(void);
 void    generate(void);
+void    generate_from(const unsigned char *data, size_t length);
+SEGMENT *find_segment(const char *name);
+SEGMENT *new_segment(const char *name, bool bss);
 
 void v_list(const char *, MNEMONIC *);
 void v_include(const char *, MNEMONIC *);
@@ -449,7 +487,6 @@ void v_incdir(const char *, MNEMONIC *);
 void v_execmac(const char *str, MACRO *mac);
 void v_mnemonic(const char *str, MNEMONIC *mne);
 
-FILE *pfopen(const char *, const char *);
 
 
 /* exp.c */
@@ -0,0 +1,460 @@
+/*
+    $Id$
+
+    the DASM macro assembler (aka small systems cross assembler)
+
+    Copyright (c) 1988-2002 by Matthew Dillon.
+    Copyright (c) 1995 by Olaf "Rhialto" Seibert.
+    Copyright (c) 2003-2008 by Andrew Davie.
+    Copyright (c) 2008 by Peter H. Froehlich.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/**
+ * @file
+ */
+
+#if defined(__WINDOWS__) || defined(_WIN32) || defined(_WIN64)
+#	include <direct.h>
+#	define getcwd _getcwd
+#else
+	/* getcwd(3) */
+#	define _POSIX_C_SOURCE 200809L
+#	include <unistd.h>
+#endif
+
+#include "cache.h"
+
+#include "dalloc.h"
+#include "files.h"
+#include "util.h"
+#include "version.h"
+
+#include <assert.h>
+
+/*
+  Cache files, both named by a key in hex:
+
+    <run key>.m       manifest, one line per path we tried:
+                        + <sha256 of contents> <path>
+                        - <path>
+    <result key>.r    outputs, for each one:
+                        <size> <name>
+                        <size bytes of contents>
+
+  The result key is the SHA-256 of the run key and the manifest,
+  so different inputs never share a result. A run stores its
+  result before the manifest that leads to it, both replaced in
+  one step by create_output(); readers never see half of either.
+*/
+#define CACHE_MAGIC "DASM cache 1\n"
+
+#define KEY_HEX (2 * SHA256_DIGEST)
+
+/* Cache directory, -C option. */
+static const char *cache_directory = NULL;
+
+/* Key for this run, valid if have_run_key. */
+static unsigned char run_key[SHA256_DIGEST];
+static bool have_run_key = false;
+
+void set_cache_directory(const char *dir)
+{
+    assert(dir != NULL);
+
+    cache_directory = dir;
+}
+
+static void key_to_hex(const unsigned char key[SHA256_DIGEST], char hex[KEY_HEX + 1])
+{
+    for (size_t i = 0; i < SHA256_DIGEST; i++) {
+        sprintf(hex + 2 * i, "%02x", key[i]);
+    }
+}
+
+/* Name of a cache file, dfree() it when done. */
+static char *cache_file(const unsigned char key[SHA256_DIGEST], const char *suffix)
+{
+    size_t size = strlen(cache_directory) + 1 + KEY_HEX + strlen(suffix) + 1;
+    char *name = dalloc(size);
+    char hex[KEY_HEX + 1];
+
+    key_to_hex(key, hex);
+    (void) strlcpy(name, cache_directory, size);
+    if (name[0] != '\0' && name[strlen(name) - 1] != '/') {
+        (void) strlcat(name, "/", size);
+    }
+    (void) strlcat(name, hex, size);
+    (void) strlcat(name, suffix, size);
+    return name;
+}
+
+/* Hash string including its '\0', so "ab" "c" differs from "a" "bc". */
+static void hash_string_z(SHA256 *sha, const char *s)
+{
+    sha256_update(sha, s, strlen(s) + 1);
+}
+
+/* SHA-256 of the contents of the named file, false if unreadable. */
+static bool hash_file(const char *path, unsigned char digest[SHA256_DIGEST])
+{
+    enum { CHUNK = 65536 };
+    static unsigned char *buffer = NULL;
+    SHA256 sha;
+    size_t n;
+    bool ok;
+    FILE *f = fopen(path, "rb");
+
+    if (f == NULL) {
+        return false;
+    }
+
+    if (buffer == NULL) {
+        buffer = dalloc(CHUNK);
+    }
+    sha256_init(&sha);
+    while ((n = fread(buffer, 1, CHUNK, f)) > 0) {
+        sha256_update(&sha, buffer, n);
+    }
+    ok = !ferror(f);
+    (void) fclose(f);
+
+    sha256_final(&sha, digest);
+    return ok;
+}
+
+/* All of the named file, NULL if unreadable; dfree() it when done. */
+static unsigned char *read_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    unsigned char *data;
+    long length;
+
+    if (f == NULL) {
+        return NULL;
+    }
+    if (fseek(f, 0, SEEK_END) != 0 || (length = ftell(f)) < 0 || fseek(f, 0, SEEK_SET) != 0) {
+        (void) fclose(f);
+        return NULL;
+    }
+
+    /* one more so there's always a '\0' after the contents */
+    data = dalloc((size_t) length + 1);
+    if (fread(data, 1, (size_t) length, f) != (size_t) length) {
+        (void) fclose(f);
+        dfree(data);
+        return NULL;
+    }
+    (void) fclose(f);
+
+    *size = (size_t) length;
+    return data;
+}
+
+static void result_key(const unsigned char *manifest, size_t size,
+                       unsigned char key[SHA256_DIGEST])
+{
+    SHA256 sha;
+
+    sha256_init(&sha);
+    sha256_update(&sha, run_key, sizeof(run_key));
+    sha256_update(&sha, manifest, size);
+    sha256_final(&sha, key);
+}
+
+/* Does every path in the manifest still look the way it says? */
+static bool manifest_holds(unsigned char *manifest, size_t size)
+{
+    unsigned char *line = manifest;
+    unsigned char *end = manifest + size;
+
+    while (line < end) {
+        unsigned char *eol = memchr(line, '\n', end - line);
+        char *path;
+
+        if (eol == NULL) {
+            return false;
+        }
+        *eol = '\0';
+
+        if (line[0] == '+' && line[1] == ' '
+            && eol - line > 3 + KEY_HEX && line[2 + KEY_HEX] == ' ') {
+            unsigned char digest[SHA256_DIGEST];
+            char hex[KEY_HEX + 1];
+            path = (char *) line + 3 + KEY_HEX;
+            if (!hash_file(path, digest)) {
+                return false;
+            }
+            key_to_hex(digest, hex);
+            if (memcmp(hex, line + 2, KEY_HEX) != 0) {
+                return false;
+            }
+        }
+        else if (line[0] == '-' && line[1] == ' ') {
+            FILE *f;
+            path = (char *) line + 2;
+            if ((f = fopen(path, "rb")) != NULL) {
+                (void) fclose(f);
+                return false;
+            }
+        }
+        else {
+            return false;
+        }
+
+        *eol = '\n';
+        line = eol + 1;
+    }
+
+    return true;
+}
+
+/*
+  Walk the outputs in a result, writing them if write; false if the
+  result is damaged (or, if write, an output couldn't be written).
+*/
+static bool walk_result(unsigned char *result, size_t size, bool write)
+{
+    size_t magic = strlen(CACHE_MAGIC);
+    unsigned char *at = result + magic;
+    unsigned char *end = result + size;
+
+    if (size < magic || memcmp(result, CACHE_MAGIC, magic) != 0) {
+        return false;
+    }
+
+    while (at < end) {
+        unsigned char *eol = memchr(at, '\n', end - at);
+        unsigned long length;
+        char *name;
+        bool ok;
+
+        if (eol == NULL) {
+            return false;
+        }
+        *eol = '\0';
+        length = strtoul((char *) at, &name, 10);
+        ok = (name != (char *) at && *name == ' ' && name[1] != '\0'
+              && length <= (size_t) (end - eol - 1));
+
+        if (ok && write) {
+            FILE *out = create_output(++name);
+            ok = (out != NULL)
+                && fwrite(eol + 1, 1, length, out) == length
+                && finish_output(out, true);
+            if (out != NULL && !ok) {
+                abandon_outputs();
+            }
+        }
+
+        *eol = '\n';
+        if (!ok) {
+            return false;
+        }
+        at = eol + 1 + length;
+    }
+
+    return true;
+}
+
+bool restore_from_cache(int argc, char **argv)
+{
+    SHA256 sha;
+    char cwd[4096];
+    char *name;
+    unsigned char *manifest;
+    unsigned char *result = NULL;
+    size_t manifest_size;
+    size_t result_size;
+    unsigned char key[SHA256_DIGEST];
+    bool hit = false;
+
+    assert(argc >= 2);
+    assert(argv != NULL);
+
+    if (cache_directory == NULL) {
+        return false;
+    }
+    if (getcwd(cwd, sizeof(cwd)) == NULL) {
+        /* relative paths could mean anything */
+        return false;
+    }
+
+    sha256_init(&sha);
+    hash_string_z(&sha, CACHE_MAGIC);
+    hash_string_z(&sha, DASM_ID);
+    hash_string_z(&sha, cwd);
+    for (int i = 1; i < argc; i++) {
+        hash_string_z(&sha, argv[i]);
+    }
+    sha256_final(&sha, run_key);
+    have_run_key = true;
+
+    name = cache_file(run_key, ".m");
+    manifest = read_file(name, &manifest_size);
+    dfree(name);
+    if (manifest == NULL) {
+        return false;
+    }
+
+    if (manifest_holds(manifest, manifest_size)) {
+        result_key(manifest, manifest_size, key);
+        name = cache_file(key, ".r");
+        result = read_file(name, &result_size);
+        dfree(name);
+    }
+
+    /* check all of it before we replace any outputs */
+    if (result != NULL && walk_result(result, result_size, false)) {
+        hit = walk_result(result, result_size, true);
+    }
+
+    dfree(result);
+    dfree(manifest);
+    return hit;
+}
+
+/* What store_in_cache() passes around while it writes. */
+typedef struct
+{
+    FILE *file;
+    SHA256 sha;
+    STRLIST *seen;
+    bool ok;
+}
+STORE;
+
+static void store_probe(const char *path, bool found, void *data)
+{
+    STORE *store = data;
+    char line[KEY_HEX + 4];
+
+    if (!store->ok) {
+        return;
+    }
+    if (strchr(path, '\n') != NULL) {
+        store->ok = false;
+        return;
+    }
+
+    if (found) {
+        unsigned char digest[SHA256_DIGEST];
+        if (!hash_file(path, digest)) {
+            store->ok = false;
+            return;
+        }
+        line[0] = '+';
+        line[1] = ' ';
+        key_to_hex(digest, line + 2);
+        line[2 + KEY_HEX] = ' ';
+        line[3 + KEY_HEX] = '\0';
+    }
+    else {
+        (void) strlcpy(line, "- ", sizeof(line));
+    }
+
+    sha256_update(&store->sha, line, strlen(line));
+    sha256_update(&store->sha, path, strlen(path));
+    sha256_update(&store->sha, "\n", 1);
+    fprintf(store->file, "%s%s\n", line, path);
+}
+
+static void store_output(const char *name, void *data)
+{
+    STORE *store = data;
+    STRLIST *seen;
+    unsigned char *contents;
+    size_t size;
+
+    if (!store->ok) {
+        return;
+    }
+    if (strchr(name, '\n') != NULL) {
+        store->ok = false;
+        return;
+    }
+
+    /* kept twice, same file both times */
+    for (seen = store->seen; seen != NULL; seen = seen->next) {
+        if (strcmp(seen->buf, name) == 0) {
+            return;
+        }
+    }
+    seen = dalloc(STRLISTSIZE + strlen(name) + 1);
+    strcpy(seen->buf, name);
+    seen->next = store->seen;
+    store->seen = seen;
+
+    contents = read_file(name, &size);
+    if (contents == NULL) {
+        store->ok = false;
+        return;
+    }
+    fprintf(store->file, "%lu %s\n", (unsigned long) size, name);
+    (void) fwrite(contents, 1, size, store->file);
+    dfree(contents);
+}
+
+void store_in_cache(void)
+{
+    STORE manifest;
+    STORE result;
+    char *manifest_name;
+    char *result_name;
+    unsigned char key[SHA256_DIGEST];
+
+    if (!have_run_key) {
+        return;
+    }
+
+    /* the cache is just a shortcut, if we can't write it, so be it */
+    manifest_name = cache_file(run_key, ".m");
+    memset(&manifest, 0, sizeof(manifest));
+    manifest.file = create_output(manifest_name);
+    manifest.ok = (manifest.file != NULL);
+    sha256_init(&manifest.sha);
+    sha256_update(&manifest.sha, run_key, sizeof(run_key));
+    for_each_probe(store_probe, &manifest);
+    sha256_final(&manifest.sha, key);
+
+    result_name = cache_file(key, ".r");
+    memset(&result, 0, sizeof(result));
+    if (manifest.ok) {
+        result.file = create_output(result_name);
+        result.ok = (result.file != NULL);
+    }
+    if (result.ok) {
+        fputs(CACHE_MAGIC, result.file);
+        for_each_kept_output(store_output, &result);
+    }
+
+    if (result.file != NULL) {
+        result.ok = finish_output(result.file, result.ok) && result.ok;
+    }
+    if (manifest.file != NULL) {
+        (void) finish_output(manifest.file, manifest.ok && result.ok);
+    }
+
+    while (result.seen != NULL) {
+        STRLIST *next = result.seen->next;
+        dfree(result.seen);
+        result.seen = next;
+    }
+    dfree(result_name);
+    dfree(manifest_name);
+}
+
+/* vim: set tabstop=4 softtabstop=4 expandtab shiftwidth=4 autoindent: */
@@ -0,0 +1,75 @@
+#ifndef _DASM_CACHE_H
+#define _DASM_CACHE_H
+
+/*
+    $Id$
+
+    the DASM macro assembler (aka small systems cross assembler)
+
+    Copyright (c) 1988-2002 by Matthew Dillon.
+    Copyright (c) 1995 by Olaf "Rhialto" Seibert.
+    Copyright (c) 2003-2008 by Andrew Davie.
+    Copyright (c) 2008 by Peter H. Froehlich.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/**
+ * @file
+ *
+ * @brief Result cache, -C option.
+ *
+ * Most runs assemble sources that didn't change since the last
+ * run, so we keep what a run produced in a cache directory and
+ * hand it out again next time. The key for a run is a SHA-256 of
+ * the DASM version, the current directory and all command line
+ * arguments; under it we keep a manifest listing every path the
+ * run tried to open (the source, its INCLUDEs and INCBINs, the
+ * places we searched for them) with the SHA-256 of its contents
+ * or the fact that it wasn't there. If all of those still hold,
+ * assembling again would come out the same, so we simply write
+ * the output files (binary, listing, symbols, and so on) from the
+ * cache instead.
+ *
+ * Only runs that printed nothing are cached: no errors, no
+ * warnings, and no ECHO output either. A hit prints nothing
+ * at all, so it looks just like a run that assembled.
+ */
+
+#include "asm.h"
+
+/**
+ * @brief Set the cache directory, -C option; it has to exist.
+ */
+void set_cache_directory(const char *dir);
+
+/**
+ * @brief Write the outputs of an earlier run with the same command
+ * line and inputs from the cache; true if we did, false if we have
+ * to assemble after all.
+ * @note Does nothing without set_cache_directory().
+ */
+bool restore_from_cache(int argc, char **argv);
+
+/**
+ * @brief Put the outputs of this run into the cache, call once all
+ * outputs are written.
+ * @pre restore_from_cache() was called and returned false
+ */
+void store_in_cache(void);
+
+#endif /* _DASM_CACHE_H */
+
+/* vim: set tabstop=4 softtabstop=4 expandtab shiftwidth=4 autoindent: */
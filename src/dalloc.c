@@ -5,15 +5,12 @@
  * If _DASM_ARENA_ALLOC exists, the special arena-style allocator is used
  * instead of the basic malloc(3)/free(3) allocator. This tends to improve
  * memory allocation performance, however it also prevents valgrind(1) and
- * related tools from working well. Also, the arena-style allocator frees
- * memory only at the end, so memory requirements may be higher.
+ * related tools from working well.
  *
- * @todo The arena-style allocator should be extended to handle arbitrarily
- * large allocations as well. If a request for more than ALLOCSIZE comes in,
- * just create a new block of the right size and slap it on the stack *under*
- * the current block we are satisfying small allocations out of. Sounds simple
- * enough? NOTE THAT THIS IS SOMEWHAT IMPORTANT SINCE THE SYMBOL TABLE SORTING
- * CODE COULD MAKE A LARGE ALLOCATION WHICH WOULD FAIL RIGHT NOW!
+ * The arena recycles blocks given back with dfree() through free lists, one
+ * per size class, so memory use no longer grows with the number of passes.
+ * Requests too big for any size class get a malloc(3)ed block of their own
+ * that dfree() returns right away.
  *
  * @todo The whole #ifdef business leaves a bad taste in my mouth.
  */
@@ -81,6 +78,11 @@ static void *zero_malloc(size_t bytes)
 	return p;
 }
 
+#define ROUNDUP(x) ((x + alignment-1) & ~(alignment-1))
+
+/* Assume sizeof(union align) is a power of 2 */
+union align { long l; double d; void *p; void (*fp)(void); };
+
 #ifdef _DASM_ARENA_ALLOC
 struct new_perm_block
 {
@@ -90,48 +92,174 @@ struct new_perm_block
 
 static struct new_perm_block *new_permalloc_stack = NULL;
 
+/* current block we carve small allocations out of */
+static void *buf = NULL;
+static size_t left = 0;
+
 #define ALLOCSIZE 16384
-#define ROUNDUP(x) ((x + alignment-1) & ~(alignment-1))
+
+/*
+ * Every block handed out by small_alloc() is preceded by a header
+ * that tells dfree() which free list it goes back to. Small blocks
+ * are rounded up to one of NUM_CLASSES size classes: 16 byte steps
+ * up to 256 bytes (that's where almost all of DASM's allocations
+ * are) and powers of two from there up to LARGEST_CLASS. Anything
+ * bigger is a large block, malloc(3)ed on its own and kept on a
+ * doubly linked list so dfree() can give it back right away and
+ * dfree_all() can find it.
+ */
+union block_header
+{
+	size_t size_class;
+	union align align;
+};
+
+#define CLASS_STEP 16
+#define STEP_CLASSES 16
+#define LARGEST_CLASS 4096
+#define NUM_CLASSES (STEP_CLASSES + 4)
+#define LARGE_CLASS NUM_CLASSES
+
+struct large_block
+{
+	struct large_block *prev;
+	struct large_block *next;
+	union block_header header; /* must be last, data follows */
+};
+
+static struct large_block *large_blocks = NULL;
+
+/* freed blocks of each size class, linked through their first word */
+static void *free_lists[NUM_CLASSES];
+
+/* counters for the memory debugging channel */
+static size_t debug_num_recycled;
+static size_t debug_num_freed;
+static size_t debug_num_large;
+
+static size_t size_class(size_t bytes)
+{
+	size_t class;
+	size_t size;
+
+	if (bytes <= STEP_CLASSES * CLASS_STEP) {
+		return (bytes + CLASS_STEP - 1) / CLASS_STEP - 1;
+	}
+
+	class = STEP_CLASSES;
+	for (size = 2 * STEP_CLASSES * CLASS_STEP; size < bytes; size *= 2) {
+		class++;
+	}
+	return class;
+}
+
+static size_t class_size(size_t class)
+{
+	assert(class < NUM_CLASSES);
+
+	if (class < STEP_CLASSES) {
+		return (class + 1) * CLASS_STEP;
+	}
+	return (2 * STEP_CLASSES * CLASS_STEP) << (class - STEP_CLASSES);
+}
+
+/**
+ * Wrapper for calloc(3) that terminates with panic_fmt() if no
+ * memory is available; for large blocks the kernel can hand us
+ * zeroed pages without touching them.
+ *
+ * @pre bytes > 0
+ */
+static void *checked_calloc(size_t bytes) __attribute__((malloc));
+static void *checked_calloc(size_t bytes)
+{
+	debug_record_regular_alloc(bytes);
+	assert(bytes > 0);
+
+	void *p = calloc(1, bytes);
+	if (p == NULL) {
+		panic_fmt(PANIC_MEMORY, bytes, SOURCE_LOCATION);
+	}
+
+	return p;
+}
+
+/**
+ * Allocate a block too big for any size class.
+ *
+ * @pre bytes > LARGEST_CLASS
+ */
+static void *large_alloc(size_t bytes) __attribute__((malloc));
+static void *large_alloc(size_t bytes)
+{
+	struct large_block *block;
+
+	assert(bytes > LARGEST_CLASS);
+
+	if (bytes > (size_t)-1 - sizeof(struct large_block)) {
+		panic_fmt(PANIC_MEMORY, bytes, SOURCE_LOCATION);
+	}
+
+	block = checked_calloc(sizeof(struct large_block) + bytes);
+	block->header.size_class = LARGE_CLASS;
+
+	block->prev = NULL;
+	block->next = large_blocks;
+	if (large_blocks != NULL) {
+		large_blocks->prev = block;
+	}
+	large_blocks = block;
+
+	debug_num_large++;
+	return block + 1;
+}
 
 /**
  * Efficiently allocate small amounts of memory.
  *
  * @pre bytes > 0
  *
- * @warning As of right now, you can only request *small* amounts
- * of memory from this function, less than 1024 bytes at a time
- * is a good rule of thumb.
+ * @note Requests up to LARGEST_CLASS bytes are served from the
+ * arena, recycling blocks dfree() gave back whenever possible;
+ * bigger requests go to large_alloc().
  * You *cannot* free(3) the pointer returned by small_alloc(),
- * truly bad things will happen if you try.
- * You can *only* free *all* the memory ever allocated through
- * small_alloc() using small_free_all() below.
- *
- * @todo Extend to arbitrary allocations as outlined above.
- * Also clean up formatting and refactor.
+ * truly bad things will happen if you try; use dfree() to
+ * recycle it or small_free_all() below to free everything.
  */
 static void *small_alloc(size_t bytes) __attribute__((malloc));
 static void *small_alloc(size_t bytes)
 {
 	debug_record_arena_alloc(bytes);
 
-	/* Assume sizeof(union align) is a power of 2 */
-	union align { long l; double d; void *p; void (*fp)(void); };
-
-	/* carefully note that the next two are static! */
-	static void *buf;
-	static size_t left = 0;
 	void *ptr;
+	union block_header *header;
 	struct new_perm_block *block;
 	size_t alignment = sizeof(union align);
+	size_t class;
 
 	assert(bytes > 0); /* rule out 0! */
-	/* could sanity check upper bound here, but we're doing it
-	 * below anyway */
 
 	debug_fmt(DEBUG_CHANNEL_CONTROL, DEBUG_ENTER, SOURCE_LOCATION);
 
-	/* round up bytes for proper alignment */
-	bytes = ROUNDUP(bytes);
+	if (bytes > LARGEST_CLASS) {
+		ptr = large_alloc(bytes);
+		debug_fmt(DEBUG_CHANNEL_CONTROL, DEBUG_LEAVE, SOURCE_LOCATION);
+		return ptr;
+	}
+
+	class = size_class(bytes);
+
+	/* can we recycle a block of the right size? */
+	if (free_lists[class] != NULL) {
+		ptr = free_lists[class];
+		free_lists[class] = *(void **)ptr;
+		debug_num_recycled++;
+		debug_fmt(DEBUG_CHANNEL_CONTROL, DEBUG_LEAVE, SOURCE_LOCATION);
+		return memset(ptr, 0, bytes);
+	}
+
+	/* header plus the whole class so the block can be recycled */
+	bytes = ROUNDUP(sizeof(union block_header) + class_size(class));
 
 	/* do we not have enough left in the current block? */
 	if (bytes > left) {
@@ -147,7 +275,7 @@ static void *small_alloc(size_t bytes)
 		/* calculate bytes we have left */
 		left = ALLOCSIZE - ROUNDUP(sizeof(block->next));
 
-		/* check again if we have enough space */
+		/* can't happen unless someone breaks LARGEST_CLASS */
 		if (bytes > left) {
 			panic_fmt(PANIC_SMALL_MEMORY, bytes, SOURCE_LOCATION);
 		}
@@ -164,7 +292,9 @@ static void *small_alloc(size_t bytes)
 				(void*) buf);
 	}
 
-	ptr = buf; /* recall buf is static! */
+	header = buf;
+	header->size_class = class;
+	ptr = header + 1;
 	buf = ((char*)buf) + bytes; /* char cast important! */
 	debug_fmt(DEBUG_CHANNEL_MEMORY|DEBUG_CHANNEL_DETAIL,
 			"%s: adjusted buf @ %p", SOURCE_LOCATION, (void*) buf);
@@ -174,6 +304,37 @@ static void *small_alloc(size_t bytes)
 	return ptr;
 }
 
+/**
+ * Give a block from small_alloc() back: small blocks go on the
+ * free list of their size class, large ones back to free(3).
+ */
+static void small_free(void *address)
+{
+	union block_header *header = ((union block_header *)address) - 1;
+
+	debug_num_freed++;
+
+	if (header->size_class == LARGE_CLASS) {
+		struct large_block *block = ((struct large_block *)address) - 1;
+
+		if (block->prev != NULL) {
+			block->prev->next = block->next;
+		}
+		else {
+			large_blocks = block->next;
+		}
+		if (block->next != NULL) {
+			block->next->prev = block->prev;
+		}
+		free(block);
+		return;
+	}
+
+	assert(header->size_class < NUM_CLASSES);
+	*(void **)address = free_lists[header->size_class];
+	free_lists[header->size_class] = address;
+}
+
 /**
  * Free *all* memory allocated by small_alloc() so far.
  *
@@ -201,10 +362,134 @@ static void small_free_all(void)
 		free(current);
 	}
 
+	/* same for large blocks */
+	while (large_blocks != NULL) {
+		struct large_block *large = large_blocks;
+		large_blocks = large->next;
+		free(large);
+	}
+
+	/* nothing left to carve out of or recycle */
+	buf = NULL;
+	left = 0;
+	memset(free_lists, 0, sizeof(free_lists));
+
 	debug_fmt(DEBUG_CHANNEL_CONTROL, DEBUG_LEAVE, SOURCE_LOCATION);
 }
 #endif /* _DASM_ARENA_ALLOC */
 
+/*
+ * Scratch arenas for memory that dies at the end of a line or pass:
+ * we just bump a pointer through a list of chunks, and resetting the
+ * arena rewinds to the first chunk without giving anything back. So
+ * once DASM has warmed up, a line (or a pass) costs no malloc(3) and
+ * no individual frees at all. Chunks are SCRATCH_CHUNK bytes unless a
+ * single request needs more.
+ */
+
+#define SCRATCH_CHUNK 16384
+
+struct scratch_chunk
+{
+	struct scratch_chunk *next;
+	size_t size; /* usable bytes in data */
+	union align data[];
+};
+
+struct scratch_arena
+{
+	const char *name;
+	struct scratch_chunk *first; /* all chunks we ever allocated */
+	struct scratch_chunk *current; /* NULL right after a reset */
+	size_t used; /* bytes used in current chunk */
+	size_t in_use; /* bytes handed out since the last reset */
+	/* statistics */
+	size_t num_allocs;
+	size_t num_bytes;
+	size_t num_resets;
+	size_t num_chunks;
+	size_t peak;
+};
+
+static struct scratch_arena scratch_arenas[SCRATCH_MAX] = {
+	[SCRATCH_LINE] = { .name = "line" },
+	[SCRATCH_PASS] = { .name = "pass" },
+};
+
+void *scratch_alloc(scratch_t scratch, size_t bytes)
+{
+	struct scratch_arena *arena;
+	struct scratch_chunk **link;
+	size_t alignment = sizeof(union align);
+	void *ptr;
+
+	assert(0 <= scratch && scratch < SCRATCH_MAX);
+	assert(bytes > 0);
+
+	arena = &scratch_arenas[scratch];
+	bytes = ROUNDUP(bytes);
+
+	if (arena->current == NULL || arena->used + bytes > arena->current->size) {
+		/* next chunk big enough, allocate one if there's none */
+		link = (arena->current == NULL) ? &arena->first : &arena->current->next;
+		while (*link != NULL && (*link)->size < bytes) {
+			link = &(*link)->next;
+		}
+		if (*link == NULL) {
+			size_t size = (bytes > SCRATCH_CHUNK) ? bytes : SCRATCH_CHUNK;
+			*link = checked_malloc(sizeof(struct scratch_chunk) + size);
+			(*link)->next = NULL;
+			(*link)->size = size;
+			arena->num_chunks++;
+		}
+		arena->current = *link;
+		arena->used = 0;
+	}
+
+	ptr = ((char *)arena->current->data) + arena->used;
+	arena->used += bytes;
+	arena->in_use += bytes;
+
+	arena->num_allocs++;
+	arena->num_bytes += bytes;
+	if (arena->in_use > arena->peak) {
+		arena->peak = arena->in_use;
+	}
+
+	return memset(ptr, 0, bytes);
+}
+
+void scratch_reset(scratch_t scratch)
+{
+	struct scratch_arena *arena;
+
+	assert(0 <= scratch && scratch < SCRATCH_MAX);
+
+	arena = &scratch_arenas[scratch];
+	arena->current = NULL;
+	arena->used = 0;
+	arena->in_use = 0;
+	arena->num_resets++;
+}
+
+/**
+ * Free the chunks of all scratch arenas.
+ */
+static void scratch_free_all(void)
+{
+	for (int i = 0; i < SCRATCH_MAX; i++) {
+		struct scratch_arena *arena = &scratch_arenas[i];
+		while (arena->first != NULL) {
+			struct scratch_chunk *chunk = arena->first;
+			arena->first = chunk->next;
+			free(chunk);
+		}
+		arena->current = NULL;
+		arena->used = 0;
+		arena->in_use = 0;
+	}
+}
+
 /*
  * [phf] Here's that badly hacked-together memory allocation
  * debugger. If you see a chance to clean it up, please do.
@@ -304,6 +589,19 @@ void debug_memory_allocation_patterns(void)
 			debug_num_regular);
 	debug_memory_allocations("arena", debug_arena,
 			debug_num_arena);
+#ifdef _DASM_ARENA_ALLOC
+	debug_fmt(DEBUG_CHANNEL_MEMORY,
+		"Arena: %zu blocks recycled, %zu freed, %zu large",
+		debug_num_recycled, debug_num_freed, debug_num_large);
+#endif
+	for (int i = 0; i < SCRATCH_MAX; i++) {
+		const struct scratch_arena *arena = &scratch_arenas[i];
+		debug_fmt(DEBUG_CHANNEL_MEMORY,
+			"Scratch %s: %zu allocations for %zu bytes, "
+			"%zu resets, %zu chunks, peak %zu bytes",
+			arena->name, arena->num_allocs, arena->num_bytes,
+			arena->num_resets, arena->num_chunks, arena->peak);
+	}
 }
 
 /* [phf] here's the actual API, ugly as hell ifdefs */
@@ -320,8 +618,9 @@ void *dalloc(size_t bytes)
 void dfree(void *address)
 {
 #ifdef _DASM_ARENA_ALLOC
-	/* nothing to do, but avoid the GCC warning */
-	address = address;
+	if (address != NULL) {
+		small_free(address);
+	}
 #else
 	free(address);
 #endif
@@ -329,9 +628,8 @@ void dfree(void *address)
 
 void dfree_all(void)
 {
+	scratch_free_all();
 #ifdef _DASM_ARENA_ALLOC
 	small_free_all();
-#else
-	/* nothing to do */
 #endif
 }
@@ -27,9 +27,9 @@
  * However, the arena-style allocator has *one* wonderful property *beyond*
  * performance: It's trivial to free memory correctly by destroying the arenas.
  * In other words, if we switched to the arena-style allocator exclusively, all
- * the remaining memory leaks would go away. Also, because all objects
- * allocated seem to be well below 16kB, the fixed-size arena is very unlikely
- * to become a problem.
+ * the remaining memory leaks would go away. Blocks given back with dfree() are
+ * recycled by size class, and the rare object too big for the arena gets a
+ * block of its own.
  *
  * However, the arena-style allocator also suffers from a *big* drawback: Tools
  * like valgrind(1) cannot warn us about illegal memory accesses inside the
@@ -80,6 +80,37 @@ void dfree(void *address);
  */
 void dfree_all(void);
 
+/**
+ * Scratch arenas for transient memory, see scratch_alloc().
+ */
+typedef enum
+{
+	/** reset at the end of every source line */
+	SCRATCH_LINE,
+	/** reset at the end of every pass */
+	SCRATCH_PASS,
+
+	/* meta data */
+	SCRATCH_MAX
+}
+scratch_t;
+
+/**
+ * Allocate zeroed memory that lives until the given scratch arena is
+ * reset with scratch_reset().
+ *
+ * @pre bytes > 0
+ *
+ * @warning Never dfree() the pointer returned by scratch_alloc().
+ */
+void *scratch_alloc(scratch_t scratch, size_t bytes) __attribute((malloc));
+
+/**
+ * Release everything allocated in the given scratch arena at once; the
+ * memory is kept around for the next round of scratch_alloc() calls.
+ */
+void scratch_reset(scratch_t scratch);
+
 /**
  * Debugging output for memory allocation patterns.
  */
@@ -33,6 +33,8 @@
 #include "errors.h"
 
 #include "asm.h"
+#include "dalloc.h"
+#include "listing.h"
 #include "util.h"
 #include "version.h"
 
@@ -66,6 +68,58 @@ static size_t nof_errors = 0;
 static size_t nof_warnings = 0;
 char source_location_buffer[SOURCE_LOCATION_LENGTH];
 
+/*
+  Lots of errors in early passes go away in later ones, so unless
+  asked to show every pass we don't print warnings and worse right
+  away: we record them and print what the final pass left when
+  flush_errors() is called. A message is kept as its level, the
+  file and line it's about, and its text; file names and texts go
+  into one pool of strings, and we only format the whole thing
+  when it gets printed. The same message for the same line is
+  kept once per pass (think REPEAT loops). Messages from outside
+  of a pass (options, between passes) count for all passes.
+*/
+#define NO_NAME ((size_t) -1)
+
+/* longest message we format, location and level included */
+#define MESSAGE_LENGTH 2048
+
+typedef struct
+{
+    error_level_t level;
+    size_t name; /* offset in pool, NO_NAME if no file */
+    unsigned long line;
+    size_t text; /* offset in pool */
+    uint64_t hash;
+    size_t next; /* next in hash chain, index + 1, 0 at the end */
+    bool sticky; /* from outside of a pass */
+    bool printed;
+    bool missing; /* missing from listing file */
+}
+MESSAGE;
+
+static MESSAGE *messages = NULL;
+static size_t nof_messages = 0;
+static size_t max_messages = 0;
+
+static char *pool = NULL;
+static size_t pool_used = 0;
+static size_t pool_size = 0;
+
+/* hash chains of messages, index + 1, 0 if empty; size is 2^n */
+static size_t *chains = NULL;
+static size_t nof_chains = 0;
+
+/* print every pass (-v, -d), in a pass, holding messages back? */
+static bool every_pass = false;
+static bool in_pass = false;
+static bool deferring = false;
+
+/* counts for messages from outside of a pass */
+static size_t sticky_fatals = 0;
+static size_t sticky_errors = 0;
+static size_t sticky_warnings = 0;
+
 static const char *level_names[] =
 {
     [ERRORLEVEL_DEBUG] = "debug",
@@ -104,6 +158,11 @@ void set_debug_channels(unsigned int channels)
     F_debug_channels = channels;
 }
 
+void set_error_every_pass(bool every)
+{
+    every_pass = every;
+}
+
 /**
  * @brief Display this error level?
  */
@@ -140,63 +199,6 @@ static void internal_panic(const char *message)
   exit(EXIT_FAILURE);
 }
 
-/**
- * Print final error message to all relevant streams.
- *
- * We always print to stderr. We print to the listing file as
- * well if we have one, but it's complicated to know if we do.
- *
- * Originally we just checked FI_listfile != NULL but DASM is
- * of course being difficult: It closes the listing file after
- * each pass, but *without* setting FI_listfile to NULL. This
- * in turn made valgrind complain about accessing memory that
- * had been freed. Since there is no portable way to check if
- * a FILE* is open or not, we had to change the code in main.c
- * to assign NULL to FI_listfile after each fclose(). Works,
- * but it's an ugly dependency. Also the listing file will not
- * show error messages generated between two passes. Since we
- * think that's important, we would like to warn the user but
- * of course we cannot generate another error message here.
- * What we do instead is append a little note to the regular
- * message that goes to stderr anyway. Let's hope that's good
- * enough.
- *
- * Messages to the listing file get a leading "*" just like
- * Matt's version did years ago; at one point I thought that
- * the "*" starts a comment, but I can't confirm that in the
- * code (only ";" seems to be a comment), so the motivation
- * must have been different.
- *
- * We only get here after all the other filters checked that
- * we should really print, so we don't check anything else
- * about the error message.
- *
- * @pre message != NULL && strlen(message) > 0
- */
-static void print_error_message(const char *message)
-{
-    assert(message != NULL);
-    assert(strlen(message) > 0);
-
-    bool missing = false; /* missing from listing file? */
-
-    if (F_listfile != NULL) {
-        if (FI_listfile != NULL) {
-            fprintf(FI_listfile, "*%s\n", message);
-        }
-        else {
-            missing = true;
-        }
-    }
-
-    fprintf(
-        stderr,
-        "%s%s\n",
-        message,
-        missing ? " [not in listing file]" : ""
-    );
-}
-
 /**
  * @brief Sane wrapper for vsnprintf().
  * @note See sane_snprintf() for details.
@@ -262,10 +264,12 @@ static size_t append_level(char *buffer, error_level_t level, size_t size)
 }
 
 /**
- * @brief Format the location part of the error message.
+ * @brief Format the location part of the error message, name
+ * is the file (NULL if none) and line the line in it.
  * @note Follows strlcat() conventions.
  */
-static size_t append_location(char *buffer, /*@null@*/ const INCFILE *file, size_t size)
+static size_t append_location(char *buffer, /*@null@*/ const char *name,
+                              unsigned long line, size_t size)
 {
     char location[1024];
     size_t res = 0;
@@ -279,10 +283,10 @@ static size_t append_location(char *buffer, /*@null@*/ const INCFILE *file, size
                 Error format for MS VisualStudio and relatives:
                 "file (line): error: string"
             */
-            if (file != NULL) {
+            if (name != NULL) {
                 res = sane_snprintf(
                     location, sizeof(location), "%s (%lu): ",
-                    file->name, file->lineno
+                    name, line
                 );
             }
             break;
@@ -292,10 +296,10 @@ static size_t append_location(char *buffer, /*@null@*/ const INCFILE *file, size
                 Matt's 2.16 uses this instead:
                   "line %4ld %-10s %s\n" (terminal)
             */
-            if (file != NULL) {
+            if (name != NULL) {
                 res = sane_snprintf(
                     location, sizeof(location), "line %7lu %-10s ",
-                    file->lineno, file->name
+                    line, name
                 );
             }
             break;
@@ -304,10 +308,10 @@ static size_t append_location(char *buffer, /*@null@*/ const INCFILE *file, size
                 GNU format error messages, from their coding
                 standards: "source-file-name:lineno: message"
             */
-            if (file != NULL) {
+            if (name != NULL) {
                 res = sane_snprintf(
                     location, sizeof(location), "%s:%lu: ",
-                    file->name, file->lineno
+                    name, line
                 );
             }
             else {
@@ -343,14 +347,294 @@ append_information(char *buffer, const char *fmt, va_list ap, size_t size)
     return strlcat(buffer, information, size);
 }
 
-static void vanotify(error_level_t level, const char *fmt, va_list ap)
+/**
+ * @brief Format the whole error message into buffer.
+ */
+static void format_message(char *buffer, size_t size, error_level_t level,
+                           /*@null@*/ const char *name, unsigned long line,
+                           const char *text)
 {
-    /* buffer for formatting error message into  */
-    char buffer[1024];
-    /* include file we're in right now (if any) */
-    INCFILE *file = pIncfile;
-    /* holds the return value from strlcat */
-    size_t res;
+    /* clear buffer */
+    buffer[0] = '\0';
+
+    /* append the various pieces of the message */
+    if (append_location(buffer, name, line, size) >= size
+        || append_level(buffer, level, size) >= size
+        || strlcat(buffer, text, size) >= size) {
+        internal_panic("Buffer overflow in format_message()!");
+    }
+}
+
+/**
+ * Put error message into the listing file.
+ *
+ * We print to the listing file if we have one, that is if
+ * listing_active() says we're recording a listing (see
+ * listing.h). This happens right away even if stderr only
+ * gets the message at the end, the listing has to show it
+ * next to the line it's about.
+ *
+ * Messages from before the first pass or after the listing was
+ * written can't make it into the listing file. Since we think
+ * that's important, we would like to warn the user but of
+ * course we cannot generate another error message here. What
+ * we do instead is return true, and print_error_message()
+ * appends a little note to the regular message that goes to
+ * stderr anyway. Let's hope that's good enough.
+ *
+ * Messages to the listing file get a leading "*" just like
+ * Matt's version did years ago; at one point I thought that
+ * the "*" starts a comment, but I can't confirm that in the
+ * code (only ";" seems to be a comment), so the motivation
+ * must have been different.
+ */
+static bool list_error_message(error_level_t level, /*@null@*/ const char *name,
+                               unsigned long line, const char *text)
+{
+    char message[MESSAGE_LENGTH];
+
+    if (F_listfile == NULL) {
+        return false;
+    }
+    if (!listing_active()) {
+        return true;
+    }
+
+    format_message(message, sizeof(message), level, name, line, text);
+    list_text("*%s\n", message);
+    return false;
+}
+
+/**
+ * Print final error message to stderr, we always do that.
+ *
+ * We only get here after all the other filters checked that
+ * we should really print, so we don't check anything else
+ * about the error message.
+ */
+static void print_error_message(error_level_t level, /*@null@*/ const char *name,
+                                unsigned long line, const char *text, bool missing)
+{
+    char message[MESSAGE_LENGTH];
+
+    format_message(message, sizeof(message), level, name, line, text);
+
+    fprintf(
+        stderr,
+        "%s%s\n",
+        message,
+        missing ? " [not in listing file]" : ""
+    );
+}
+
+/* Copy string into the pool, return its offset there. */
+static size_t pool_string(const char *string)
+{
+    size_t length = strlen(string) + 1;
+
+    if (pool_size - pool_used < length) {
+        size_t size = 2 * pool_size + length + 1024;
+        char *more = dalloc(size);
+        if (pool != NULL) {
+            memcpy(more, pool, pool_used);
+            dfree(pool);
+        }
+        pool = more;
+        pool_size = size;
+    }
+
+    memcpy(pool + pool_used, string, length);
+    pool_used += length;
+    return pool_used - length;
+}
+
+static const char *message_name(const MESSAGE *message)
+{
+    return (message->name == NO_NAME) ? NULL : pool + message->name;
+}
+
+static uint64_t message_hash(error_level_t level, /*@null@*/ const char *name,
+                             unsigned long line, const char *text)
+{
+    uint64_t hash = HASH_BYTES_INIT;
+
+    hash = hash_bytes(hash, &level, sizeof(level));
+    hash = hash_bytes(hash, &line, sizeof(line));
+    if (name != NULL) {
+        hash = hash_bytes(hash, name, strlen(name) + 1);
+    }
+    return hash_bytes(hash, text, strlen(text));
+}
+
+/* Put all messages into their hash chains, with room to grow. */
+static void chain_messages(void)
+{
+    size_t i;
+
+    if (chains == NULL || nof_chains < 2 * nof_messages) {
+        size_t count = (nof_chains == 0) ? 64 : nof_chains;
+        while (count < 2 * nof_messages) {
+            count *= 2;
+        }
+        if (chains != NULL) {
+            dfree(chains);
+        }
+        chains = dalloc(count * sizeof(size_t));
+        nof_chains = count;
+    }
+    memset(chains, 0, nof_chains * sizeof(size_t));
+
+    for (i = 0; i < nof_messages; i++) {
+        size_t *chain = &chains[messages[i].hash & (nof_chains - 1)];
+        messages[i].next = *chain;
+        *chain = i + 1;
+    }
+}
+
+/* Did we record this message already? */
+static bool seen_message(uint64_t hash, error_level_t level, /*@null@*/ const char *name,
+                         unsigned long line, const char *text)
+{
+    size_t i;
+
+    if (chains == NULL) {
+        return false;
+    }
+
+    for (i = chains[hash & (nof_chains - 1)]; i != 0; i = messages[i - 1].next) {
+        const MESSAGE *message = &messages[i - 1];
+        const char *other = message_name(message);
+        if (message->hash == hash && message->level == level
+            && message->line == line && message->sticky == !in_pass
+            && (name == NULL ? other == NULL : other != NULL && strcmp(name, other) == 0)
+            && strcmp(text, pool + message->text) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static MESSAGE *add_message(uint64_t hash, error_level_t level, /*@null@*/ const char *name,
+                            unsigned long line, const char *text)
+{
+    MESSAGE *message;
+
+    if (nof_messages == max_messages) {
+        size_t count = 2 * max_messages + 64;
+        MESSAGE *more = dalloc(count * sizeof(MESSAGE));
+        if (messages != NULL) {
+            memcpy(more, messages, nof_messages * sizeof(MESSAGE));
+            dfree(messages);
+        }
+        messages = more;
+        max_messages = count;
+    }
+
+    message = &messages[nof_messages];
+    message->level = level;
+    message->name = (name == NULL) ? NO_NAME : pool_string(name);
+    message->line = line;
+    message->text = pool_string(text);
+    message->hash = hash;
+    message->sticky = !in_pass;
+    message->printed = false;
+    message->missing = false;
+    nof_messages += 1;
+
+    if (2 * nof_messages > nof_chains) {
+        chain_messages();
+    }
+    else {
+        size_t *chain = &chains[hash & (nof_chains - 1)];
+        message->next = *chain;
+        *chain = nof_messages;
+    }
+
+    return message;
+}
+
+/* Maintain statistics about warnings and errors. */
+static void count_message(error_level_t level)
+{
+    /* TODO: count everything < PANIC? */
+    if (level == ERRORLEVEL_WARNING) {
+        nof_warnings += 1;
+        sticky_warnings += in_pass ? 0 : 1;
+    }
+    if (level == ERRORLEVEL_ERROR) {
+        nof_errors += 1;
+        sticky_errors += in_pass ? 0 : 1;
+    }
+    /* fatal and higher errors lead to (eventual) termination */
+    if (level >= ERRORLEVEL_FATAL) {
+        nof_fatals += 1; /* stop after current pass */
+        sticky_fatals += in_pass ? 0 : 1;
+    }
+}
+
+void begin_error_pass(void)
+{
+    char *old = pool;
+    size_t kept = 0;
+    size_t i;
+
+    /* only messages from outside of a pass still waiting survive */
+    pool = NULL;
+    pool_used = pool_size = 0;
+    for (i = 0; i < nof_messages; i++) {
+        MESSAGE message = messages[i];
+        if (message.sticky && !message.printed) {
+            if (message.name != NO_NAME) {
+                message.name = pool_string(old + message.name);
+            }
+            message.text = pool_string(old + message.text);
+            messages[kept++] = message;
+        }
+    }
+    if (old != NULL) {
+        dfree(old);
+    }
+    nof_messages = kept;
+    chain_messages();
+
+    nof_fatals = sticky_fatals;
+    nof_errors = sticky_errors;
+    nof_warnings = sticky_warnings;
+
+    in_pass = true;
+    deferring = !every_pass;
+}
+
+void end_error_pass(void)
+{
+    in_pass = false;
+}
+
+void flush_errors(void)
+{
+    size_t i;
+
+    for (i = 0; i < nof_messages; i++) {
+        MESSAGE *message = &messages[i];
+        if (!message->printed) {
+            print_error_message(message->level, message_name(message),
+                                message->line, pool + message->text, message->missing);
+            message->printed = true;
+        }
+    }
+
+    deferring = false;
+}
+
+static void vanotify_in(error_level_t level, /*@null@*/ const char *name,
+                        unsigned long line, const char *fmt, va_list ap)
+{
+    /* buffer for formatting the information part into */
+    char text[1024];
+    /* message we recorded, if any */
+    MESSAGE *message = NULL;
+    bool missing;
 
     assert(valid_error_level(level));
 
@@ -359,54 +643,68 @@ static void vanotify(error_level_t level, const char *fmt, va_list ap)
         return;
     }
 
-    /* find the file we're in (if any) */
-    /* TODO: how does this work exactly? */
-    while (file != NULL && (file->flags & INF_MACRO) != 0) {
-        file = file->next;
-    }
-
     /* clear buffer */
-    buffer[0] = '\0';
+    text[0] = '\0';
 
-    /* append the various pieces of the message */
-    res = append_location(buffer, file, sizeof(buffer));
-    if (res > sizeof(buffer)) {
+    if (append_information(text, fmt, ap, sizeof(text)) >= sizeof(text)) {
         internal_panic("Buffer overflow in vanotify()!");
     }
-    res = append_level(buffer, level, sizeof(buffer));
-    if (res > sizeof(buffer)) {
-        internal_panic("Buffer overflow in vanotify()!");
-    }
-    res = append_information(buffer, fmt, ap, sizeof(buffer));
-    if (res > sizeof(buffer)) {
-        internal_panic("Buffer overflow in vanotify()!");
+
+    /* a panic doesn't wait for anyone, but what came before goes first */
+    if (level == ERRORLEVEL_PANIC) {
+        flush_errors();
     }
 
-    /* print the message */
-    print_error_message(buffer);
+    missing = list_error_message(level, name, line, text);
 
-    /* maintain statistics about warnings and errors */
-    /* TODO: count everything < PANIC? */
-    if (level == ERRORLEVEL_WARNING)
-    {
-         nof_warnings += 1;
+    /* nothing below warnings counts, so there's no need to keep those */
+    if (level >= ERRORLEVEL_WARNING && level < ERRORLEVEL_PANIC
+        && (deferring || (in_pass && every_pass))) {
+        uint64_t hash = message_hash(level, name, line, text);
+        if (seen_message(hash, level, name, line, text)) {
+            return;
+        }
+        message = add_message(hash, level, name, line, text);
+        message->missing = missing;
     }
-    if (level == ERRORLEVEL_ERROR)
-    {
-         nof_errors += 1;
+
+    count_message(level);
+
+    if (!deferring) {
+        print_error_message(level, name, line, text, missing);
+        if (message != NULL) {
+            message->printed = true;
+        }
     }
 
-    /* fatal and higher errors lead to (eventual) termination */
-    if (level >= ERRORLEVEL_FATAL)
-    {
-        nof_fatals += 1; /* stop after current pass */
+    /* fatal errors end assembly after this pass, so that was the last one */
+    if (level == ERRORLEVEL_FATAL) {
+        flush_errors();
     }
-    if (level == ERRORLEVEL_PANIC)
-    {
+    if (level == ERRORLEVEL_PANIC) {
         exit(EXIT_FAILURE); /* stop right now! */
     }
 }
 
+static void vanotify(error_level_t level, const char *fmt, va_list ap)
+{
+    /* include file we're in right now (if any) */
+    INCFILE *file = pIncfile;
+
+    /* find the file we're in (if any) */
+    /* TODO: how does this work exactly? */
+    while (file != NULL && (file->flags & INF_MACRO) != 0) {
+        file = file->next;
+    }
+
+    if (file != NULL) {
+        vanotify_in(level, file->name, file->lineno, fmt, ap);
+    }
+    else {
+        vanotify_in(level, NULL, 0, fmt, ap);
+    }
+}
+
 /* avoid code replication through macros, sweet [phf] */
 #define IMPLEMENT_FMT(level) \
     va_list ap; \
@@ -424,6 +722,18 @@ void notify_fmt(error_level_t level, const char *fmt, ...)
     IMPLEMENT_FMT(level);
 }
 
+void notify_at_fmt(error_level_t level, const char *name, unsigned long line,
+                   const char *fmt, ...)
+{
+    va_list ap;
+
+    assert(name != NULL);
+
+    va_start(ap, fmt);
+    vanotify_in(level, name, line, fmt, ap);
+    va_end(ap);
+}
+
 void debug_fmt(enum debug_channels chan, const char *fmt, ...)
 {
     if ((F_debug_channels & chan) == chan) {
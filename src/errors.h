@@ -72,6 +72,8 @@ void set_error_format(error_format_t format);
 /**
  * @brief How many fatals so far, tells us whether to stop after the
  * current pass.
+ * @note Counts only cover the current pass (or the last one) plus
+ * messages from outside of any pass, see begin_error_pass().
  */
 size_t number_of_fatals(void);
 
@@ -160,6 +162,32 @@ enum debug_channels {
  */
 void set_debug_channels(unsigned int channels);
 
+/**
+ * @brief Print warnings and worse as they happen in every pass
+ * (-v and -d options) instead of only those of the final pass.
+ */
+void set_error_every_pass(bool every);
+
+/**
+ * @brief Start a new pass, call at the start of every pass;
+ * forgets messages from the previous pass and their counts,
+ * except those from outside of any pass.
+ */
+void begin_error_pass(void);
+
+/**
+ * @brief The current pass is done, call at the end of every pass.
+ */
+void end_error_pass(void);
+
+/**
+ * @brief Print all messages held back so far, in the order they
+ * came in; call when the final pass is done. Messages after this
+ * are printed right away.
+ * @note Fatal errors and panics flush the messages themselves.
+ */
+void flush_errors(void);
+
 /**
  * @brief Length of buffer for source locations.
  */
@@ -198,6 +226,15 @@ extern char source_location_buffer[SOURCE_LOCATION_LENGTH];
 void notify_fmt(error_level_t level, const char *fmt, ...)
     __attribute__((format(printf, 2, 3)));
 
+/**
+ * @brief Same for a problem found later than the line it's about,
+ * the message gives the named file and line as its location.
+ */
+
+void notify_at_fmt(error_level_t level, const char *name, unsigned long line,
+                   const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
 /**
  * @brief Helpers to make common levels easier to read.
  */
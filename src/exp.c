@@ -26,17 +26,18 @@
 /**
  * @file
  * @brief Handle expression evaluation and addressing mode decode.
- * @note If you use the string field in an expression you must clear
- * the SYM_MACRO and SYM_STRING bits in the flags before calling
- * FreeSymbolList()!
+ * @note Expression results and their strings live in the SCRATCH_LINE
+ * arena; copy the string field if you need it beyond the current line!
  */
 
 #include "asm.h"
 #include "dalloc.h"
 #include "errors.h"
+#include "listing.h"
 #include "symbols.h"
 #include "util.h"
 #include "version.h"
+#include "xref.h"
 
 #include <assert.h>
 #include <ctype.h>
@@ -388,7 +389,7 @@ SYMBOL *eval(const char *str, bool wantmode)
                     char buf[32];
                     int len = snprintf(buf,sizeof(buf),"%ld",Argstack[Argi-1]);
                     assert(len < (int)sizeof(buf));
-                    Argstring[Argi-1] = checked_strdup(buf);
+                    Argstring[Argi-1] = strcpy(scratch_alloc(SCRATCH_LINE, len+1), buf);
                 }
             }
             break;
@@ -599,7 +600,7 @@ static void stackarg(long val, dasm_flag_t flags, /*@null@*/ const char *ptr1)
             ++ptr;
             ++len;
         }
-        new = dalloc(len + 1); /* [phf] was regular */
+        new = scratch_alloc(SCRATCH_LINE, len + 1); /* [phf] was regular */
         memcpy(new, ptr1, len);
         new[len] = '\0';
         flags &= ~SYM_STRING;
@@ -899,8 +900,8 @@ static const char *pushsymbol(const char *str)
         error_fmt("Invalid character '%s'!", str); /* TODO: (*str) instead? */
         /* TODO: should go in error handling code, not here! [phf] */
         printf("char = '%c' %d (-1: %d)\n", *str, *str, *(str-1));
-        if (FI_listfile != NULL) {
-            fprintf(FI_listfile, "char = '%c' code %d\n", *str, *str);
+        if (listing_active()) {
+            list_text("char = '%c' code %d\n", *str, *str);
         }
         return str+1;
     }
@@ -916,14 +917,13 @@ static const char *pushsymbol(const char *str)
 
     if ((sym = find_symbol(str, ptr - str)) != NULL)
     {
-        bool macro = false;
+        xref_reference(sym);
 
         if ((sym->flags & SYM_UNKNOWN) != 0) {
             ++Redo_eval;
         }
 
         if ((sym->flags & SYM_MACRO) != 0) {
-            macro = true;
             sym = eval(sym->string, false);
             assert(sym != NULL);
         }
@@ -936,16 +936,13 @@ static const char *pushsymbol(const char *str)
         }
 
         sym->flags |= SYM_REF|SYM_MASREF;
-
-        if (macro) {
-            free_symbol_list(sym);
-        }
     }
     else {
         stackarg(0L, SYM_UNKNOWN, NULL);
         sym = create_symbol(str, ptr - str);
         assert(sym != NULL);
         sym->flags = SYM_REF|SYM_MASREF|SYM_UNKNOWN;
+        xref_reference(sym);
         ++Redo_eval;
     }
     return ptr;
@@ -0,0 +1,998 @@
+/*
+    $Id$
+
+    the DASM macro assembler (aka small systems cross assembler)
+
+    Copyright (c) 1988-2002 by Matthew Dillon.
+    Copyright (c) 1995 by Olaf "Rhialto" Seibert.
+    Copyright (c) 2003-2008 by Andrew Davie.
+    Copyright (c) 2008 by Peter H. Froehlich.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/**
+ * @file
+ */
+
+#if defined(__WINDOWS__) || defined(_WIN32) || defined(_WIN64)
+#	define HAVE_MMAP 0
+#	define HAVE_MKSTEMP 0
+#	define HAVE_SYMLINKS 0
+#else
+	/* open(2), mmap(2), mkstemp(3), realpath(3) and friends */
+#	define _XOPEN_SOURCE 700
+#	define HAVE_MMAP 1
+#	define HAVE_MKSTEMP 1
+#	define HAVE_SYMLINKS 1
+#endif
+
+#include "files.h"
+
+#include "dalloc.h"
+#include "errors.h"
+#include "util.h"
+
+#include <assert.h>
+#include <sys/stat.h>
+
+#if HAVE_MMAP || HAVE_MKSTEMP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/* Which file a path referred to when we found it. */
+typedef struct
+{
+    uint64_t device;
+    uint64_t inode;
+    int64_t mtime;
+}
+IDENTITY;
+
+/* Part of a file we read for INCBIN "name", offset, length. */
+typedef struct _SLICE SLICE;
+struct _SLICE
+{
+    SLICE *next;
+    size_t offset;
+    size_t length;
+    unsigned char *data;
+};
+
+/* What we know about a file name used in the source. */
+typedef struct _RESOLVED RESOLVED;
+struct _RESOLVED
+{
+    /* next name in hash list */
+    RESOLVED *next;
+    /* next name in the order we first saw them */
+    RESOLVED *next_used;
+    /* name as used in the source */
+    char *name;
+    /* where we found it, NULL if nowhere */
+    char *path;
+    /* include directories we knew when we last looked */
+    size_t directories;
+    /* last pass we reported it missing, 0 if never */
+    unsigned int reported_pass;
+    /* file we found and its size, valid if path != NULL */
+    IDENTITY identity;
+    size_t size_on_disk;
+    /* contents of the file, valid if loaded, see file_contents() */
+    bool loaded;
+    const unsigned char *contents;
+    size_t size;
+    /* parts of the file we read, see file_slice() */
+    SLICE *slices;
+};
+
+#define RHASHSIZE ((size_t)(1<<8))
+#define RHASHAND (RHASHSIZE-1)
+
+static RESOLVED *RHash[RHASHSIZE];
+
+/* All names in the order we first saw them, for the dependency file. */
+static RESOLVED *first_used = NULL;
+static RESOLVED *last_used = NULL;
+
+/* Dependency file, -B option. */
+static const char *dependency_file_name = NULL;
+
+/* An output file we're writing to a temporary file first. */
+typedef struct _OUTFILE OUTFILE;
+struct _OUTFILE
+{
+    OUTFILE *next;
+    FILE *file;
+    /* file we were asked to write */
+    char *name;
+    /* file we're going to replace, name or where its symlink points */
+    char *target;
+    /* file we're writing, NULL if we write to target directly */
+    char *temp;
+};
+
+/* Output files not finished yet. */
+static OUTFILE *outfiles = NULL;
+
+/* A path we tried to open while searching, for the result cache. */
+typedef struct _PROBE PROBE;
+struct _PROBE
+{
+    PROBE *next;
+    bool found;
+    char path[1];
+};
+
+/* Every path we tried, once each, in the order we first tried it. */
+static PROBE *first_probe = NULL;
+static PROBE *last_probe = NULL;
+
+/* Output files we kept, in the order we finished them. */
+static STRLIST *first_kept = NULL;
+static STRLIST *last_kept = NULL;
+
+/* Include directories in the order they were added. */
+static STRLIST *incdirlist = NULL;
+static size_t nof_directories = 0;
+
+/* Pass we're in right now, counted by begin_file_pass(). */
+static unsigned int current_pass = 0;
+
+void add_include_directory(const char *dir)
+{
+    STRLIST **tail;
+    STRLIST *newdir;
+
+    assert(dir != NULL);
+
+    for (tail = &incdirlist; *tail != NULL; tail = &(*tail)->next) {
+        if (strcmp((*tail)->buf, dir) == 0) {
+            return;
+        }
+    }
+
+    newdir = dalloc(STRLISTSIZE + strlen(dir) + 1); /* [phf] was small */
+    strcpy(newdir->buf, dir);
+    *tail = newdir;
+    nof_directories++;
+}
+
+void begin_file_pass(void)
+{
+    current_pass++;
+}
+
+static RESOLVED **find_resolved(const char *name)
+{
+    RESOLVED **link;
+    size_t hash = hash_bytes(HASH_BYTES_INIT, name, strlen(name)) & RHASHAND;
+
+    for (link = &RHash[hash]; *link != NULL; link = &(*link)->next) {
+        if (strcmp((*link)->name, name) == 0) {
+            break;
+        }
+    }
+
+    return link;
+}
+
+static bool get_identity(const char *path, IDENTITY *identity, size_t *size)
+{
+    struct stat st;
+
+    if (stat(path, &st) != 0) {
+        return false;
+    }
+
+    identity->device = st.st_dev;
+    identity->inode = st.st_ino;
+    identity->mtime = st.st_mtime;
+    if (size != NULL) {
+        *size = st.st_size;
+    }
+    return true;
+}
+
+static bool same_identity(const IDENTITY *a, const IDENTITY *b)
+{
+    return a->device == b->device && a->inode == b->inode && a->mtime == b->mtime;
+}
+
+static char *
+addpart(const char *dir, const char *file)
+{
+    char *dest = dalloc(strlen(dir) + 1 + strlen(file) + 1);
+    size_t pos;
+
+    strcpy(dest, dir);
+    pos = strlen(dest);
+    if (pos > 0 && dest[pos-1] != ':' && dest[pos-1] != '/') {
+        dest[pos] = '/';
+        pos++;
+    }
+    strcpy(dest + pos, file);
+
+    return dest;
+}
+
+/*
+  Remember that we tried path. A later search can find a file that
+  was missing before (INCDIR added a directory, or it showed up),
+  so we update found, but it never forgets a path.
+*/
+static void note_probe(const char *path, bool found)
+{
+    PROBE *probe;
+
+    for (probe = first_probe; probe != NULL; probe = probe->next) {
+        if (strcmp(probe->path, path) == 0) {
+            probe->found = probe->found || found;
+            return;
+        }
+    }
+
+    probe = dalloc(sizeof(PROBE) + strlen(path));
+    strcpy(probe->path, path);
+    probe->found = found;
+    if (last_probe == NULL) {
+        first_probe = probe;
+    }
+    else {
+        last_probe->next = probe;
+    }
+    last_probe = probe;
+}
+
+/* Search for name the hard way, remember where it is (if anywhere). */
+static FILE *search(RESOLVED *res, const char *mode)
+{
+    STRLIST *incdir;
+    FILE *f;
+
+    debug_fmt(DEBUG_CHANNEL_DETAIL, "searching for '%s'", res->name);
+
+    if (res->path != NULL) {
+        dfree(res->path);
+        res->path = NULL;
+    }
+    res->directories = nof_directories;
+
+    f = fopen(res->name, mode);
+    note_probe(res->name, f != NULL);
+    if (f != NULL) {
+        res->path = checked_strdup(res->name);
+    }
+    /* Don't use the incdirlist for absolute pathnames */
+    /* TODO: that looks like an Amiga leftover? [phf] */
+    else if (strchr(res->name, ':') == NULL) {
+        for (incdir = incdirlist; incdir != NULL; incdir = incdir->next) {
+            char *path = addpart(incdir->buf, res->name);
+            f = fopen(path, mode);
+            note_probe(path, f != NULL);
+            if (f != NULL) {
+                res->path = path;
+                break;
+            }
+            dfree(path);
+        }
+    }
+
+    if (res->path != NULL && !get_identity(res->path, &res->identity, &res->size_on_disk)) {
+        /* can't stat(2) what we just opened? then don't trust it */
+        res->identity.device = res->identity.inode = 0;
+        res->identity.mtime = -1;
+        res->size_on_disk = 0;
+    }
+
+    return f;
+}
+
+FILE *
+pfopen(const char *name, const char *mode)
+{
+    RESOLVED **link;
+    RESOLVED *res;
+    FILE *f;
+
+    assert(name != NULL);
+    assert(mode != NULL);
+
+    link = find_resolved(name);
+    if (*link == NULL) {
+        *link = dalloc(sizeof(RESOLVED));
+        (*link)->name = checked_strdup(name);
+        if (last_used == NULL) {
+            first_used = *link;
+        }
+        else {
+            last_used->next_used = *link;
+        }
+        last_used = *link;
+        return search(*link, mode);
+    }
+    res = *link;
+
+    if (res->path == NULL) {
+        /* only new include directories can change our mind */
+        if (res->directories == nof_directories) {
+            return NULL;
+        }
+        return search(res, mode);
+    }
+
+    f = fopen(res->path, mode);
+    if (f != NULL) {
+        IDENTITY identity;
+        if (get_identity(res->path, &identity, &res->size_on_disk) && !same_identity(&identity, &res->identity)) {
+            warning_fmt("File '%s' changed during assembly.", res->path);
+            res->identity = identity;
+        }
+        return f;
+    }
+
+    /* gone? look again, maybe it's somewhere else now */
+    return search(res, mode);
+}
+
+/* Where name is, if anywhere, without opening it again if we know. */
+static RESOLVED *resolve(const char *name)
+{
+    RESOLVED *res = *find_resolved(name);
+    FILE *f;
+
+    if (res != NULL && res->path != NULL) {
+        return res;
+    }
+    if (res != NULL && res->directories == nof_directories) {
+        return NULL;
+    }
+
+    /* never looked, or there are new places to look */
+    f = pfopen(name, "rb");
+    if (f == NULL) {
+        return NULL;
+    }
+    (void) fclose(f);
+
+    res = *find_resolved(name);
+    assert(res != NULL && res->path != NULL);
+    return res;
+}
+
+/* Another name already loaded from the same path? */
+static const RESOLVED *find_loaded(const char *path)
+{
+    const RESOLVED *res;
+    size_t i;
+
+    for (i = 0; i < RHASHSIZE; i++) {
+        for (res = RHash[i]; res != NULL; res = res->next) {
+            if (res->loaded && res->path != NULL && strcmp(res->path, path) == 0) {
+                return res;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/* Read all of the file into memory the hard way. */
+static bool read_contents(RESOLVED *res)
+{
+    FILE *f = fopen(res->path, "rb");
+    unsigned char *data = NULL;
+    long size;
+
+    if (f == NULL) {
+        return false;
+    }
+    if (fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) < 0 || fseek(f, 0, SEEK_SET) != 0) {
+        (void) fclose(f);
+        return false;
+    }
+    if (size > 0) {
+        data = dalloc(size);
+        if (fread(data, 1, size, f) != (size_t) size) {
+            dfree(data);
+            (void) fclose(f);
+            return false;
+        }
+    }
+    (void) fclose(f);
+
+    res->contents = data;
+    res->size = size;
+    return true;
+}
+
+#if HAVE_MMAP
+/* Map the file into memory, pages get read when we touch them. */
+static bool map_contents(RESOLVED *res)
+{
+    struct stat st;
+    void *data;
+    int fd = open(res->path, O_RDONLY);
+
+    if (fd < 0) {
+        return false;
+    }
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        (void) close(fd);
+        return false;
+    }
+    if (st.st_size == 0) {
+        /* mmap(2) doesn't like empty files */
+        (void) close(fd);
+        res->contents = NULL;
+        res->size = 0;
+        return true;
+    }
+
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    (void) close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    res->contents = data;
+    res->size = st.st_size;
+    return true;
+}
+#endif
+
+bool file_contents(const char *name, const unsigned char **contents, size_t *size)
+{
+    RESOLVED *res;
+    const RESOLVED *other;
+
+    assert(name != NULL);
+    assert(contents != NULL);
+    assert(size != NULL);
+
+    res = resolve(name);
+    if (res == NULL) {
+        return false;
+    }
+
+    if (!res->loaded) {
+        if ((other = find_loaded(res->path)) != NULL) {
+            res->contents = other->contents;
+            res->size = other->size;
+        }
+        else
+#if HAVE_MMAP
+        if (!map_contents(res))
+#endif
+        {
+            if (!read_contents(res)) {
+                return false;
+            }
+        }
+        res->loaded = true;
+        debug_fmt(DEBUG_CHANNEL_DETAIL, "loaded %zu bytes of '%s'", res->size, res->path);
+    }
+
+    *contents = res->contents;
+    *size = res->size;
+    return true;
+}
+
+bool file_size(const char *name, size_t *size)
+{
+    const RESOLVED *res;
+
+    assert(name != NULL);
+    assert(size != NULL);
+
+    res = resolve(name);
+    if (res == NULL) {
+        return false;
+    }
+
+    *size = res->loaded ? res->size : res->size_on_disk;
+    return true;
+}
+
+/* Read length bytes at offset of the file into data. */
+static bool read_slice(const char *path, size_t offset, size_t length, unsigned char *data)
+{
+#if HAVE_MMAP
+    int fd = open(path, O_RDONLY);
+    size_t done = 0;
+
+    if (fd < 0) {
+        return false;
+    }
+    while (done < length) {
+        ssize_t got = pread(fd, data + done, length - done, offset + done);
+        if (got <= 0) {
+            break;
+        }
+        done += got;
+    }
+    (void) close(fd);
+
+    return done == length;
+#else
+    FILE *f = fopen(path, "rb");
+    bool ok;
+
+    if (f == NULL) {
+        return false;
+    }
+    ok = fseek(f, offset, SEEK_SET) == 0 && fread(data, 1, length, f) == length;
+    (void) fclose(f);
+
+    return ok;
+#endif
+}
+
+bool file_slice(const char *name, size_t offset, size_t length, const unsigned char **contents)
+{
+    RESOLVED *res;
+    SLICE *slice;
+
+    assert(name != NULL);
+    assert(length > 0);
+    assert(contents != NULL);
+
+    res = resolve(name);
+    if (res == NULL) {
+        return false;
+    }
+
+    /* all of it is in memory already? */
+    if (res->loaded) {
+        assert(offset + length <= res->size);
+        *contents = res->contents + offset;
+        return true;
+    }
+
+    assert(offset + length <= res->size_on_disk);
+
+    for (slice = res->slices; slice != NULL; slice = slice->next) {
+        if (slice->offset == offset && slice->length == length) {
+            *contents = slice->data;
+            return true;
+        }
+    }
+
+    slice = dalloc(sizeof(SLICE));
+    slice->offset = offset;
+    slice->length = length;
+    slice->data = dalloc(length);
+    if (!read_slice(res->path, offset, length, slice->data)) {
+        dfree(slice->data);
+        dfree(slice);
+        return false;
+    }
+    slice->next = res->slices;
+    res->slices = slice;
+    debug_fmt(DEBUG_CHANNEL_DETAIL, "read %zu bytes at %zu of '%s'", length, offset, res->path);
+
+    *contents = slice->data;
+    return true;
+}
+
+bool report_missing_file(const char *name)
+{
+    RESOLVED *res = *find_resolved(name);
+
+    assert(res != NULL);
+
+    if (res->reported_pass == current_pass) {
+        return false;
+    }
+    res->reported_pass = current_pass;
+    return true;
+}
+
+void set_dependency_file_name(const char *name)
+{
+    assert(dependency_file_name == NULL);
+    assert(name != NULL);
+    dependency_file_name = name;
+}
+
+/* Where we found it, or the name itself if we didn't. */
+static const char *dependency(const RESOLVED *res)
+{
+    return (res->path != NULL) ? res->path : res->name;
+}
+
+/* Did an earlier name end up at the same dependency? */
+static bool seen_dependency(const RESOLVED *res)
+{
+    const RESOLVED *earlier;
+
+    for (earlier = first_used; earlier != res; earlier = earlier->next_used) {
+        if (strcmp(dependency(earlier), dependency(res)) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Write a file name the way make wants it. */
+static void put_make_name(const char *name, FILE *file)
+{
+    for (; *name != '\0'; name++) {
+        switch (*name) {
+            case ' ':
+            case '#':
+                putc('\\', file);
+                putc(*name, file);
+                break;
+            case '$':
+                fputs("$$", file);
+                break;
+            default:
+                putc(*name, file);
+                break;
+        }
+    }
+}
+
+/* Write name as a prerequisite in the rule, or as a rule of its own. */
+static void put_dependency(const char *name, bool rule, FILE *file)
+{
+    if (rule) {
+        fputs(" \\\n ", file);
+        put_make_name(name, file);
+    }
+    else {
+        putc('\n', file);
+        put_make_name(name, file);
+        fputs(":\n", file);
+    }
+}
+
+/* Did searching for res try path? */
+static bool candidate(const RESOLVED *res, const char *path)
+{
+    const STRLIST *incdir;
+    bool tried = (strcmp(path, res->name) == 0);
+
+    for (incdir = incdirlist; incdir != NULL && !tried; incdir = incdir->next) {
+        char *name = addpart(incdir->buf, res->name);
+        tried = (strcmp(name, path) == 0);
+        dfree(name);
+    }
+
+    return tried;
+}
+
+/* A missing file and where we looked for it, see put_candidate(). */
+typedef struct
+{
+    const RESOLVED *res;
+    bool rule;
+    FILE *file;
+}
+MISSING;
+
+static void put_candidate(const char *path, bool found, void *data)
+{
+    const MISSING *missing = data;
+
+    if (!found && candidate(missing->res, path)) {
+        put_dependency(path, missing->rule, missing->file);
+    }
+}
+
+/* Write the dependency on res, every place we looked if it's missing. */
+static void put_resolved(const RESOLVED *res, bool rule, FILE *file)
+{
+    if (res->path != NULL) {
+        put_dependency(res->path, rule, file);
+    }
+    else {
+        MISSING missing;
+        missing.res = res;
+        missing.rule = rule;
+        missing.file = file;
+        for_each_probe(put_candidate, &missing);
+    }
+}
+
+/*
+  The rule lists every file we tried to open, found or not; a
+  missing one simply doesn't exist for make, so the target gets
+  rebuilt until it shows up. For a missing one that's every path
+  we tried in the INCDIR directories too, it may show up in any of
+  them. Every dependency also gets a rule of its own without
+  prerequisites, so make doesn't give up when one of them is
+  deleted.
+*/
+void write_dependency_file(const char *target)
+{
+    const RESOLVED *res;
+    FILE *file;
+
+    assert(target != NULL);
+
+    if (dependency_file_name == NULL) {
+        /* no name, nothing to do */
+        return;
+    }
+
+    file = create_output(dependency_file_name);
+    if (file == NULL) {
+        warning_fmt("Unable to open dependency file '%s'.", dependency_file_name);
+        return;
+    }
+
+    put_make_name(target, file);
+    putc(':', file);
+    for (res = first_used; res != NULL; res = res->next_used) {
+        if (!seen_dependency(res)) {
+            put_resolved(res, true, file);
+        }
+    }
+    putc('\n', file);
+
+    for (res = first_used; res != NULL; res = res->next_used) {
+        if (!seen_dependency(res)) {
+            put_resolved(res, false, file);
+        }
+    }
+
+    if (!finish_output(file, true)) {
+        warning_fmt("Problem closing dependency file '%s'.", dependency_file_name);
+    }
+}
+
+/*
+  The file a symlink eventually points to, NULL if name isn't
+  a symlink or doesn't lead to an existing file.
+*/
+static char *link_target(const char *name)
+{
+#if HAVE_SYMLINKS
+    struct stat st;
+    char *real;
+    char *target;
+
+    if (lstat(name, &st) != 0 || !S_ISLNK(st.st_mode)) {
+        return NULL;
+    }
+    if ((real = realpath(name, NULL)) == NULL) {
+        return NULL;
+    }
+    target = checked_strdup(real);
+    free(real);
+    return target;
+#else
+    (void) name;
+    return NULL;
+#endif
+}
+
+/*
+  Outputs go to a temporary file next to the real one, so they
+  end up on the same file system and rename(2) can replace the
+  real one in a single step; nobody ever sees half a binary.
+  For a symlink the real one is the file it points to, renaming
+  over the link would replace the link itself.
+*/
+FILE *create_output(const char *name)
+{
+    OUTFILE *out;
+    struct stat st;
+    bool exists;
+
+    assert(name != NULL);
+
+    out = dalloc(sizeof(OUTFILE));
+    out->name = checked_strdup(name);
+    out->target = link_target(name);
+    if (out->target == NULL) {
+        out->target = checked_strdup(name);
+    }
+    exists = (stat(out->target, &st) == 0);
+
+    /* devices and such we can't replace, so we write them directly */
+    if (exists && !S_ISREG(st.st_mode)) {
+        out->file = fopen(out->target, "wb");
+    }
+#if HAVE_SYMLINKS
+    /* a dangling symlink, writing through it creates the file */
+    else if (!exists && lstat(name, &st) == 0) {
+        out->file = fopen(name, "wb");
+    }
+#endif
+    else {
+        size_t size = strlen(out->target) + 8;
+        out->temp = dalloc(size);
+        (void) strlcpy(out->temp, out->target, size);
+#if HAVE_MKSTEMP
+        (void) strlcat(out->temp, ".XXXXXX", size);
+        {
+            int fd = mkstemp(out->temp);
+            if (fd >= 0) {
+                /*
+                  mkstemp(3) makes it private, we want the mode of
+                  the file we replace or else the usual one
+                */
+                mode_t mode;
+                if (exists) {
+                    mode = st.st_mode & 07777;
+                }
+                else {
+                    mode_t mask = umask(0);
+                    (void) umask(mask);
+                    mode = 0666 & ~mask;
+                }
+                (void) fchmod(fd, mode);
+                out->file = fdopen(fd, "wb");
+                if (out->file == NULL) {
+                    (void) close(fd);
+                    (void) remove(out->temp);
+                }
+            }
+        }
+#else
+        (void) strlcat(out->temp, ".tmp", size);
+        out->file = fopen(out->temp, "wb");
+#endif
+    }
+
+    if (out->file == NULL) {
+        dfree(out->temp);
+        dfree(out->target);
+        dfree(out->name);
+        dfree(out);
+        return NULL;
+    }
+
+    out->next = outfiles;
+    outfiles = out;
+    return out->file;
+}
+
+/* Do the two files have the same contents? */
+static bool same_contents(const char *a, const char *b)
+{
+    enum { CHUNK = 65536 };
+    struct stat sa, sb;
+    FILE *fa;
+    FILE *fb;
+    unsigned char *ba;
+    unsigned char *bb;
+    bool same = true;
+
+    if (stat(a, &sa) != 0 || stat(b, &sb) != 0 || sa.st_size != sb.st_size) {
+        return false;
+    }
+    if ((fa = fopen(a, "rb")) == NULL) {
+        return false;
+    }
+    if ((fb = fopen(b, "rb")) == NULL) {
+        (void) fclose(fa);
+        return false;
+    }
+
+    ba = scratch_alloc(SCRATCH_LINE, CHUNK);
+    bb = scratch_alloc(SCRATCH_LINE, CHUNK);
+    while (same) {
+        size_t na = fread(ba, 1, CHUNK, fa);
+        size_t nb = fread(bb, 1, CHUNK, fb);
+        same = (na == nb) && memcmp(ba, bb, na) == 0;
+        if (na < CHUNK) {
+            break;
+        }
+    }
+    /* a read error doesn't prove anything */
+    if (ferror(fa) || ferror(fb)) {
+        same = false;
+    }
+
+    (void) fclose(fa);
+    (void) fclose(fb);
+    return same;
+}
+
+bool finish_output(FILE *file, bool keep)
+{
+    OUTFILE **link;
+    OUTFILE *out;
+    bool ok;
+
+    assert(file != NULL);
+
+    for (link = &outfiles; *link != NULL && (*link)->file != file; link = &(*link)->next) {
+        /* just looking */
+    }
+    assert(*link != NULL);
+    out = *link;
+    *link = out->next;
+
+    ok = (fclose(file) == 0);
+
+    /* only a successful run replaces anything */
+    if (number_of_errors() > 0 || number_of_fatals() > 0) {
+        keep = false;
+    }
+
+    if (out->temp != NULL) {
+        if (!ok || !keep || same_contents(out->temp, out->target)) {
+            /* leave the old file and its modification time alone */
+            (void) remove(out->temp);
+        }
+        else {
+#if !HAVE_MKSTEMP
+            /* rename(2) doesn't replace files everywhere */
+            (void) remove(out->target);
+#endif
+            ok = (rename(out->temp, out->target) == 0);
+            if (!ok) {
+                (void) remove(out->temp);
+            }
+        }
+    }
+
+    if (ok && keep) {
+        STRLIST *kept = dalloc(STRLISTSIZE + strlen(out->name) + 1);
+        strcpy(kept->buf, out->name);
+        if (last_kept == NULL) {
+            first_kept = kept;
+        }
+        else {
+            last_kept->next = kept;
+        }
+        last_kept = kept;
+    }
+
+    dfree(out->temp);
+    dfree(out->target);
+    dfree(out->name);
+    dfree(out);
+    return ok;
+}
+
+void abandon_outputs(void)
+{
+    while (outfiles != NULL) {
+        (void) finish_output(outfiles->file, false);
+    }
+}
+
+void for_each_probe(void (*visit)(const char *path, bool found, void *data), void *data)
+{
+    const PROBE *probe;
+
+    assert(visit != NULL);
+
+    for (probe = first_probe; probe != NULL; probe = probe->next) {
+        visit(probe->path, probe->found, data);
+    }
+}
+
+void for_each_kept_output(void (*visit)(const char *name, void *data), void *data)
+{
+    const STRLIST *kept;
+
+    assert(visit != NULL);
+
+    for (kept = first_kept; kept != NULL; kept = kept->next) {
+        visit(kept->buf, data);
+    }
+}
+
+/* vim: set tabstop=4 softtabstop=4 expandtab shiftwidth=4 autoindent: */
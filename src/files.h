@@ -0,0 +1,160 @@
+#ifndef _DASM_FILES_H
+#define _DASM_FILES_H
+
+/*
+    $Id$
+
+    the DASM macro assembler (aka small systems cross assembler)
+
+    Copyright (c) 1988-2002 by Matthew Dillon.
+    Copyright (c) 1995 by Olaf "Rhialto" Seibert.
+    Copyright (c) 2003-2008 by Andrew Davie.
+    Copyright (c) 2008 by Peter H. Froehlich.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/**
+ * @file
+ *
+ * @brief Finding the files INCLUDE and INCBIN refer to, and
+ * writing output files.
+ *
+ * A file name is tried as given first, then in each INCDIR
+ * directory in turn. Every pass includes the same files again,
+ * so we remember where we found each name (or that we didn't
+ * find it anywhere) and go straight there next time; a miss is
+ * only retried once more INCDIR directories have been added.
+ * We also remember the identity (device, inode, modification
+ * time) of each file we found so we notice when a file changes
+ * while we're assembling. Binary files for INCBIN (or the parts
+ * of them we need) are kept in memory for the whole run.
+ *
+ * Output files are written to a temporary file first and only
+ * replace the real one once they're complete, and only if their
+ * contents changed; so emulators watching a binary never see half
+ * of it, and make doesn't rebuild what depends on an output that
+ * came out just like last time.
+ */
+
+#include "asm.h"
+
+/**
+ * @brief Add a directory to search for include files, -I option
+ * and INCDIR pseudo-op; directories already known are ignored.
+ */
+void add_include_directory(const char *dir);
+
+/**
+ * @brief Start a new pass, call at the start of every pass.
+ */
+void begin_file_pass(void);
+
+/**
+ * @brief Open the given file, searching the include directories
+ * if necessary; NULL if it's nowhere to be found.
+ */
+FILE *pfopen(const char *name, const char *mode);
+
+/**
+ * @brief Get the contents of the given file, searching the include
+ * directories if necessary; false if it's nowhere to be found or
+ * can't be read.
+ * @note The file is read (or rather mapped into memory) only once
+ * per run, later calls for the same name don't even open it. So
+ * all passes see the same bytes, even if the file changes.
+ */
+bool file_contents(const char *name, const unsigned char **contents, size_t *size);
+
+/**
+ * @brief Get the size of the given file, searching the include
+ * directories if necessary; false if it's nowhere to be found.
+ * @note Doesn't open the file again once we found it.
+ */
+bool file_size(const char *name, size_t *size);
+
+/**
+ * @brief Get length bytes at offset of the given file, for INCBIN
+ * with offset and length; false if the file can't be read.
+ * @note Only reads the part we need, once per run; if all of the
+ * file is in memory already (see file_contents()) we use that.
+ * @pre length > 0 && offset + length <= size from file_size()
+ */
+bool file_slice(const char *name, size_t offset, size_t length, const unsigned char **contents);
+
+/**
+ * @brief Set the name of the dependency file, -B option.
+ */
+void set_dependency_file_name(const char *name);
+
+/**
+ * @brief Write a make rule saying target depends on every file we
+ * tried to open for INCLUDE and INCBIN (and the source itself),
+ * where we found it after searching the include directories; also
+ * files we didn't find, so adding them rebuilds the target.
+ * @note Does nothing without set_dependency_file_name().
+ */
+void write_dependency_file(const char *target);
+
+/**
+ * @brief Create the named output file; we actually write a
+ * temporary file next to it until finish_output(). NULL if we
+ * can't create it.
+ */
+FILE *create_output(const char *name);
+
+/**
+ * @brief Close an output file from create_output(); if keep,
+ * the temporary file replaces the real one in a single step,
+ * unless the real one has the same contents already, then we
+ * leave it (and its modification time) alone. If not keep we
+ * remove the temporary file. False if something went wrong.
+ * @note Nothing is kept once the run had errors or fatals, the
+ * old outputs stay as they were; a broken binary (or listing,
+ * or symbol file) must not look like a fresh one to make.
+ */
+bool finish_output(FILE *file, bool keep);
+
+/**
+ * @brief Remove the temporary files of all outputs not finished
+ * yet, when we're giving up.
+ */
+void abandon_outputs(void);
+
+/**
+ * @brief Call visit for every path we tried to open while looking
+ * for INCLUDE and INCBIN files (and the source itself), once each,
+ * with whether it was there; the result cache checks these to know
+ * if a run would come out the same.
+ */
+void for_each_probe(void (*visit)(const char *path, bool found, void *data), void *data);
+
+/**
+ * @brief Call visit for every output file finish_output() kept so
+ * far, in the order they were finished; a file kept twice shows
+ * up twice.
+ */
+void for_each_kept_output(void (*visit)(const char *name, void *data), void *data);
+
+/**
+ * @brief True the first time in a pass that the given name could
+ * not be opened, so callers warn only once per pass.
+ * @pre pfopen() or file_contents() just failed for name
+ */
+bool report_missing_file(const char *name);
+
+#endif /* _DASM_FILES_H */
+
+/* vim: set tabstop=4 softtabstop=4 expandtab shiftwidth=4 autoindent: */
@@ -30,64 +30,89 @@
 /*
  *  FTOBIN.C
  *
- *  FTOBIN format infile [outfile]
+ *  FTOBIN [-f#] format infile [outfile]
  *
  *  format: format used when assembling (asm705/asm65)
- *	    1,2,3	    -generate sequenced (raw) binary file
+ *	    1,2,3,6	    -generate sequenced (raw) binary file
  *
- *  Used with formats 1 or 2 (format 3 is already raw binary).	This
- *  program converts formats 1 and 2 to format 3.  This is required
- *  because some assembly programs might want to reverse-index the
- *  origin (go back), usually to lay down a checksum, and this can only be
- *  done with format 2.
+ *  Used with formats 1, 2, or 6 (format 3 is already raw binary).
+ *  This program converts formats 1, 2, and 6 to format 3.  This is
+ *  required because some assembly programs might want to
+ *  reverse-index the origin (go back), usually to lay down a
+ *  checksum, and this can only be done with format 2 (or 6).
  *
- *  Restrictions:   Lowest address must be referenced first.
+ *  The output starts at the lowest address of any segment; gaps
+ *  between segments are filled with $FF (or the byte given with
+ *  -f). When filling with 0 we just seek over the gaps, leaving
+ *  holes in a sparse file, so big gaps cost neither time nor disk
+ *  space.
  */
 
+#if defined(__WINDOWS__) || defined(_WIN32) || defined(_WIN64)
+#	define HAVE_PWRITE 0
+#else
+	/* pwrite(2), ftruncate(2) */
+#	define _POSIX_C_SOURCE 200809L
+#	define HAVE_PWRITE 1
+#endif
+
+#include "objfile.h"
+
 #include <assert.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+
+#if HAVE_PWRITE
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <unistd.h>
+#endif
 
-typedef unsigned char ubyte;
-typedef unsigned short uword;
+/* Size of the buffer we fill gaps from. */
+#define FILLBUF 65536
 
-#define PERLINE 16
+static int fill = 255;
 
-static uword getwlh(FILE *in);
 static void exiterr(const char *str);
-static void convert(short format, FILE *in, FILE *out);
+static void exitfileerr(const char *name, const char *str);
+static void convert(const OBJFILE *obj, const char *outname);
 
 int
 main(int ac, char **av)
 {
-    short format;
-    FILE *infile;
-    FILE *outfile;
+    int format;
+    int i = 1;
+    OBJFILE obj;
+    const char *error;
 
-    if (ac < 3) {
-	puts("FTOBIN format infile [outfile]");
-	puts("format 1,2, or 3.  3=raw");
+    if (i < ac && strncmp(av[i], "-f", 2) == 0) {
+	char *end;
+	fill = (int) strtol(av[i] + 2, &end, 0);
+	if (end == av[i] + 2 || *end != '\0' || fill < 0 || fill > 255)
+	    exiterr("fill byte for -f must be 0 to 255");
+	i++;
+    }
+    if (ac - i < 2 || ac - i > 3) {
+	puts("FTOBIN [-f#] format infile [outfile]");
+	puts("format 1,2,3, or 6.  3=raw, 6=extended RAS");
+	puts("-f# fills gaps with byte # (default 255), -f0 leaves holes");
 	puts("(C)Copyright 1988 by Matthew Dillon, All Rights Reserved");
 	exit(EXIT_FAILURE);
     }
-    format = strtol(av[1], NULL, 0);
-    if (format < 1 || format > 3)
-	exiterr("specify infile format 1, 2, or 3");
+    format = strtol(av[i], NULL, 0);
+    if (!valid_object_format(format))
+	exiterr("specify infile format 1, 2, 3, or 6");
     if (format == 3) {
 	puts("Note: Format 3 is already a raw binary file, output will");
 	puts("be equivalent to input");
     }
-    infile = fopen(av[2], "r");
-    if (infile == NULL)
-	exiterr("unable to open input file");
-    outfile = (av[3]) ? fopen(av[3], "w") : stdout;
-    if (outfile == NULL)
-	exiterr("unable to open output file");
-    convert(format, infile, outfile);
-    fclose(infile);
-    fclose(outfile);
+    error = load_object(av[i+1], format, &obj);
+    if (error != NULL)
+	exitfileerr(av[i+1], error);
+    convert(&obj, (ac - i == 3) ? av[i+2] : NULL);
+    unload_object(&obj);
     return(0);
 }
 
@@ -100,99 +125,155 @@ exiterr(const char *str)
     exit(EXIT_FAILURE);
 }
 
+static
+void
+exitfileerr(const char *name, const char *str)
+{
+    fputs(name, stderr);
+    fputs(": ", stderr);
+    exiterr(str);
+}
+
 /*
  *  Formats:
  *
  *  1:	origin (word:lsb,msb) + data
  *  2:	origin (word:lsb,msb) + length (word:lsb,msb) + data  (repeat)
  *  3:	data
- *
- *  Hex output:
- *
- *  :lloooo00(ll bytes hex code)cc	  ll=# of bytes
- *					oooo=origin
- *					  cc=invert of checksum all codes
+ *  6:	extended RAS, 32-bit origins and lengths, see objfile.h
  */
 
+#if HAVE_PWRITE
+/* Write all of data at offset of the file. */
 static
-void
-convert(short format, FILE *in, FILE *out)
+bool
+write_at(int fd, const unsigned char *data, size_t length, unsigned long offset)
 {
-    uword org = 0;
-    uword base = 0;
-    long len;
-    long maxseek = 0;
-    ubyte buf[256];
-
-    if (format < 3)
-	base = org = getwlh(in);
-    if (format == 2) {
-	len = getwlh(in);
-    } else {
-	long begin = ftell(in);
-	fseek(in, 0L, 2);
-	len = ftell(in) - begin;
-	fseek(in, begin, 0);
+    while (length > 0) {
+	ssize_t done = pwrite(fd, data, length, offset);
+	if (done <= 0)
+	    return false;
+	data += done;
+	length -= done;
+	offset += done;
     }
-    for (;;) {
-	if (len > 0) {
-	    while (len >= ((long) sizeof(buf))) {
-		int result = fread(buf, sizeof(buf), 1, in);
-		assert(result == 1);
-		fwrite(buf, sizeof(buf), 1, out);
-		len -= sizeof(buf);
-		org += sizeof(buf);
-	    }
-	    if (len) {
-		int result = fread(buf, (short)len, 1, in);
-		assert(result == 1);
-		fwrite(buf, (short)len, 1, out);
-		org += len;
-	    }
-	}
-	if (format == 2) {
-	    if (maxseek < org - base)
-		maxseek = org - base;
-	    org = getwlh(in);
-	    if (feof(in))
-		break;
-	    len = org - base;
-	    if (len < 0) {
-		puts("ERROR!  Reverse indexed to before beginning");
-		puts("*Initial* origin must be the lowest address");
-		return;
-	    }
-	    len -= maxseek;
-	    if (len > 0)
-		memset(buf, 255, sizeof(buf));
-	    while (len > 0) {
-		if (len >= ((long) sizeof(buf))) {
-		    fwrite(buf, sizeof(buf), 1, out);
-		    maxseek += sizeof(buf);
-		    len -= sizeof(buf);
-		} else {
-		    fwrite(buf, (short)len, 1, out);
-		    maxseek += len;
-		    len = 0;
-		}
+    return true;
+}
+
+static
+int
+compare_org(const void *a, const void *b)
+{
+    const OBJSEGMENT *x = *(const OBJSEGMENT * const *) a;
+    const OBJSEGMENT *y = *(const OBJSEGMENT * const *) b;
+    return (x->org > y->org) - (x->org < y->org);
+}
+
+/*
+ *  Write the gaps between segments first, then the segments in
+ *  the order the file has them; later segments overwrite earlier
+ *  ones, just like seeking back in the old days.
+ */
+static
+bool
+write_file(const OBJFILE *obj, int fd)
+{
+    unsigned long size = obj->highest - obj->lowest;
+    size_t i;
+
+    if (fill != 0) {
+	const OBJSEGMENT **sorted = malloc(obj->count * sizeof(OBJSEGMENT *));
+	unsigned char *buf = malloc(FILLBUF);
+	unsigned long end = obj->lowest;
+
+	if (sorted == NULL || buf == NULL)
+	    exiterr("out of memory");
+	memset(buf, fill, FILLBUF);
+	for (i = 0; i < obj->count; i++)
+	    sorted[i] = &obj->segments[i];
+	qsort(sorted, obj->count, sizeof(OBJSEGMENT *), compare_org);
+
+	for (i = 0; i < obj->count; i++) {
+	    while (end < sorted[i]->org) {
+		size_t len = (sorted[i]->org - end > FILLBUF) ? FILLBUF : sorted[i]->org - end;
+		if (!write_at(fd, buf, len, end - obj->lowest))
+		    return false;
+		end += len;
 	    }
-	    fseek(out, (long)(org - base), 0);
-	    len = getwlh(in);
-	} else {
-	    break;
+	    if (end < sorted[i]->org + sorted[i]->length)
+		end = sorted[i]->org + sorted[i]->length;
 	}
+	free(buf);
+	free(sorted);
     }
+
+    for (i = 0; i < obj->count; i++) {
+	const OBJSEGMENT *seg = &obj->segments[i];
+	if (!write_at(fd, seg->data, seg->length, seg->org - obj->lowest))
+	    return false;
+    }
+
+    /* holes are only holes if the file ends after them */
+    return ftruncate(fd, size) == 0;
 }
+#endif
 
+/*
+ *  Pipes and such can't seek, so put the whole image together in
+ *  memory and write it in one go.
+ */
 static
-uword
-getwlh(FILE *in)
+bool
+write_stream(const OBJFILE *obj, FILE *out)
 {
-    uword result;
+    unsigned long size = obj->highest - obj->lowest;
+    unsigned char *image;
+    size_t i;
+    bool ok;
+
+    image = malloc(size > 0 ? size : 1);
+    if (image == NULL)
+	exiterr("out of memory");
+    memset(image, fill, size);
+    for (i = 0; i < obj->count; i++) {
+	const OBJSEGMENT *seg = &obj->segments[i];
+	memcpy(image + (seg->org - obj->lowest), seg->data, seg->length);
+    }
+    ok = fwrite(image, 1, size, out) == size;
+    free(image);
+    return ok;
+}
+
+static
+void
+convert(const OBJFILE *obj, const char *outname)
+{
+    FILE *out = stdout;
+    bool ok;
+
+    if (outname != NULL) {
+	out = fopen(outname, "wb");
+	if (out == NULL)
+	    exitfileerr(outname, "unable to open output file");
+    }
+
+    if (obj->count == 0) {
+	ok = true;
+    }
+    else {
+#if HAVE_PWRITE
+	struct stat st;
+	if (outname != NULL && fstat(fileno(out), &st) == 0 && S_ISREG(st.st_mode))
+	    ok = write_file(obj, fileno(out));
+	else
+#endif
+	    ok = write_stream(obj, out);
+    }
 
-    result = getc(in);
-    result += getc(in) << 8;
-    return(result);
+    if (outname != NULL && fclose(out) != 0)
+	ok = false;
+    if (!ok)
+	exitfileerr(outname != NULL ? outname : "stdout", "couldn't write to output file");
 }
 
 /* vim: set tabstop=4 softtabstop=4 expandtab shiftwidth=4 autoindent: */
@@ -30,10 +30,11 @@
 /*
  *  FTOHEX.C
  *
- *  FTOHEX format infile [outfile]
+ *  FTOHEX [options] format infile [outfile]
+ *  FTOHEX [options] format infile outfile infile outfile ...
  *
  *  format: format used when assembling (asm705/asm65)
- *	    1,2,3	    -generate straight hex file
+ *	    1,2,3,6	    -generate straight hex file
  */
 
 /*
@@ -50,54 +51,116 @@
         didn't mess with ">>" at all.)
 */
 
+#include "hexout.h"
+#include "objfile.h"
 #include "version.h"
 
 #include <assert.h>
+#include <stdbool.h>
 #include <stdio.h>
-#include <stdint.h>
 #include <stdlib.h>
 
-#define PERLINE 16
+/* Settings from the command line. */
+static size_t record_length = HEX_DEFAULT_RECORD;
+static const char *eol = "\r\n";
+static bool ctrl_z = true;
 
-static void convert(int format, FILE *in, FILE *out);
-static uint16_t get_word(FILE *in);
-static void put_hex(uint8_t c, FILE *out);
+static void convert(const OBJFILE *obj, HEXFILE *hex);
+static void convert_file(int format, const char *inname, const char *outname);
 /* TODO: maybe the warning flags *are* a bit too strong... */
 static void exit_error(const char *str);
+static void exit_file_error(const char *name, const char *str);
 static void usage_exit(void);
 
 int
 main(int argc, char **argv)
 {
     int format;
-    FILE *infile;
-    FILE *outfile;
+    int i = 1;
 
-    /* ensure at least 2 but at most 3 arguments! */
-    if (argc < 3 || argc > 4)
+    /* options come first, all of them single letters */
+    for (; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i++)
+    {
+        const char *str = argv[i] + 2;
+        switch (argv[i][1])
+        {
+        case 'r':
+            record_length = (size_t) strtol(str, (char **)NULL, 10);
+            if (record_length < 1 || record_length > HEX_MAX_RECORD)
+                exit_error("bytes per record must be 1 to 255");
+            break;
+        case 'l':
+            eol = "\n";
+            break;
+        case 'n':
+            ctrl_z = false;
+            break;
+        default:
+            usage_exit();
+            break;
+        }
+    }
+
+    /* format, infile, and either one outfile or pairs of files */
+    if (argc - i < 2 || (argc - i > 3 && (argc - i) % 2 == 0))
     {
         usage_exit();
     }
-    format = (int) strtol(argv[1], (char **)NULL, 10);
+    format = (int) strtol(argv[i], (char **)NULL, 10);
     /* TODO: error check strtol? doesn't matter much as 0 is not valid... */
-    if (format < 1 || format > 3)
-	exit_error("specify infile format 1, 2, or 3");
-    infile = fopen(argv[2], "r");
-    if (infile == NULL)
-	exit_error("unable to open input file");
-    /* Matt had (argv[3]) as condition, but that's ISO only [phf] */
-    outfile = (argc == 4) ? fopen(argv[3], "w") : stdout;
-    if (outfile == NULL)
-	exit_error("unable to open output file");
-    convert(format, infile, outfile);
-    /* TODO: make configurable for sanity */
-    putc('z'&0x1F, outfile); /* needed for old EPROM programmers! */
-    fclose(infile);
-    fclose(outfile); /* TODO: could close stdout, is that a problem? */
+    if (!valid_object_format(format))
+	exit_error("specify infile format 1, 2, 3, or 6");
+
+    if (argc - i == 2)
+    {
+        convert_file(format, argv[i+1], NULL);
+    }
+    for (i += 1; i + 1 < argc; i += 2)
+    {
+        convert_file(format, argv[i], argv[i+1]);
+    }
 
     return EXIT_SUCCESS;
 }
 
+/**
+ * @brief Convert one file, writing to stdout if outname is NULL.
+ */
+static
+void
+convert_file(int format, const char *inname, const char *outname)
+{
+    OBJFILE obj;
+    FILE *outfile;
+    HEXFILE *hex;
+    const char *error = load_object(inname, format, &obj);
+
+    if (error != NULL)
+        exit_file_error(inname, error);
+    /* Matt had (argv[3]) as condition, but that's ISO only [phf] */
+    outfile = (outname != NULL) ? fopen(outname, "wb") : stdout;
+    if (outfile == NULL)
+	exit_file_error(outname, "unable to open output file");
+
+    hex = malloc(sizeof(HEXFILE));
+    if (hex == NULL)
+        exit_error("out of memory");
+    /* the highest address only matters for S-records */
+    hex_begin(hex, HEX_INTEL, outfile, 0);
+    hex->record_length = record_length;
+    hex->eol = eol;
+    convert(&obj, hex);
+    if (!hex_end(hex))
+        exit_file_error(outname != NULL ? outname : "stdout", "couldn't write to output file");
+    free(hex);
+
+    if (ctrl_z)
+        putc('z'&0x1F, outfile); /* needed for old EPROM programmers! */
+    if (outfile != stdout && fclose(outfile) != 0)
+        exit_file_error(outname, "couldn't write to output file");
+    unload_object(&obj);
+}
+
 /**
  * @brief Abort with error message.
  */
@@ -110,6 +173,19 @@ exit_error(const char *str)
     exit(EXIT_FAILURE);
 }
 
+/**
+ * @brief Abort with error message about the given file.
+ */
+static
+void
+exit_file_error(const char *name, const char *str)
+{
+    assert(name != NULL);
+    assert(str != NULL);
+    fprintf(stderr, "error: %s: %s\n", name, str);
+    exit(EXIT_FAILURE);
+}
+
 /**
  * @brief Abort with usage message.
  */
@@ -120,8 +196,13 @@ usage_exit(void)
     (void) puts(DASM_ID);
     DASM_PRINT_LEGAL
     (void) puts("");
-    (void) puts("Usage: ftohex format infile [outfile]");
-    (void) puts("              format 1, 2, or 3 (raw).");
+    (void) puts("Usage: ftohex [options] format infile [outfile]");
+    (void) puts("       ftohex [options] format infile outfile infile outfile ...");
+    (void) puts("              format 1, 2, 3 (raw), or 6 (extended RAS).");
+    (void) puts("");
+    (void) puts("-r#      bytes per record 1-255 (default 16)");
+    (void) puts("-l       end lines with LF only (default CR/LF)");
+    (void) puts("-n       no Ctrl-Z at the end (default one for old EPROM programmers)");
     (void) puts("");
     DASM_PRINT_BUGS
     exit(EXIT_FAILURE);
@@ -133,125 +214,27 @@ usage_exit(void)
  *  1:  origin (word:lsb,msb) + data
  *  2:  origin (word:lsb,msb) + length (word:lsb,msb) + data  (repeat)
  *  3:  data
+ *  6:  extended RAS, 32-bit origins and lengths, see objfile.h
  *
  *  Hex output:
  *
  *  :lloooo00(ll bytes hex code)cc      ll=# of bytes
  *                                      oooo=origin
  *                                      cc=invert of checksum all codes
+ *
+ *  Data going past $FFFF gets extended linear address records
+ *  (type 04), see hexout.c for all the details.
  */
 
 static
 void
-convert(int format, FILE *in, FILE *out)
-{
-    /* TODO: rewrite this to new understanding of code and process! */
-    uint16_t org = 0;
-    unsigned int idx;
-    uint16_t len;
-    unsigned char buf[256];
-
-    if (format < 3)
-    {
-        org = get_word(in);
-    }
-    if (format == 2)
-    {
-        len = get_word(in);
-    }
-    else
-    {
-        /* TODO: refactor! */
-	long begin = ftell(in);
-	fseek(in, 0, SEEK_END);
-	len = ftell(in) - begin;
-	fseek(in, begin, 0);
-    }
-    for (;;) {
-	while (len > 0) {
-	    register unsigned char chk;
-	    register unsigned int i;
-	    int result;
-
-	    idx = (len > PERLINE) ? PERLINE : len;
-	    result = fread(buf, idx, 1, in);
-	    assert(result == 1);
-	    putc(':', out);
-	    put_hex(idx, out);
-	    put_hex(org >> 8, out);
-	    put_hex(org & 0xFF, out);
-	    putc('0', out);
-	    putc('0', out);
-	    chk = idx + (org >> 8) + (org & 0xFF);
-	    for (i = 0; i < idx; ++i) {
-		chk += buf[i];
-		put_hex(buf[i], out);
-	    }
-	    put_hex((unsigned char)-chk, out);
-            /* TODO: make configurable according to spec */
-	    putc('\r', out);
-	    putc('\n', out);
-	    len -= idx;
-	    org += idx;
-	}
-	if (format == 2) {
-	    org = get_word(in);
-	    if (feof(in))
-		break;
-	    len = get_word(in);
-	} else {
-	    break;
-	}
-    }
-    fprintf(out, ":00000001FF\r\n");
-}
-
-/**
- * @brief Read 16-bit word (in format "lsb, msb") from (binary)
- * stream "in".
- */
-static
-uint16_t
-get_word(FILE *in)
-{
-    uint16_t result = 0;
-    int buffer = EOF;
-
-    if ((buffer = getc(in)) == EOF)
-    {
-        exit_error("Unexcepted end of input file!");
-    }
-    result |= (buffer & 0xFF); /* mask out high bits, just in case */
-
-    if ((buffer = getc(in)) == EOF)
-    {
-        exit_error("Unexcepted end of input file!");
-    }
-    result |= (buffer & 0xFF) << 8; /* mask out high bits, shift to high */
-
-    return result;
-}
-
-/**
- * @brief Write 8-bit byte "c" to (text) stream "out" as two
- * ASCII hex digits (high nibble, low nibble of course).
- */
-static
-void
-put_hex(uint8_t c, FILE *out)
+convert(const OBJFILE *obj, HEXFILE *hex)
 {
-    static const char digits[] = {"0123456789ABCDEF"};
-
-    /* shift high to low, mask (>> portability, see above), write high digit */
-    if (putc(digits[(c >> 4) & 0x0F], out) == EOF)
-    {
-        exit_error("Couldn't write to output file!");
-    }
+    size_t i;
 
-    /* mask out high, write low digit */
-    if (putc(digits[c & 0x0F], out) == EOF)
+    for (i = 0; i < obj->count; i++)
     {
-        exit_error("Couldn't write to output file!");
+        hex_data(hex, obj->segments[i].org, obj->segments[i].data, obj->segments[i].length);
     }
 }
 
@@ -57,6 +57,7 @@ int Redo = 0;
 unsigned long	Redo_if = 0;
 
 bool	ListMode = true;
+bool	Echoed = false;	    /*	ECHO printed something, see cache.h */
 unsigned long	CheckSum;	    /*	output data checksum		*/
 
 int F_format = FORMAT_DEFAULT;
@@ -64,7 +65,6 @@ int F_format = FORMAT_DEFAULT;
 int F_verbose;
 const char	*F_outfile = "a.out";
 /*@null@*/ char	*F_listfile;
-/*@null@*/ FILE	*FI_listfile;
 FILE	*FI_temp;
 bool Fisclear;
 
@@ -94,6 +94,24 @@ size_t operand_size(address_mode_t am)
   return Opsize[am];
 }
 
+unsigned int mnemonic_opcode(const MNEMONIC *mne, address_mode_t am)
+{
+  /* opcodes are stored densely, so count the modes before am */
+  uint32_t before = mne->okmask & ((UINT32_C(1) << am) - 1);
+  size_t index = 0;
+
+  assert(am < NUMOC);
+  assert((mne->okmask & (UINT32_C(1) << am)) != 0);
+
+  while (before != 0) {
+    before &= before - 1;
+    index++;
+  }
+
+  assert(index < MAX_OPCODES);
+  return mne->opcode[index];
+}
+
 MNEMONIC Ops[] = {
     { NULL, v_list    , "list",           0,      0, {0,} },
     { NULL, v_include , "include",        0,      0, {0,} },
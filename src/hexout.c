@@ -0,0 +1,274 @@
+/*
+    $Id$
+
+    the DASM macro assembler (aka small systems cross assembler)
+
+    Copyright (c) 1988-2002 by Matthew Dillon.
+    Copyright (c) 1995 by Olaf "Rhialto" Seibert.
+    Copyright (c) 2003-2008 by Andrew Davie.
+    Copyright (c) 2008 by Peter H. Froehlich.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/**
+ * @file
+ */
+
+#include "hexout.h"
+
+#include <assert.h>
+#include <string.h>
+
+/*
+  Intel HEX:  :llaaaatt(ll bytes)cc   cc = two's complement of the
+                                      sum of all other bytes
+  S-record:   Stll(address)(bytes)cc  ll = bytes after it, cc =
+                                      one's complement of the sum
+                                      of all other bytes
+*/
+
+/* Intel HEX record types. */
+#define INTEL_DATA 0x00
+#define INTEL_END 0x01
+#define INTEL_LINEAR 0x04
+
+/* S-record types for data and end records by address bytes. */
+static const struct
+{
+    char data;
+    char end;
+}
+SRecordTypes[5] = {
+    {'?', '?'},
+    {'?', '?'},
+    {'1', '9'}, /* S19 */
+    {'2', '8'}, /* S28 */
+    {'3', '7'}, /* S37 */
+};
+
+/* Both hex digits of every byte, filled on first use. */
+static char HexPairs[256][2];
+static bool HexPairsReady = false;
+
+static void init_hex_pairs(void)
+{
+    static const char digits[] = "0123456789ABCDEF";
+
+    for (int i = 0; i < 256; i++) {
+        HexPairs[i][0] = digits[(i >> 4) & 0x0F];
+        HexPairs[i][1] = digits[i & 0x0F];
+    }
+    HexPairsReady = true;
+}
+
+static void flush_buffer(HEXFILE *hex)
+{
+    if (hex->used > 0) {
+        if (fwrite(hex->buffer, 1, hex->used, hex->out) != hex->used) {
+            hex->failed = true;
+        }
+        hex->used = 0;
+    }
+}
+
+/* Encode byte into p, add it to the checksum, return position after it. */
+static inline char *put_byte(char *p, unsigned char byte, unsigned int *sum)
+{
+    p[0] = HexPairs[byte][0];
+    p[1] = HexPairs[byte][1];
+    *sum += byte;
+    return p + 2;
+}
+
+/*
+  Encode one record into the buffer: type is the Intel HEX record
+  type or the character after 'S'. Address bytes go out MSB first.
+*/
+static void put_record(HEXFILE *hex, int type, unsigned long address, int address_bytes,
+                       const unsigned char *data, size_t length)
+{
+    size_t eol = strlen(hex->eol);
+    /* start, type, count, address, checksum take at most 16 */
+    size_t needed = 16 + 2 * length + eol;
+    unsigned int sum = 0;
+    char *p;
+
+    assert(needed <= sizeof(hex->buffer));
+
+    if (sizeof(hex->buffer) - hex->used < needed) {
+        flush_buffer(hex);
+    }
+    p = hex->buffer + hex->used;
+
+    if (hex->format == HEX_INTEL) {
+        *p++ = ':';
+        p = put_byte(p, (unsigned char) length, &sum);
+    }
+    else {
+        *p++ = 'S';
+        *p++ = (char) type;
+        p = put_byte(p, (unsigned char) (address_bytes + length + 1), &sum);
+    }
+
+    for (int i = address_bytes - 1; i >= 0; i--) {
+        p = put_byte(p, (unsigned char) (address >> (8 * i)), &sum);
+    }
+
+    if (hex->format == HEX_INTEL) {
+        p = put_byte(p, (unsigned char) type, &sum);
+    }
+
+    for (size_t i = 0; i < length; i++) {
+        p = put_byte(p, data[i], &sum);
+    }
+
+    if (hex->format == HEX_INTEL) {
+        p = put_byte(p, (unsigned char) -sum, &sum);
+    }
+    else {
+        p = put_byte(p, (unsigned char) ~sum, &sum);
+    }
+
+    memcpy(p, hex->eol, eol);
+    p += eol;
+
+    hex->used = p - hex->buffer;
+}
+
+/* Write the record collected so far, if any. */
+static void flush_record(HEXFILE *hex)
+{
+    if (hex->length == 0) {
+        return;
+    }
+
+    if (hex->format == HEX_INTEL) {
+        unsigned long upper = (hex->address >> 16) & 0xFFFF;
+        if (upper != hex->upper) {
+            unsigned char bytes[2] = {upper >> 8, upper & 0xFF};
+            put_record(hex, INTEL_LINEAR, 0, 2, bytes, sizeof(bytes));
+            hex->upper = upper;
+        }
+        put_record(hex, INTEL_DATA, hex->address & 0xFFFF, 2, hex->data, hex->length);
+    }
+    else {
+        put_record(hex, SRecordTypes[hex->address_bytes].data,
+                   hex->address, hex->address_bytes, hex->data, hex->length);
+    }
+
+    hex->records += 1;
+    hex->length = 0;
+}
+
+void hex_begin(HEXFILE *hex, hex_format_t format, FILE *out, unsigned long highest)
+{
+    assert(hex != NULL);
+    assert(out != NULL);
+
+    if (!HexPairsReady) {
+        init_hex_pairs();
+    }
+
+    hex->out = out;
+    hex->format = format;
+    hex->record_length = HEX_DEFAULT_RECORD;
+    hex->eol = "\r\n";
+    hex->upper = 0;
+    hex->records = 0;
+    hex->address = 0;
+    hex->length = 0;
+    hex->used = 0;
+    hex->failed = false;
+
+    if (highest <= 0xFFFF) {
+        hex->address_bytes = 2;
+    }
+    else if (highest <= 0xFFFFFF) {
+        hex->address_bytes = 3;
+    }
+    else {
+        hex->address_bytes = 4;
+    }
+
+    if (format == HEX_SRECORD) {
+        /* empty header, we don't know anything worth saying */
+        put_record(hex, '0', 0, 2, NULL, 0);
+    }
+}
+
+void hex_data(HEXFILE *hex, unsigned long address, const unsigned char *data, size_t length)
+{
+    assert(hex != NULL);
+    assert(hex->record_length >= 1 && hex->record_length <= HEX_MAX_RECORD);
+
+    while (length > 0) {
+        size_t room;
+
+        if (hex->length > 0 && hex->address + hex->length != address) {
+            flush_record(hex);
+        }
+        if (hex->length == 0) {
+            hex->address = address;
+        }
+
+        room = hex->record_length - hex->length;
+        if (hex->format == HEX_INTEL) {
+            /* Intel HEX records can't cross a 64K boundary */
+            size_t boundary = 0x10000 - (address & 0xFFFF);
+            if (room > boundary) {
+                room = boundary;
+            }
+        }
+        if (room > length) {
+            room = length;
+        }
+
+        memcpy(hex->data + hex->length, data, room);
+        hex->length += room;
+        address += room;
+        data += room;
+        length -= room;
+
+        if (hex->length == hex->record_length
+            || (hex->format == HEX_INTEL && (address & 0xFFFF) == 0)) {
+            flush_record(hex);
+        }
+    }
+}
+
+bool hex_end(HEXFILE *hex)
+{
+    assert(hex != NULL);
+
+    flush_record(hex);
+
+    if (hex->format == HEX_INTEL) {
+        put_record(hex, INTEL_END, 0, 2, NULL, 0);
+    }
+    else {
+        if (hex->records <= 0xFFFF) {
+            put_record(hex, '5', hex->records, 2, NULL, 0);
+        }
+        put_record(hex, SRecordTypes[hex->address_bytes].end,
+                   0, hex->address_bytes, NULL, 0);
+    }
+
+    flush_buffer(hex);
+
+    return !hex->failed;
+}
+
+/* vim: set tabstop=4 softtabstop=4 expandtab shiftwidth=4 autoindent: */
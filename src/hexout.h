@@ -0,0 +1,117 @@
+#ifndef _DASM_HEXOUT_H
+#define _DASM_HEXOUT_H
+
+/*
+    $Id$
+
+    the DASM macro assembler (aka small systems cross assembler)
+
+    Copyright (c) 1988-2002 by Matthew Dillon.
+    Copyright (c) 1995 by Olaf "Rhialto" Seibert.
+    Copyright (c) 2003-2008 by Andrew Davie.
+    Copyright (c) 2008 by Peter H. Froehlich.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/**
+ * @file
+ *
+ * @brief Writing Intel HEX and Motorola S-record files.
+ *
+ * Callers hand us runs of bytes with their addresses, in any
+ * order; we cut them into records, encode each record into a
+ * buffer through a table of hex digit pairs, and write the
+ * buffer out in large pieces. This doesn't depend on the rest
+ * of DASM (no dalloc, no errors) so ftohex can use it as well.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * @brief Kinds of hex files we can write.
+ */
+typedef enum
+{
+    HEX_INTEL, /* Intel HEX, extended linear addresses above 64K */
+    HEX_SRECORD /* Motorola S19/S28/S37, whichever addresses need */
+}
+hex_format_t;
+
+/* Longest record we write, Intel HEX can't count any higher. */
+#define HEX_MAX_RECORD 255
+
+/* Default bytes per record, same as ftohex always had. */
+#define HEX_DEFAULT_RECORD 16
+
+/* Size of the output buffer. */
+#define HEX_BUFFER 16384
+
+/**
+ * @brief State of a hex file being written; treat as opaque
+ * except for the settings hex_begin() documents.
+ */
+typedef struct
+{
+    FILE *out;
+    hex_format_t format;
+    /* settings, may be changed right after hex_begin() */
+    size_t record_length; /* bytes per record, 1-HEX_MAX_RECORD */
+    const char *eol; /* line ending */
+    /* S-record variant: number of address bytes */
+    int address_bytes;
+    /* Intel HEX: upper 16 address bits of the last record */
+    unsigned long upper;
+    /* data records written, for the S5 count */
+    unsigned long records;
+    /* record being collected */
+    unsigned long address;
+    size_t length;
+    unsigned char data[HEX_MAX_RECORD];
+    /* encoded output not written yet */
+    size_t used;
+    char buffer[HEX_BUFFER];
+    /* did any write fail? */
+    bool failed;
+}
+HEXFILE;
+
+/**
+ * @brief Start writing a hex file of the given format to out;
+ * highest is the highest address we're going to write, the
+ * S-record variant depends on it.
+ * @note record_length and eol get defaults of HEX_DEFAULT_RECORD
+ * and "\r\n"; change them before the first hex_data() if needed.
+ */
+void hex_begin(HEXFILE *hex, hex_format_t format, FILE *out, unsigned long highest);
+
+/**
+ * @brief Write length bytes of data that belong at address; runs
+ * that continue the previous one continue its record.
+ */
+void hex_data(HEXFILE *hex, unsigned long address, const unsigned char *data, size_t length);
+
+/**
+ * @brief Finish the hex file with its end record and write out
+ * everything buffered; false if any write failed.
+ * @note Doesn't close the file.
+ */
+bool hex_end(HEXFILE *hex);
+
+#endif /* _DASM_HEXOUT_H */
+
+/* vim: set tabstop=4 softtabstop=4 expandtab shiftwidth=4 autoindent: */
@@ -0,0 +1,332 @@
+/*
+    $Id$
+
+    the DASM macro assembler (aka small systems cross assembler)
+
+    Copyright (c) 1988-2002 by Matthew Dillon.
+    Copyright (c) 1995 by Olaf "Rhialto" Seibert.
+    Copyright (c) 2003-2008 by Andrew Davie.
+    Copyright (c) 2008 by Peter H. Froehlich.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/**
+ * @file
+ */
+
+#include "image.h"
+
+#include "dalloc.h"
+#include "errors.h"
+#include "files.h"
+#include "hexout.h"
+#include "objfile.h"
+#include "util.h"
+
+#include <assert.h>
+
+/*
+  The image is a list of blocks, each holding a run of bytes at
+  consecutive addresses, in the order the blocks were started.
+  Every segment has a block open, and bytes that continue it fill
+  it up before we start a new one; switching segments back and
+  forth doesn't cut the image into lots of little blocks. Blocks
+  are kept from pass to pass since every pass generates about the
+  same.
+*/
+#define BLOCK_BYTES 4000
+
+typedef struct _BLOCK BLOCK;
+struct _BLOCK
+{
+    BLOCK *next;
+    unsigned long org;
+    size_t length;
+    unsigned char data[BLOCK_BYTES];
+};
+
+/* A file to write the image to, -F option. */
+typedef struct _OUTPUT OUTPUT;
+struct _OUTPUT
+{
+    OUTPUT *next;
+    int format;
+    char *name;
+};
+
+/* Blocks in use, in the order they were generated. */
+static BLOCK *first_block = NULL;
+static BLOCK *last_block = NULL;
+
+/* Blocks left over from the previous pass. */
+static BLOCK *spare_blocks = NULL;
+
+/* Block each segment is filling, by SEGMENT.number; NULL if none. */
+static BLOCK **open_blocks = NULL;
+static size_t nof_open_blocks = 0;
+
+/* Highest address generated, valid if first_block != NULL. */
+static unsigned long highest = 0;
+
+/* Files to write at the end, in the order given. */
+static OUTPUT *first_output = NULL;
+static OUTPUT *last_output = NULL;
+
+bool image_format(int format)
+{
+    return (format == FORMAT_HEX || format == FORMAT_SREC || format == FORMAT_RASX);
+}
+
+static bool image_needed(void)
+{
+    return image_format(F_format) || first_output != NULL;
+}
+
+bool add_image_output(int format, const char *name)
+{
+    OUTPUT *output;
+
+    assert(name != NULL);
+
+    if (!image_format(format)) {
+        return false;
+    }
+
+    output = dalloc(sizeof(OUTPUT));
+    output->format = format;
+    output->name = checked_strdup(name);
+
+    if (last_output == NULL) {
+        first_output = output;
+    }
+    else {
+        last_output->next = output;
+    }
+    last_output = output;
+
+    return true;
+}
+
+void begin_image_pass(void)
+{
+    if (last_block != NULL) {
+        last_block->next = spare_blocks;
+        spare_blocks = first_block;
+    }
+    first_block = last_block = NULL;
+    highest = 0;
+
+    if (open_blocks != NULL) {
+        memset(open_blocks, 0, nof_open_blocks * sizeof(BLOCK *));
+    }
+}
+
+/* Where the open block of segment goes, made room for if needed. */
+static BLOCK **open_block(const SEGMENT *segment)
+{
+    if (segment->number >= nof_open_blocks) {
+        size_t count = 2 * segment->number + 8;
+        BLOCK **more = dalloc(count * sizeof(BLOCK *));
+        memset(more, 0, count * sizeof(BLOCK *));
+        if (open_blocks != NULL) {
+            memcpy(more, open_blocks, nof_open_blocks * sizeof(BLOCK *));
+            dfree(open_blocks);
+        }
+        open_blocks = more;
+        nof_open_blocks = count;
+    }
+    return &open_blocks[segment->number];
+}
+
+static BLOCK *new_block(unsigned long org)
+{
+    BLOCK *block = spare_blocks;
+
+    if (block != NULL) {
+        spare_blocks = block->next;
+        block->next = NULL;
+    }
+    else {
+        block = dalloc(sizeof(BLOCK));
+    }
+    block->org = org;
+    block->length = 0;
+
+    if (last_block == NULL) {
+        first_block = block;
+    }
+    else {
+        last_block->next = block;
+    }
+    last_block = block;
+
+    return block;
+}
+
+void image_append(const SEGMENT *segment, unsigned long org,
+                  const unsigned char *data, size_t length)
+{
+    BLOCK **open;
+
+    if (!image_needed() || length == 0) {
+        return;
+    }
+
+    assert(segment != NULL);
+    assert(data != NULL);
+
+    open = open_block(segment);
+
+    if (first_block == NULL || org + length - 1 > highest) {
+        highest = org + length - 1;
+    }
+
+    while (length > 0) {
+        BLOCK *block = *open;
+        size_t room;
+
+        if (block == NULL
+            || block->org + block->length != org
+            || block->length == BLOCK_BYTES) {
+            block = *open = new_block(org);
+        }
+
+        room = BLOCK_BYTES - block->length;
+        if (room > length) {
+            room = length;
+        }
+        memcpy(block->data + block->length, data, room);
+        block->length += room;
+        org += room;
+        data += room;
+        length -= room;
+    }
+}
+
+/* Blocks from block on that continue it, one segment for RASX. */
+static const BLOCK *segment_end(const BLOCK *block, unsigned long *length)
+{
+    const BLOCK *next = block->next;
+
+    *length = block->length;
+    while (next != NULL && next->org == block->org + *length) {
+        *length += next->length;
+        next = next->next;
+    }
+
+    return next;
+}
+
+static void put_long(unsigned long value, FILE *out)
+{
+    unsigned char bytes[4] = {
+        value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF, (value >> 24) & 0xFF
+    };
+    (void) fwrite(bytes, sizeof(bytes), 1, out);
+}
+
+/*
+  Extended RAS (see objfile.h for the layout) is written front to
+  back in one go: we know all segments by now, so there's no need
+  to seek back and patch lengths like FORMAT_RAS does.
+*/
+static void write_rasx(FILE *out)
+{
+    const BLOCK *block;
+    const BLOCK *next;
+    unsigned long count = 0;
+    unsigned long offset = RASX_HEADER;
+    unsigned long length;
+
+    for (block = first_block; block != NULL; block = segment_end(block, &length)) {
+        count += 1;
+    }
+
+    (void) fwrite(RASX_MAGIC, 4, 1, out);
+    put_long(count, out);
+
+    for (block = first_block; block != NULL; block = next) {
+        next = segment_end(block, &length);
+        put_long(block->org, out);
+        put_long(length, out);
+        for (; block != next; block = block->next) {
+            (void) fwrite(block->data, block->length, 1, out);
+        }
+        offset += RASX_SEGMENT + length;
+    }
+
+    /* the index starts where the last segment ended */
+    length = offset;
+    offset = RASX_HEADER;
+    for (block = first_block; block != NULL; block = next) {
+        unsigned long seglen;
+        next = segment_end(block, &seglen);
+        put_long(block->org, out);
+        put_long(seglen, out);
+        put_long(offset + RASX_SEGMENT, out);
+        offset += RASX_SEGMENT + seglen;
+    }
+
+    put_long(length, out);
+    (void) fwrite(RASX_MAGIC, 4, 1, out);
+}
+
+void write_image(int format, FILE *out, const char *name)
+{
+    HEXFILE *hex;
+    const BLOCK *block;
+
+    assert(image_format(format));
+    assert(out != NULL);
+    assert(name != NULL);
+
+    if (format == FORMAT_RASX) {
+        write_rasx(out);
+        if (ferror(out)) {
+            error_fmt("Problem writing output file '%s'.", name);
+        }
+        return;
+    }
+
+    hex = dalloc(sizeof(HEXFILE));
+    hex_begin(hex, (format == FORMAT_HEX) ? HEX_INTEL : HEX_SRECORD, out, highest);
+    for (block = first_block; block != NULL; block = block->next) {
+        hex_data(hex, block->org, block->data, block->length);
+    }
+    if (!hex_end(hex)) {
+        error_fmt("Problem writing output file '%s'.", name);
+    }
+    dfree(hex);
+}
+
+void write_image_outputs(void)
+{
+    const OUTPUT *output;
+
+    for (output = first_output; output != NULL; output = output->next) {
+        FILE *out = create_output(output->name);
+        if (out == NULL) {
+            error_fmt("Unable to open output file '%s'.", output->name);
+            continue;
+        }
+        write_image(output->format, out, output->name);
+        if (!finish_output(out, true)) {
+            warning_fmt("Problem closing output file '%s'.", output->name);
+        }
+    }
+}
+
+/* vim: set tabstop=4 softtabstop=4 expandtab shiftwidth=4 autoindent: */
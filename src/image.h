@@ -0,0 +1,85 @@
+#ifndef _DASM_IMAGE_H
+#define _DASM_IMAGE_H
+
+/*
+    $Id$
+
+    the DASM macro assembler (aka small systems cross assembler)
+
+    Copyright (c) 1988-2002 by Matthew Dillon.
+    Copyright (c) 1995 by Olaf "Rhialto" Seibert.
+    Copyright (c) 2003-2008 by Andrew Davie.
+    Copyright (c) 2008 by Peter H. Froehlich.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/**
+ * @file
+ *
+ * @brief The output image, what the final pass generated.
+ *
+ * Formats 1-3 are written while we generate code, but formats
+ * that need to know everything up front (S-records pick their
+ * address size from the highest address, for example) are
+ * written from an image of all bytes the pass generated and
+ * their addresses, kept per segment so that a segment picks up
+ * where it left off. We only keep the image if some output needs
+ * it, the -f option or any -F option. Several outputs can be
+ * written from one image, so a single run produces the binary
+ * and its hex files.
+ */
+
+#include "asm.h"
+
+/**
+ * @brief Also write the image in the given format to the named
+ * file at the end, -F option; false if the format can't be
+ * written from the image.
+ */
+bool add_image_output(int format, const char *name);
+
+/**
+ * @brief Can the given format be written from the image?
+ */
+bool image_format(int format);
+
+/**
+ * @brief Start a new pass, call at the start of every pass;
+ * forgets what the previous pass generated.
+ */
+void begin_image_pass(void);
+
+/**
+ * @brief Remember that segment generated the given bytes at org.
+ * @note Does nothing unless some output needs the image.
+ */
+void image_append(const SEGMENT *segment, unsigned long org,
+                  const unsigned char *data, size_t length);
+
+/**
+ * @brief Write the image in the given format to out, the main
+ * output file; name is for error messages.
+ */
+void write_image(int format, FILE *out, const char *name);
+
+/**
+ * @brief Write all files requested with add_image_output().
+ */
+void write_image_outputs(void);
+
+#endif /* _DASM_IMAGE_H */
+
+/* vim: set tabstop=4 softtabstop=4 expandtab shiftwidth=4 autoindent: */
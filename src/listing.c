@@ -0,0 +1,739 @@
+/*
+    $Id$
+
+    the DASM macro assembler (aka small systems cross assembler)
+
+    Copyright (c) 1988-2002 by Matthew Dillon.
+    Copyright (c) 1995 by Olaf "Rhialto" Seibert.
+    Copyright (c) 2003-2008 by Andrew Davie.
+    Copyright (c) 2008 by Peter H. Froehlich.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/**
+ * @file
+ */
+
+#if defined(__WINDOWS__) || defined(_WIN32) || defined(_WIN64)
+#	define HAVE_PTHREAD 0
+#else
+	/* pthread(3) and nanosleep(2) */
+#	define _POSIX_C_SOURCE 200809L
+#	define HAVE_PTHREAD 1
+#endif
+
+#include "listing.h"
+
+#include "dalloc.h"
+#include "errors.h"
+#include "files.h"
+
+#include <assert.h>
+#include <stdarg.h>
+#include <stdlib.h>
+
+#if HAVE_PTHREAD
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+	/* shared between the assembler and the listing thread */
+#	define SHARED(type) _Atomic(type)
+#	define PUBLISH(var, value) atomic_store_explicit(&(var), (value), memory_order_release)
+#	define OBSERVE(var) atomic_load_explicit(&(var), memory_order_acquire)
+#else
+#	define SHARED(type) type
+#	define PUBLISH(var, value) ((var) = (value))
+#	define OBSERVE(var) (var)
+#endif
+
+/*
+  Events are stored back to back in chunks, an event never spans
+  two chunks. Each starts with its type; numbers are stored seven
+  bits at a time (least significant first, high bit set if more
+  follow), strings with their '\0'.
+
+    EVENT_LINE   lineno flags address sftos-flags count bytes
+                 label mnemonic extension operand comment
+    EVENT_FILE   level pass name
+    EVENT_TEXT   text
+
+  The chunks are a queue with one producer, the assembler, and one
+  consumer, a thread formatting events into the list file while we
+  assemble. No locks: the assembler fills in an event and only then
+  publishes the new used count of its chunk (or a new chunk, after
+  the last used count of the previous one), the thread formats up
+  to whatever count it sees. Without threads we format everything
+  in finish_listing().
+
+  Each pass has its own stream of events and its own (temporary)
+  list file. Without -L a new pass cancels the stream of the last
+  one and recycles its chunks once the thread is gone; with -L one
+  stream covers all passes.
+*/
+enum
+{
+    EVENT_LINE = 1,
+    EVENT_FILE,
+    EVENT_TEXT
+};
+
+/* Flags of EVENT_LINE. */
+enum
+{
+    LINE_BSS = 1 << 0,
+    LINE_SKIPPED = 1 << 1,
+    LINE_MORE = 1 << 2, /* more bytes than we show */
+    LINE_EXTENSION = 1 << 3
+};
+
+/* Bytes of a line we show. */
+#define LIST_BYTES 4
+
+#define CHUNK_BYTES 65536
+
+typedef struct _CHUNK CHUNK;
+struct _CHUNK
+{
+    SHARED(CHUNK *) next;
+    /* next in spare_chunks */
+    CHUNK *spare;
+    size_t size;
+    SHARED(size_t) used;
+    unsigned char data[];
+};
+
+/* A stream of events and the list file it goes to. */
+typedef struct
+{
+    SHARED(CHUNK *) first;
+    /* no more events coming */
+    SHARED(bool) done;
+    /* forget about it, another pass started */
+    SHARED(bool) cancelled;
+    /* only touched by whoever formats */
+    FILE *file;
+    bool failed;
+#if HAVE_PTHREAD
+    pthread_t thread;
+    bool threaded;
+#endif
+}
+STREAM;
+
+/* Recording events, F_listfile given and not finished yet. */
+static bool recording = false;
+
+/* Stream we're recording, valid if recording. */
+static STREAM stream;
+
+/* Last chunk of the stream, only the assembler uses it. */
+static CHUNK *last_chunk = NULL;
+
+/* Chunks of forgotten passes. */
+static CHUNK *spare_chunks = NULL;
+
+static void *format_stream(void *arg);
+
+static void start_stream(void)
+{
+    FILE *file = create_output(F_listfile);
+
+    if (file == NULL) {
+        error_fmt("Unable to open list file '%s'.", F_listfile);
+        return;
+    }
+
+    PUBLISH(stream.first, NULL);
+    PUBLISH(stream.done, false);
+    PUBLISH(stream.cancelled, false);
+    stream.file = file;
+    stream.failed = false;
+    last_chunk = NULL;
+    recording = true;
+
+#if HAVE_PTHREAD
+    /* if we can't have a thread, we'll format in finish_listing() */
+    stream.threaded = (pthread_create(&stream.thread, NULL, format_stream, &stream) == 0);
+#endif
+}
+
+/* Wait for the stream to be formatted (or cancelled) completely. */
+static void stop_stream(bool cancel)
+{
+    CHUNK *chunk;
+
+    recording = false;
+    PUBLISH(stream.cancelled, cancel);
+    PUBLISH(stream.done, true);
+
+#if HAVE_PTHREAD
+    if (stream.threaded) {
+        (void) pthread_join(stream.thread, NULL);
+        stream.threaded = false;
+    }
+    else
+#endif
+    if (!cancel) {
+        (void) format_stream(&stream);
+    }
+
+    /* nobody else looks at the chunks anymore */
+    for (chunk = OBSERVE(stream.first); chunk != NULL; chunk = OBSERVE(chunk->next)) {
+        chunk->spare = spare_chunks;
+        spare_chunks = chunk;
+    }
+    last_chunk = NULL;
+}
+
+void begin_listing_pass(bool keep)
+{
+    if (F_listfile == NULL) {
+        return;
+    }
+
+    if (recording) {
+        if (keep) {
+            return;
+        }
+        stop_stream(true);
+        (void) finish_output(stream.file, false);
+    }
+    start_stream();
+}
+
+bool listing_active(void)
+{
+    return recording;
+}
+
+/* Room for an event of at most size bytes, publish it with commit(). */
+static unsigned char *reserve(size_t size)
+{
+    CHUNK *chunk = last_chunk;
+
+    if (chunk == NULL || chunk->size - OBSERVE(chunk->used) < size) {
+        CHUNK **link = &spare_chunks;
+        while (*link != NULL && (*link)->size < size) {
+            link = &(*link)->spare;
+        }
+        if (*link != NULL) {
+            chunk = *link;
+            *link = chunk->spare;
+        }
+        else {
+            size_t bytes = (size > CHUNK_BYTES) ? size : CHUNK_BYTES;
+            chunk = dalloc(sizeof(CHUNK) + bytes);
+            chunk->size = bytes;
+        }
+        PUBLISH(chunk->next, NULL);
+        PUBLISH(chunk->used, 0);
+
+        if (last_chunk == NULL) {
+            PUBLISH(stream.first, chunk);
+        }
+        else {
+            PUBLISH(last_chunk->next, chunk);
+        }
+        last_chunk = chunk;
+    }
+
+    return chunk->data + OBSERVE(chunk->used);
+}
+
+/* The event ends at p, let the thread have it. */
+static void commit(const unsigned char *p)
+{
+    assert((size_t) (p - last_chunk->data) <= last_chunk->size);
+    PUBLISH(last_chunk->used, (size_t) (p - last_chunk->data));
+}
+/* Most bytes put_number() needs. */
+#define NUMBER_BYTES ((sizeof(unsigned long) * 8 + 6) / 7)
+
+static unsigned char *put_number(unsigned char *p, unsigned long n)
+{
+    while (n >= 0x80) {
+        *p++ = (unsigned char) (n | 0x80);
+        n >>= 7;
+    }
+    *p++ = (unsigned char) n;
+    return p;
+}
+
+static unsigned char *put_string(unsigned char *p, const char *s, size_t length)
+{
+    memcpy(p, s, length);
+    p[length] = '\0';
+    return p + length + 1;
+}
+
+void list_line(const LISTLINE *line)
+{
+    size_t label = strlen(line->label);
+    size_t mnemonic = strlen(line->mnemonic);
+    size_t extension = (line->extension != NULL) ? strlen(line->extension) : 0;
+    size_t operand = strlen(line->operand);
+    size_t comment = strlen(line->comment);
+    size_t count = (line->length < LIST_BYTES) ? line->length : LIST_BYTES;
+    unsigned char *p;
+    unsigned char flags = 0;
+
+    assert(recording);
+
+    if (line->bss) {
+        flags |= LINE_BSS;
+    }
+    if (line->skipped) {
+        flags |= LINE_SKIPPED;
+    }
+    if (line->length > LIST_BYTES) {
+        flags |= LINE_MORE;
+    }
+    if (line->extension != NULL) {
+        flags |= LINE_EXTENSION;
+    }
+
+    p = reserve(1 + 3 * NUMBER_BYTES + 2 + count
+                + label + mnemonic + extension + operand + comment + 5);
+    *p++ = EVENT_LINE;
+    p = put_number(p, line->lineno);
+    *p++ = flags;
+    p = put_number(p, line->address);
+    p = put_number(p, (unsigned long) line->flags);
+    *p++ = (unsigned char) count;
+    memcpy(p, line->bytes, count);
+    p += count;
+    p = put_string(p, line->label, label);
+    p = put_string(p, line->mnemonic, mnemonic);
+    p = put_string(p, (extension > 0) ? line->extension : "", extension);
+    p = put_string(p, line->operand, operand);
+    p = put_string(p, line->comment, comment);
+    commit(p);
+}
+
+void list_file(const char *name, int level, int pass)
+{
+    size_t length = strlen(name);
+    unsigned char *p;
+
+    assert(recording);
+    assert(level >= 0 && pass >= 0);
+
+    p = reserve(1 + 2 * NUMBER_BYTES + length + 1);
+    *p++ = EVENT_FILE;
+    p = put_number(p, (unsigned long) level);
+    p = put_number(p, (unsigned long) pass);
+    p = put_string(p, name, length);
+    commit(p);
+}
+
+void list_text(const char *format, ...)
+{
+    char text[1024];
+    va_list ap;
+    int length;
+    unsigned char *p;
+
+    assert(recording);
+
+    va_start(ap, format);
+    length = vsnprintf(text, sizeof(text), format, ap);
+    va_end(ap);
+    if (length < 0) {
+        return;
+    }
+    if ((size_t) length >= sizeof(text)) {
+        length = sizeof(text) - 1;
+    }
+
+    p = reserve(1 + length + 1);
+    *p++ = EVENT_TEXT;
+    p = put_string(p, text, length);
+    commit(p);
+}
+
+/*
+  Formatting, on the listing thread; so no dalloc(), no messages,
+  and no sftos() (the assembler uses its buffers). We build each
+  line of the listing in line, then tabit() replaces runs of spaces
+  with tabs, and the result goes through buffer to the file.
+*/
+
+typedef struct
+{
+    FILE *file;
+    char buffer[CHUNK_BYTES];
+    size_t used;
+    bool failed;
+    /* the line we're building, and its tabbed version */
+    char *line;
+    char *tabbed;
+    size_t size;
+    size_t length;
+}
+WRITER;
+
+static void flush_writer(WRITER *w)
+{
+    if (w->used > 0 && fwrite(w->buffer, 1, w->used, w->file) != w->used) {
+        w->failed = true;
+    }
+    w->used = 0;
+}
+
+static void write_text(WRITER *w, const char *text, size_t length)
+{
+    if (length > sizeof(w->buffer) - w->used) {
+        flush_writer(w);
+        if (length > sizeof(w->buffer)) {
+            if (fwrite(text, 1, length, w->file) != length) {
+                w->failed = true;
+            }
+            return;
+        }
+    }
+    memcpy(w->buffer + w->used, text, length);
+    w->used += length;
+}
+
+static void add(WRITER *w, const char *text, size_t length)
+{
+    if (w->size - w->length < length + 2) {
+        size_t size = 2 * (w->length + length + 2);
+        char *line = realloc(w->line, size);
+        char *tabbed = realloc(w->tabbed, size);
+        if (line != NULL) {
+            w->line = line;
+        }
+        if (tabbed != NULL) {
+            w->tabbed = tabbed;
+        }
+        if (line == NULL || tabbed == NULL) {
+            /* we'll fail, but we won't crash */
+            w->failed = true;
+            return;
+        }
+        w->size = size;
+    }
+    memcpy(w->line + w->length, text, length);
+    w->length += length;
+    w->line[w->length] = '\0';
+}
+
+static void add_string(WRITER *w, const char *s)
+{
+    add(w, s, strlen(s));
+}
+
+static void add_padded(WRITER *w, const char *s, size_t width)
+{
+    static const char spaces[] = "          ";
+    size_t length = strlen(s);
+
+    assert(width < sizeof(spaces));
+
+    add(w, s, length);
+    if (length < width) {
+        add(w, spaces, width - length);
+    }
+}
+
+static const char Digits[] = "0123456789abcdef";
+
+/* Number in the given base, at least width digits (padded with pad). */
+static void add_number(WRITER *w, unsigned long n, unsigned int base, size_t width, char pad)
+{
+    char digits[3 * sizeof(unsigned long) + 1];
+    char *p = digits + sizeof(digits);
+
+    do {
+        *--p = Digits[n % base];
+        n /= base;
+    } while (n > 0);
+    while ((size_t) (digits + sizeof(digits) - p) < width) {
+        *--p = pad;
+    }
+
+    add(w, p, digits + sizeof(digits) - p);
+}
+
+/*
+  Copy buf1 into buf2 up to its first '\n' (or its end), optimizing
+  spaces into tabs; buf2 ends in '\n' and may be one byte longer
+  than buf1. Returns the length of buf2.
+*/
+static size_t tabit(const char *buf1, char *buf2)
+{
+    char *bp;
+    const char *ptr;
+    int j, k;
+
+    bp = buf2;
+    ptr= buf1;
+    for (j = 0; *ptr != '\0' && *ptr != '\n'; ++ptr, ++bp, j = (j+1)&7) {
+        *bp = *ptr;
+        if (*ptr == '\t') {
+            /* optimize out spaces before the tab */
+            while (j > 0 && bp[-1] == ' ') {
+                bp--;
+                j--;
+            }
+            j = 0;
+            *bp = '\t';         /* recopy the tab */
+        }
+        if (j == 7 && *bp == ' ' && bp[-1] == ' ') {
+            k = j;
+            while (k-- >= 0 && *bp == ' ')
+                --bp;
+            *++bp = '\t';
+        }
+    }
+    while (bp != buf2 && (bp[-1] == ' ' || bp[-1] == '\t'))
+        --bp;
+    *bp++ = '\n';
+    return bp - buf2;
+}
+
+static const unsigned char *get_number(const unsigned char *p, unsigned long *n)
+{
+    int shift = 0;
+
+    *n = 0;
+    do {
+        *n |= (unsigned long) (*p & 0x7F) << shift;
+        shift += 7;
+    } while ((*p++ & 0x80) != 0);
+
+    return p;
+}
+
+/* The listing line of an EVENT_LINE, same as DASM always wrote it. */
+static const unsigned char *format_line(WRITER *w, const unsigned char *p)
+{
+    unsigned long lineno, address, flags;
+    unsigned char lineflags;
+    size_t count;
+    char xtrue;
+    const char *label, *mnemonic, *extension, *operand, *comment;
+    size_t i;
+
+    p = get_number(p, &lineno);
+    lineflags = *p++;
+    p = get_number(p, &address);
+    p = get_number(p, &flags);
+    count = *p++;
+
+    w->length = 0;
+
+    /* "%7lu %c" */
+    add_number(w, lineno, 10, 7, ' ');
+    add(w, (lineflags & LINE_BSS) ? " U" : "  ", 2);
+
+    /* what sftos() makes of it; only SYM_UNKNOWN gets through & 7 */
+    add_number(w, address, 16, 4, '0');
+    add(w, (flags & SYM_UNKNOWN) ? " ???? " : "      ", 6);
+    add(w, "            ", 12);
+
+    /* "%02x " for each byte, blanks for the ones we don't have */
+    for (i = 0; i < LIST_BYTES; i++) {
+        char hex[3] = "   ";
+        if (i < count) {
+            hex[0] = Digits[p[i] >> 4];
+            hex[1] = Digits[p[i] & 0x0F];
+        }
+        /* the last blank is where xtrue goes */
+        add(w, hex, (i < LIST_BYTES - 1) ? 3 : 2);
+    }
+    p += count;
+
+    label = (const char *) p;
+    mnemonic = label + strlen(label) + 1;
+    extension = mnemonic + strlen(mnemonic) + 1;
+    operand = extension + strlen(extension) + 1;
+    comment = operand + strlen(operand) + 1;
+    p = (const unsigned char *) comment + strlen(comment) + 1;
+
+    if (lineflags & LINE_MORE) {
+        xtrue = '*';
+    }
+    else {
+        xtrue = (lineflags & LINE_SKIPPED) ? '-' : ' ';
+    }
+    add(w, &xtrue, 1);
+    add_padded(w, label, 10);
+    add(w, " ", 1);
+    add_string(w, mnemonic);
+    if (lineflags & LINE_EXTENSION) {
+        add(w, ".", 1);
+        add_string(w, extension);
+    }
+    add(w, "\t", 1);
+    add_string(w, operand);
+    if (comment[0] != '\0') {
+        add(w, "\t;", 2);
+        add_string(w, comment);
+    }
+
+    if (!w->failed) {
+        write_text(w, w->tabbed, tabit(w->line, w->tabbed));
+    }
+    return p;
+}
+
+/* "------- FILE %s LEVEL %d PASS %d\n" or "------- FILE %s\n" */
+static const unsigned char *format_file(WRITER *w, const unsigned char *p)
+{
+    unsigned long level, pass;
+    const char *name;
+
+    p = get_number(p, &level);
+    p = get_number(p, &pass);
+    name = (const char *) p;
+
+    w->length = 0;
+    add(w, "------- FILE ", 13);
+    add_string(w, name);
+    if (level > 0) {
+        add(w, " LEVEL ", 7);
+        add_number(w, level, 10, 1, ' ');
+        add(w, " PASS ", 6);
+        add_number(w, pass, 10, 1, ' ');
+    }
+    add(w, "\n", 1);
+    if (!w->failed) {
+        write_text(w, w->line, w->length);
+    }
+
+    return p + strlen(name) + 1;
+}
+
+/* Format events from p to end. */
+static void format_events(WRITER *w, const unsigned char *p, const unsigned char *end)
+{
+    while (p < end) {
+        switch (*p++) {
+            case EVENT_LINE:
+                p = format_line(w, p);
+                break;
+            case EVENT_FILE:
+                p = format_file(w, p);
+                break;
+            case EVENT_TEXT:
+                write_text(w, (const char *) p, strlen((const char *) p));
+                p += strlen((const char *) p) + 1;
+                break;
+            default:
+                assert(false);
+                return;
+        }
+    }
+}
+
+/* Nothing to do, give the assembler some time. */
+static void idle(unsigned int *naps)
+{
+#if HAVE_PTHREAD
+    /* from 10 microseconds up to a millisecond */
+    struct timespec nap = {0, 10000L << (*naps < 7 ? *naps : 7)};
+    if (nap.tv_nsec > 1000000L) {
+        nap.tv_nsec = 1000000L;
+    }
+    (void) nanosleep(&nap, NULL);
+    *naps += 1;
+#else
+    (void) naps;
+    assert(false);
+#endif
+}
+
+/*
+  Format a stream until it's done (or cancelled). Whatever we see
+  in used is complete; once we see done, everything is there, so
+  if a look at the chunks after that finds nothing new we're done.
+*/
+static void *format_stream(void *arg)
+{
+    STREAM *s = arg;
+    WRITER *w = malloc(sizeof(WRITER));
+    CHUNK *chunk = NULL;
+    size_t at = 0;
+    unsigned int naps = 0;
+
+    if (w == NULL) {
+        s->failed = true;
+        return NULL;
+    }
+    memset(w, 0, sizeof(WRITER));
+    w->file = s->file;
+
+    while (!OBSERVE(s->cancelled)) {
+        bool done = OBSERVE(s->done);
+        bool progress = false;
+
+        if (chunk == NULL) {
+            chunk = OBSERVE(s->first);
+            at = 0;
+        }
+        while (chunk != NULL) {
+            size_t used = OBSERVE(chunk->used);
+            CHUNK *next;
+            if (at < used) {
+                format_events(w, chunk->data + at, chunk->data + used);
+                at = used;
+                progress = true;
+            }
+            /* the chunk is complete once there's a next one */
+            if ((next = OBSERVE(chunk->next)) == NULL) {
+                break;
+            }
+            if (at == OBSERVE(chunk->used)) {
+                chunk = next;
+                at = 0;
+            }
+        }
+
+        if (progress) {
+            naps = 0;
+        }
+        else if (done) {
+            break;
+        }
+        else {
+            idle(&naps);
+        }
+    }
+
+    flush_writer(w);
+    s->failed = w->failed;
+    free(w->tabbed);
+    free(w->line);
+    free(w);
+    return NULL;
+}
+
+void finish_listing(void)
+{
+    if (!recording) {
+        return;
+    }
+    /* whatever happens now won't make it into the listing */
+    stop_stream(false);
+
+    if (!finish_output(stream.file, !stream.failed) || stream.failed) {
+        warning_fmt("Problem closing list file '%s'.", F_listfile);
+    }
+}
+
+/* vim: set tabstop=4 softtabstop=4 expandtab shiftwidth=4 autoindent: */
@@ -0,0 +1,117 @@
+#ifndef _DASM_LISTING_H
+#define _DASM_LISTING_H
+
+/*
+    $Id$
+
+    the DASM macro assembler (aka small systems cross assembler)
+
+    Copyright (c) 1988-2002 by Matthew Dillon.
+    Copyright (c) 1995 by Olaf "Rhialto" Seibert.
+    Copyright (c) 2003-2008 by Andrew Davie.
+    Copyright (c) 2008 by Peter H. Froehlich.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/**
+ * @file
+ *
+ * @brief The listing, -l and -L options.
+ *
+ * Every pass lists every line, but only the final pass (or, with
+ * -L, all of them) ends up in the list file. The assembler just
+ * records what it would list as compact events (a line with its
+ * address, bytes, label, and so on; a file being entered; a
+ * message); a thread of its own formats them into the list file
+ * while we assemble, so the final pass doesn't wait for it. Since
+ * we only know which pass was the final one once it's over, a new
+ * pass throws away the listing of the previous one (unless -L).
+ * Only the listing has a thread: the symbol file is written once
+ * assembly is over, with nothing left to overlap, and the object
+ * file goes out through stdio buffers as it is generated.
+ */
+
+#include "asm.h"
+
+/**
+ * @brief What to list for one line of source.
+ */
+typedef struct
+{
+    unsigned long lineno;
+    /* address and segment flags, shown through sftos() */
+    unsigned long address;
+    dasm_flag_t flags;
+    /* in an uninitialized segment? */
+    bool bss;
+    /* in a false IF? */
+    bool skipped;
+    /* the bytes generated, only the first four are shown */
+    const unsigned char *bytes;
+    size_t length;
+    /* what the line says */
+    const char *label;
+    const char *mnemonic;
+    const char *extension; /* NULL if none */
+    const char *operand;
+    const char *comment;
+}
+LISTLINE;
+
+/**
+ * @brief Start recording the listing of a new pass, call at the
+ * start of every pass; unless keep, forget the previous pass.
+ * @note Does nothing without a list file.
+ */
+void begin_listing_pass(bool keep);
+
+/**
+ * @brief Are we recording a listing right now?
+ */
+bool listing_active(void);
+
+/**
+ * @brief Record a line of source.
+ * @pre listing_active()
+ */
+void list_line(const LISTLINE *line);
+
+/**
+ * @brief Record that we entered the named file at the given include
+ * level in the given pass, or returned to it if level is 0.
+ * @pre listing_active()
+ */
+void list_file(const char *name, int level, int pass);
+
+/**
+ * @brief Record some text, printf(3) style; include the '\n'.
+ * @pre listing_active()
+ */
+void list_text(const char *format, ...)
+    __attribute__((format(printf, 1, 2)));
+
+/**
+ * @brief Write everything recorded to the list file, F_listfile,
+ * and stop recording; the listing of the last pass replaces the
+ * list file even if we gave up on the source, it's the best clue
+ * to what went wrong.
+ * @note Does nothing if we aren't recording.
+ */
+void finish_listing(void);
+
+#endif /* _DASM_LISTING_H */
+
+/* vim: set tabstop=4 softtabstop=4 expandtab shiftwidth=4 autoindent: */
@@ -34,11 +34,20 @@
  */
 
 #include "asm.h"
+#include "addrmap.h"
+#include "cache.h"
 #include "dalloc.h"
 #include "errors.h"
+#include "files.h"
+#include "image.h"
+#include "listing.h"
+#include "memmap.h"
+#include "overlap.h"
+#include "passes.h"
 #include "symbols.h"
 #include "util.h"
 #include "version.h"
+#include "xref.h"
 
 #include <assert.h>
 #include <ctype.h>
@@ -73,6 +82,11 @@ static bool F_ListAllPasses = false;
 static bool bDoAllPasses = false;
 static int nMaxPasses = 10;
 
+/* -d option given, debug output means no result cache */
+static bool debugging = false;
+/* outputs came from the result cache, -C option */
+static bool restored = false;
+
 /* debugging helper for hash collisions */
 /*
     Using ./dasm ../test/example.asm for all of these...
@@ -136,15 +150,12 @@ static void ShowSegments(void)
     for (seg = Seglist; seg != NULL; seg = seg->next) {
         const char *bss = ((seg->flags & SF_BSS) != 0) ? "[u]" : "   ";
 
-        printf(
-            SHOW_SEGMENTS_FORMAT,
-            seg->name,
-            bss,
-            sftos(seg->initorg, seg->initflags),
-            sftos(seg->initrorg, seg->initrflags),
-            sftos(seg->org, seg->flags),
-            sftos(seg->rorg, seg->rflags)
-        );
+        /* sftos() has room for two results, not four */
+        printf("%-24s %-3s", seg->name, bss);
+        printf(" %-8s", sftos(seg->initorg, seg->initflags));
+        printf(" %-8s", sftos(seg->initrorg, seg->initrflags));
+        printf(" %-8s", sftos(seg->org, seg->flags));
+        printf(" %-8s\n", sftos(seg->rorg, seg->rflags));
     }
     (void) puts("----------------------------------------------------------------------");
 
@@ -197,6 +208,9 @@ static void ShowSegments(void)
 
         if ((Redo_why & REASON_PHASE_ERROR) != 0)
             printf(" - Label value is different from that of the previous pass (phase error).\n");
+
+        if ((Redo_why & REASON_INCBIN_NOT_RESOLVED) != 0)
+            printf(" - Expression in an INCBIN not resolved.\n");
     }
 
     printf( "\n" );
@@ -210,11 +224,20 @@ static void print_usage(void)
     (void) puts("Usage: dasm sourcefile [options]");
     (void) puts("");
     /* TODO: Matt's 2.16 has *SPACES* between option and argument! [phf] */
-    (void) puts("-f#      output format 1-3 (default 1)");
+    (void) puts("-f#      output format 1-6 (default 1)");
     (void) puts("-oname   output file name (else a.out)");
+    (void) puts("-F#name  also write output in format 4-6 to name");
     (void) puts("-lname   list file name (else none generated)");
     (void) puts("-Lname   list file, containing all passes");
     (void) puts("-sname   symbol dump file name (else none generated)");
+    (void) puts("-S#name  also write symbols in format 1-3 to name");
+    (void) puts("-x#name  cross-reference in format 1-2 (text, JSON) to name");
+    (void) puts("-Bname   make dependency file name (else none generated)");
+    (void) puts("-Cdir    cache directory, reuse outputs of unchanged runs");
+    (void) puts("-aname   address map file name, JSON lines (else none generated)");
+    (void) puts("-Aname   binary address index file name (else none generated)");
+    (void) puts("-u#name  memory map in format 1-2 (text, JSON) to name");
+    (void) puts("-Kseg=low-high        limit segment seg to addresses low-high");
     (void) puts("-v#      verboseness 0-4 (default 0)");
     (void) puts("-d#      debug mode (for developers)");
     (void) puts("-Dsymbol              define symbol, set to 0");
@@ -225,6 +248,7 @@ static void print_usage(void)
     (void) puts("-P#      maximum number of passes, with fewer checks");
     (void) puts("-T#      symbol table sorting (default 0 = alphabetical, 1 = address/value)");
     (void) puts("-E#      error format (default 0 = MS, 1 = Dillon, 2 = GNU)");
+    (void) puts("-R#      oscillating passes (default 0 = report, 1 = pin larger encoding)");
     (void) puts("-mname   force processor type");
     (void) puts("");
     DASM_PRINT_BUGS
@@ -267,6 +291,17 @@ static void parse_sort_mode(char *str)
     }
 }
 
+static void parse_oscillation_mode(char *str)
+{
+    int mode = atoi(str);
+    if (valid_oscillation_mode(mode)) {
+        set_oscillation_mode(mode);
+    }
+    else {
+        panic_fmt("Invalid oscillation mode for -R option, must be 0 or 1");
+    }
+}
+
 static void parse_debug_trace(char *str)
 {
     int debug = atoi(str);
@@ -282,6 +317,7 @@ static void parse_debug_trace(char *str)
     }
     /* TODO: get rid of this message? */
     printf("Debug trace %s\n", debug != 0 ? "ON" : "OFF");
+    debugging = (debug != 0);
 }
 
 static void parse_define(char kind, char *str)
@@ -317,6 +353,91 @@ static void parse_output_format(char *str)
     }
 }
 
+/* -F4name and the like, format digits followed by the file name */
+static void parse_image_output(char *str)
+{
+    char *name;
+    long format = strtol(str, &name, 10);
+
+    if (name == str || *name == '\0') {
+        panic_fmt("Missing format or file name for -F option!");
+    }
+    if (!add_image_output((int) format, name)) {
+        panic_fmt("Illegal format specification for -F, must be 4, 5, or 6");
+    }
+}
+
+static void parse_symbol_output(char *str)
+{
+    char *name;
+    long format = strtol(str, &name, 10);
+
+    if (name == str || *name == '\0') {
+        panic_fmt("Missing format or file name for -S option!");
+    }
+    if (!add_symbol_output((int) format, name)) {
+        panic_fmt("Illegal format specification for -S, must be 1, 2, or 3");
+    }
+}
+
+static void parse_xref_output(char *str)
+{
+    char *name;
+    long format = strtol(str, &name, 10);
+
+    if (name == str || *name == '\0') {
+        panic_fmt("Missing format or file name for -x option!");
+    }
+    if (!add_xref_output((int) format, name)) {
+        panic_fmt("Illegal format specification for -x, must be 1 or 2");
+    }
+}
+
+static void parse_memmap_output(char *str)
+{
+    char *name;
+    long format = strtol(str, &name, 10);
+
+    if (name == str || *name == '\0') {
+        panic_fmt("Missing format or file name for -u option!");
+    }
+    if (!add_memmap_output((int) format, name)) {
+        panic_fmt("Illegal format specification for -u, must be 1 or 2");
+    }
+}
+
+/* Address for -K, $ or 0x for hex, otherwise decimal; end after it. */
+static bool parse_address(const char *str, unsigned long *value, char **end)
+{
+    if (*str == '$') {
+        ++str;
+        *value = strtoul(str, end, 16);
+    }
+    else {
+        *value = strtoul(str, end, 0);
+    }
+    return *end != str;
+}
+
+/* -Kname=low-high, a segment and the addresses it may use */
+static void parse_segment_limit(char *str)
+{
+    char *range = strrchr(str, '=');
+    char *end;
+    unsigned long low;
+    unsigned long high;
+
+    if (range == NULL || range == str) {
+        panic_fmt("Missing segment name for -K option!");
+    }
+    *range++ = '\0';
+    if (!parse_address(range, &low, &end) || *end != '-'
+        || !parse_address(end + 1, &high, &end) || *end != '\0'
+        || !add_segment_limit(str, low, high)) {
+        panic_fmt("Illegal range for -K, must be low-high");
+    }
+}
+
 /* TODO: still need to improve option parsing and errors for it [phf] */
 static void parse_options(int argc, char **argv)
 {
@@ -344,6 +465,10 @@ static void parse_options(int argc, char **argv)
                 parse_sort_mode(str);
                 break;
 
+            case 'R':
+                parse_oscillation_mode(str);
+                break;
+
             case 'd':
                 parse_debug_trace(str);
                 break;
@@ -361,6 +486,10 @@ static void parse_options(int argc, char **argv)
                 F_outfile = str;
                 break;
 
+            case 'F':
+                parse_image_output(str);
+                break;
+
             case 'L':
                 F_ListAllPasses = true;
                 /* fall through to 'l' */
@@ -379,6 +508,38 @@ static void parse_options(int argc, char **argv)
                 set_symbol_file_name(str);
                 break;
 
+            case 'S':
+                parse_symbol_output(str);
+                break;
+
+            case 'x':
+                parse_xref_output(str);
+                break;
+
+            case 'u':
+                parse_memmap_output(str);
+                break;
+
+            case 'K':
+                parse_segment_limit(str);
+                break;
+
+            case 'B':
+                set_dependency_file_name(str);
+                break;
+
+            case 'C':
+                set_cache_directory(str);
+                break;
+
+            case 'a':
+                set_address_map(str);
+                break;
+
+            case 'A':
+                set_address_index(str);
+                break;
+
             case 'v':
                 F_verbose = atoi(str);
                 break;
@@ -434,14 +595,18 @@ static int MainShadow(int argc, char **argv)
 
     parse_options(argc, argv);
 
-    /* INITIAL SEGMENT */
-    {
-        SEGMENT *seg = dalloc(sizeof(SEGMENT)); /* [phf] was small */
-        seg->name = strcpy(dalloc(sizeof(ISEGNAME)), ISEGNAME); /* [phf] was small */
-        seg->flags= seg->rflags = seg->initflags = seg->initrflags = SF_UNKNOWN;
-        Csegment = Seglist = seg;
+    /* otherwise we only show what the final pass has to say */
+    set_error_every_pass(F_verbose > 0 || debugging);
+
+    /* a hit has to look like a run, so only quiet runs */
+    if (F_verbose == 0 && !debugging && restore_from_cache(argc, argv)) {
+        restored = true;
+        return EXIT_SUCCESS;
     }
 
+    /* INITIAL SEGMENT */
+    Csegment = new_segment(ISEGNAME, false);
+
     /* TOP LEVEL IF */
     {
         IFSTACK *ifs = dalloc(sizeof(IFSTACK)); /* [phf] was zero regular */
@@ -465,27 +630,26 @@ nextpass:
 
     Localdollarindex = Lastlocaldollarindex = 0;
 
-    FI_temp = fopen(F_outfile, "wb");
+    begin_pass_tracking(pass);
+    begin_file_pass();
+
+    FI_temp = create_output(F_outfile);
     Fisclear = true;
     CheckSum = 0;
+    begin_image_pass();
+    begin_map_pass();
+    begin_xref_pass();
+    begin_memmap_pass();
+    begin_overlap_pass();
+    begin_error_pass();
     if (FI_temp == NULL) {
         printf("Warning: Unable to [re]open '%s'\n", F_outfile);
         fatal_fmt("Unable to open file.");
 /*        return ERROR_FILE_ERROR;*/
         return EXIT_FAILURE; /* needed for rest of code to work? [phf] */
     }
-    if (F_listfile != NULL) {
-
-        FI_listfile = fopen(F_listfile,
-            F_ListAllPasses && (pass > 1)? "a" : "w");
-
-        if (FI_listfile == NULL) {
-            printf("Warning: Unable to [re]open '%s'\n", F_listfile);
-            fatal_fmt("Unable to open file.");
-/*            return ERROR_FILE_ERROR;*/
-            return EXIT_FAILURE; /* needed for rest of code to work? [phf] */
-        }
-    }
+    /* -L keeps adding to the listing, -l starts over every pass */
+    begin_listing_pass(F_ListAllPasses);
     pushinclude(argv[1]);
 
     while (pIncfile != NULL)
@@ -538,9 +702,12 @@ nextpass:
                     programlabel();
             }
 
-            if (FI_listfile != NULL && ListMode) {
+            if (listing_active() && ListMode) {
                 outlistfile(comment);
             }
+
+            /* expression results and the like are done for */
+            scratch_reset(SCRATCH_LINE);
         }
 
         while (Reploop != NULL && Reploop->file == pIncfile)
@@ -566,8 +733,8 @@ nextpass:
         if (F_verbose > 1)
         printf("back to: %s\n", Incfile->name);
             */
-            if (FI_listfile != NULL) {
-                fprintf(FI_listfile, "------- FILE %s\n", pIncfile->name);
+            if (listing_active()) {
+                list_file(pIncfile->name, 0, pass);
             }
         }
     }
@@ -585,22 +752,34 @@ nextpass:
 
     closegenerate();
     assert(FI_temp != NULL); /* fclose() undefined for NULL [phf] */
-    if (fclose(FI_temp) != 0) {
-        warning_fmt("Problem closing temporary file '%s'.", F_outfile);
+    /* only the final pass replaces the output file */
+    if (!finish_output(FI_temp, Redo == 0)) {
+        warning_fmt("Problem closing output file '%s'.", F_outfile);
     }
     /* [phf] either way, after this we cannot risk writing to the file anymore! */
     FI_temp = NULL;
-    if (FI_listfile != NULL) {
-        if (fclose(FI_listfile) != 0) {
-            warning_fmt("Problem closing list file '%s'.", F_listfile);
-        }
-        /* [phf] either way, after this we cannot risk writing to the file anymore! */
-        FI_listfile = NULL;
-    }
+    /* the listing is written at the end, see finish_listing() */
+    end_error_pass();
+
+    /* macro arguments and the like are done for */
+    scratch_reset(SCRATCH_LINE);
+    scratch_reset(SCRATCH_PASS);
 
     if (Redo != 0)
     {
+        convergence_t converge = CONVERGENCE_CONTINUE;
+
         if ( !bDoAllPasses )
+            converge = check_convergence(pass);
+
+        if (converge == CONVERGENCE_CYCLE)
+        {
+            ShowUnresolvedSymbols();
+            fatal_fmt("Source is not resolvable.");
+            return EXIT_FAILURE;
+        }
+
+        if ( !bDoAllPasses && converge != CONVERGENCE_PINNED )
             if (Redo == oldredo && Redo_why == oldwhy && Redo_eval == oldeval)
             {
                 ShowUnresolvedSymbols();
@@ -648,85 +827,29 @@ nextpass:
 }
 
 
-static int tabit(const char *buf1, char *buf2)
-{
-    char *bp;
-    const char *ptr;
-    int j, k;
-
-    bp = buf2;
-    ptr= buf1;
-    for (j = 0; *ptr != '\0' && *ptr != '\n'; ++ptr, ++bp, j = (j+1)&7) {
-        *bp = *ptr;
-        if (*ptr == '\t') {
-            /* optimize out spaces before the tab */
-            while (j > 0 && bp[-1] == ' ') {
-                bp--;
-                j--;
-            }
-            j = 0;
-            *bp = '\t';         /* recopy the tab */
-        }
-        if (j == 7 && *bp == ' ' && bp[-1] == ' ') {
-            k = j;
-            while (k-- >= 0 && *bp == ' ')
-                --bp;
-            *++bp = '\t';
-        }
-    }
-    while (bp != buf2 && (bp[-1] == ' ' || bp[-1] == '\t'))
-        --bp;
-    *bp++ = '\n';
-    *bp = '\0';
-    assert(((int)(bp - buf2)) >= 0); /* passed to a size_t in places [phf] */
-    return (int)(bp - buf2);
-}
-
 static void outlistfile(const char *comment)
 {
-    char xtrue;
-    char c;
-    static char buf1[MAXLINE+32];
-    static char buf2[MAXLINE+32];
-    const char *ptr;
-    const char *dot;
-    int i, j;
-    int len;
+    LISTLINE line;
 
     /* TODO: what does this mean exactly? [phf] */
     if ((pIncfile->flags & INF_NOLIST) != 0) {
         return;
     }
 
-    assert(FI_listfile != NULL);
-
-    xtrue = (Ifstack->xtrue && Ifstack->acctrue) ? ' ' : '-';
-    c = ((Pflags & SF_BSS) != 0) ? 'U' : ' ';
-    ptr = Extstr;
-    dot = "";
-    if (ptr)
-        dot = ".";
-    else
-        ptr = "";
-
-    len = snprintf(buf1, sizeof(buf1), "%7lu %c%s", pIncfile->lineno, c, sftos(Plab, Pflags & 7));
-    assert(len < (int)sizeof(buf1));
-    j = strlen(buf1);
-    for (i = 0; i < Glen && i < 4; ++i, j += 3)
-        sprintf(buf1+j, "%02x ", Gen[i]);
-    if (i < Glen && i == 4)
-        xtrue = '*';
-    for (; i < 4; ++i) {
-        buf1[j] = buf1[j+1] = buf1[j+2] = ' ';
-        j += 3;
-    }
-    sprintf(buf1+j-1, "%c%-10s %s%s%s\t%s\n",
-        xtrue, Av[0], Av[1], dot, ptr, Av[2]);
-    if (comment[0] != '\0') { /*  tab and comment */
-        j = strlen(buf1) - 1;
-        sprintf(buf1+j, "\t;%s", comment);
-    }
-    fwrite(buf2, tabit(buf1,buf2), 1, FI_listfile);
+    line.lineno = pIncfile->lineno;
+    line.address = Plab;
+    line.flags = Pflags & 7;
+    line.bss = (Pflags & SF_BSS) != 0;
+    line.skipped = !(Ifstack->xtrue && Ifstack->acctrue);
+    line.bytes = Gen;
+    line.length = Glen;
+    line.label = Av[0];
+    line.mnemonic = Av[1];
+    line.extension = Extstr;
+    line.operand = Av[2];
+    line.comment = comment;
+    list_line(&line);
+
     Glen = 0;
     Extstr = NULL;
 }
@@ -747,61 +870,23 @@ char *sftos(long val, dasm_flag_t flags)
     static char buf[MAX_SYM_LEN + 14];
     static char c;
     char *ptr = (c) ? buf : buf + sizeof(buf) / 2;
-
-    memset(buf, 0, sizeof(buf));
+    char *p;
 
     c = 1 - c;
 
-    sprintf(ptr, "%04lx ", val);
-
-    if ((flags & SYM_UNKNOWN) != 0) {
-        strcat( ptr, "???? ");
-    }
-    else {
-        strcat( ptr, "     " );
-    }
-
-    if ((flags & SYM_STRING) != 0) {
-        strcat( ptr, "str ");
-    }
-    else {
-        strcat( ptr, "    " );
-    }
-
-    if ((flags & SYM_MACRO) != 0) {
-        strcat( ptr, "eqm ");
-    }
-    else {
-        strcat( ptr, "    " );
-    }
-
-    if ((flags & (SYM_MASREF|SYM_SET)) != 0) {
-        strcat( ptr, "(" );
-    }
-    else {
-        strcat( ptr, " " );
-    }
-
-    if ((flags & SYM_MASREF) != 0) {
-        strcat( ptr, "R" );
-    }
-    else {
-        strcat( ptr, " " );
-    }
-
-    if ((flags & SYM_SET) != 0) {
-        strcat( ptr, "S" );
-    }
-    else {
-        strcat( ptr, " " );
-    }
-
-    if ((flags & (SYM_MASREF|SYM_SET)) != 0) {
-        strcat( ptr, ")" );
-    }
-    else {
-        strcat( ptr, " " );
-    }
+    /* only our half, the caller may still use the other one */
+    p = ptr + sprintf(ptr, "%04lx ", val);
+    memcpy(p, ((flags & SYM_UNKNOWN) != 0) ? "???? " : "     ", 5);
+    p += 5;
+    memcpy(p, ((flags & SYM_STRING) != 0) ? "str " : "    ", 4);
+    p += 4;
+    memcpy(p, ((flags & SYM_MACRO) != 0) ? "eqm " : "    ", 4);
+    p += 4;
+    *p++ = ((flags & (SYM_MASREF|SYM_SET)) != 0) ? '(' : ' ';
+    *p++ = ((flags & SYM_MASREF) != 0) ? 'R' : ' ';
+    *p++ = ((flags & SYM_SET) != 0) ? 'S' : ' ';
+    *p++ = ((flags & (SYM_MASREF|SYM_SET)) != 0) ? ')' : ' ';
+    *p = '\0';
 
     return ptr;
 }
@@ -1254,7 +1339,7 @@ void v_macro(const char *str, MNEMONIC UNUSED(*dummy))
         defined = true;
     } else {
         defined = (findmne(sbuf) != NULL);
-        if (FI_listfile != NULL && ListMode) {
+        if (listing_active() && ListMode) {
             outlistfile("");
         }
     }
@@ -1290,7 +1375,7 @@ void v_macro(const char *str, MNEMONIC UNUSED(*dummy))
                 return;
             }
         }
-        if (!skipit && FI_listfile != NULL && ListMode) {
+        if (!skipit && listing_active() && ListMode) {
             outlistfile(comment);
         }
         if (!defined) {
@@ -1306,16 +1391,9 @@ void v_macro(const char *str, MNEMONIC UNUSED(*dummy))
 
 void addhashtable(MNEMONIC *mne)
 {
-    int i, j;
-    unsigned int opcode[NUMOC];
+    int i;
 
     for (; mne->vect != NULL; ++mne) {
-        memcpy(opcode, mne->opcode, sizeof(mne->opcode));
-        for (i = j = 0; i < NUMOC; ++i) {
-            mne->opcode[i] = 0;     /* not really needed */
-            if (mne->okmask & (1L << i))
-                mne->opcode[i] = opcode[j++];
-        }
         if (findmne(mne->name) != NULL) {
             info_fmt("Mnemonic '%s' was overridden!", mne->name);
         }
@@ -1343,8 +1421,8 @@ void pushinclude(const char *str)
         }
         ++Inclevel;
 
-        if (FI_listfile != NULL) {
-            fprintf(FI_listfile, "------- FILE %s LEVEL %d PASS %d\n", str, Inclevel, pass);
+        if (listing_active()) {
+            list_file(str, Inclevel, pass);
         }
 
         inf = dalloc(sizeof(INCFILE)); /* [phf] was zero regular */
@@ -1354,7 +1432,7 @@ void pushinclude(const char *str)
         inf->lineno = 0;
         pIncfile = inf;
     }
-    else {
+    else if (report_missing_file(str)) {
         warning_fmt("Unable to open include file '%s'.", str);
     }
 }
@@ -1368,13 +1446,13 @@ static void exit_handler(void)
 
     debug_memory_allocation_patterns();
 
-    /* if there are still open files, close them */
-    if (FI_temp != NULL) {
-        fclose(FI_temp);
-    }
-    if (FI_listfile != NULL) {
-        fclose(FI_listfile);
-    }
+    /* messages held back if we didn't make it to the end */
+    flush_errors();
+
+    /* if there are still open files, get rid of them */
+    finish_listing();
+    abandon_outputs();
+    FI_temp = NULL;
 
     /* free all small allocations we ever made */
     dfree_all();
@@ -1407,6 +1485,8 @@ static void exit_handler(void)
 
 int main(int argc, char **argv)
 {
+    int status;
+
     setprogname(argv[0]);
 
     if (atexit(exit_handler) != 0)
@@ -1414,7 +1494,13 @@ int main(int argc, char **argv)
         panic_fmt("Could not install exit handler!");
     }
 
-    MainShadow(argc, argv);
+    status = MainShadow(argc, argv);
+    /* whatever the final pass had to say */
+    flush_errors();
+    if (restored) {
+        return EXIT_SUCCESS;
+    }
+    finish_listing();
 
 #if 0
     if (nError)
@@ -1424,11 +1510,17 @@ int main(int argc, char **argv)
 #endif
 
     DumpSymbolTable();
+    write_cross_references();
+    write_dependency_file(F_outfile);
 
     if (number_of_errors() > 0) {
       return EXIT_FAILURE;
     }
     else {
+      if (status == EXIT_SUCCESS && number_of_fatals() == 0 && number_of_warnings() == 0
+          && !Echoed) {
+        store_in_cache();
+      }
       return EXIT_SUCCESS;
     }
 }
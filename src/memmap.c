@@ -0,0 +1,708 @@
+/*
+    $Id$
+
+    the DASM macro assembler (aka small systems cross assembler)
+
+    Copyright (c) 1988-2002 by Matthew Dillon.
+    Copyright (c) 1995 by Olaf "Rhialto" Seibert.
+    Copyright (c) 2003-2008 by Andrew Davie.
+    Copyright (c) 2008 by Peter H. Froehlich.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/**
+ * @file
+ */
+
+
+#include "memmap.h"
+
+#include "dalloc.h"
+#include "errors.h"
+#include "files.h"
+#include "overlap.h"
+#include "util.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+/* Addresses start up to end, end not included. */
+typedef struct
+{
+    unsigned long start;
+    unsigned long end;
+}
+RANGE;
+
+/*
+  What a segment did in the current pass; ranges are in the order
+  they were generated, a run that continues the last one extends
+  it. We keep these from pass to pass like the segments.
+*/
+typedef struct _USAGE USAGE;
+struct _USAGE
+{
+    USAGE *next;
+    const SEGMENT *segment;
+    RANGE *ranges;
+    size_t count;
+    size_t capacity;
+    unsigned long used;
+    unsigned long fill;
+    unsigned long padding;
+    unsigned long reserved;
+};
+
+/* Where a segment may go, -K option. */
+typedef struct _LIMIT LIMIT;
+struct _LIMIT
+{
+    LIMIT *next;
+    const char *name;
+    unsigned long low;
+    unsigned long high;
+};
+
+/* A file to write the memory map to, -u option. */
+typedef struct _OUTPUT OUTPUT;
+struct _OUTPUT
+{
+    OUTPUT *next;
+    int format;
+    const char *name;
+};
+
+/* A range and whose it is, for pages. */
+typedef struct
+{
+    RANGE range;
+    const USAGE *usage;
+}
+OWNED;
+
+/* Where segment overlaps other, order is where overlap.c found it. */
+typedef struct
+{
+    RANGE range;
+    const SEGMENT *segment;
+    const SEGMENT *other;
+    size_t order;
+}
+OVERLAP;
+
+/* How full a 256-byte page is. */
+typedef struct
+{
+    unsigned long page;
+    unsigned long used;
+    unsigned long gap;
+    unsigned long gap_start;
+}
+PAGE;
+
+#define PAGE_BYTES 256
+
+/* Segments in the order they first generated something. */
+static USAGE *first_usage = NULL;
+static USAGE *last_usage = NULL;
+
+/* Usage of each segment by SEGMENT.number, NULL if none yet. */
+static USAGE **usages = NULL;
+static size_t nof_usages = 0;
+
+static LIMIT *first_limit = NULL;
+static LIMIT *last_limit = NULL;
+
+static OUTPUT *first_output = NULL;
+static OUTPUT *last_output = NULL;
+
+bool add_memmap_output(int format, const char *name)
+{
+    OUTPUT *output;
+
+    assert(name != NULL);
+
+    if (format < MEMMAP_MIN || format > MEMMAP_MAX) {
+        return false;
+    }
+
+    output = dalloc(sizeof(OUTPUT));
+    output->format = format;
+    output->name = checked_strdup(name);
+
+    if (last_output == NULL) {
+        first_output = output;
+    }
+    else {
+        last_output->next = output;
+    }
+    last_output = output;
+
+    return true;
+}
+
+bool add_segment_limit(const char *name, unsigned long low, unsigned long high)
+{
+    LIMIT *limit;
+
+    assert(name != NULL);
+
+    if (low > high) {
+        return false;
+    }
+
+    limit = dalloc(sizeof(LIMIT));
+    limit->name = checked_strdup(name);
+    limit->low = low;
+    limit->high = high;
+
+    if (last_limit == NULL) {
+        first_limit = limit;
+    }
+    else {
+        last_limit->next = limit;
+    }
+    last_limit = limit;
+
+    return true;
+}
+
+static bool memmap_needed(void)
+{
+    return first_output != NULL || first_limit != NULL;
+}
+
+void begin_memmap_pass(void)
+{
+    USAGE *usage;
+
+    for (usage = first_usage; usage != NULL; usage = usage->next) {
+        usage->count = 0;
+        usage->used = usage->fill = usage->padding = usage->reserved = 0;
+    }
+}
+
+static USAGE *usage_for(const SEGMENT *segment)
+{
+    USAGE *usage;
+
+    if (segment->number < nof_usages && usages[segment->number] != NULL) {
+        return usages[segment->number];
+    }
+
+    if (segment->number >= nof_usages) {
+        size_t count = 2 * segment->number + 8;
+        USAGE **more = dalloc(count * sizeof(USAGE *));
+        memset(more, 0, count * sizeof(USAGE *));
+        if (usages != NULL) {
+            memcpy(more, usages, nof_usages * sizeof(USAGE *));
+            dfree(usages);
+        }
+        usages = more;
+        nof_usages = count;
+    }
+
+    usage = dalloc(sizeof(USAGE));
+    usage->segment = segment;
+    if (last_usage == NULL) {
+        first_usage = usage;
+    }
+    else {
+        last_usage->next = usage;
+    }
+    last_usage = usage;
+
+    return usages[segment->number] = usage;
+}
+
+void memmap_append(unsigned long org, size_t length, bool fill)
+{
+    USAGE *usage;
+    RANGE *last;
+
+    if (!memmap_needed() || length == 0) {
+        return;
+    }
+
+    usage = usage_for(Csegment);
+    if ((Csegment->flags & SF_BSS) != 0) {
+        usage->reserved += length;
+    }
+    else if (fill) {
+        usage->fill += length;
+    }
+    else {
+        usage->used += length;
+    }
+
+    last = (usage->count > 0) ? &usage->ranges[usage->count - 1] : NULL;
+    if (last != NULL && last->end == org) {
+        last->end += length;
+        return;
+    }
+
+    if (usage->count == usage->capacity) {
+        size_t capacity = 2 * usage->capacity + 8;
+        RANGE *ranges = dalloc(capacity * sizeof(RANGE));
+        if (usage->ranges != NULL) {
+            memcpy(ranges, usage->ranges, usage->count * sizeof(RANGE));
+            dfree(usage->ranges);
+        }
+        usage->ranges = ranges;
+        usage->capacity = capacity;
+    }
+    usage->ranges[usage->count].start = org;
+    usage->ranges[usage->count].end = org + length;
+    usage->count += 1;
+}
+
+void memmap_padding(unsigned long length)
+{
+    if (!memmap_needed() || length == 0) {
+        return;
+    }
+    usage_for(Csegment)->padding += length;
+}
+
+static int compare_owned(const void *a, const void *b)
+{
+    const OWNED *x = a;
+    const OWNED *y = b;
+
+    if (x->range.start != y->range.start) {
+        return (x->range.start < y->range.start) ? -1 : 1;
+    }
+    if (x->range.end != y->range.end) {
+        return (x->range.end < y->range.end) ? -1 : 1;
+    }
+    return 0;
+}
+
+/* All ranges of all segments, sorted by address; *count of them. */
+static OWNED *sorted_ranges(size_t *count)
+{
+    const USAGE *usage;
+    OWNED *owned;
+    size_t n = 0;
+
+    for (usage = first_usage; usage != NULL; usage = usage->next) {
+        n += usage->count;
+    }
+
+    owned = dalloc((n > 0 ? n : 1) * sizeof(OWNED));
+    n = 0;
+    for (usage = first_usage; usage != NULL; usage = usage->next) {
+        for (size_t i = 0; i < usage->count; i++) {
+            owned[n].range = usage->ranges[i];
+            owned[n].usage = usage;
+            n += 1;
+        }
+    }
+    qsort(owned, n, sizeof(OWNED), compare_owned);
+
+    *count = n;
+    return owned;
+}
+
+/*
+  Ranges of a segment sorted and merged, the same address generated
+  twice (ORG going back) counts once; *count of them.
+*/
+static RANGE *merged_ranges(const OWNED *owned, size_t nof_owned, const USAGE *usage,
+                            size_t *count)
+{
+    RANGE *merged = dalloc((usage->count > 0 ? usage->count : 1) * sizeof(RANGE));
+    size_t n = 0;
+
+    for (size_t i = 0; i < nof_owned; i++) {
+        if (owned[i].usage != usage) {
+            continue;
+        }
+        if (n > 0 && owned[i].range.start <= merged[n - 1].end) {
+            if (owned[i].range.end > merged[n - 1].end) {
+                merged[n - 1].end = owned[i].range.end;
+            }
+        }
+        else {
+            merged[n++] = owned[i].range;
+        }
+    }
+
+    *count = n;
+    return merged;
+}
+
+/* The page is done, the rest of it after cursor is a gap too. */
+static void close_page(PAGE *page, unsigned long cursor)
+{
+    unsigned long end = (page->page + 1) * PAGE_BYTES;
+
+    if (end - cursor > page->gap) {
+        page->gap = end - cursor;
+        page->gap_start = cursor;
+    }
+}
+
+/*
+  Pages touched by any segment, one pass over the sorted ranges;
+  the largest gap is the longest run of bytes in the page no
+  segment touched.
+*/
+static PAGE *used_pages(const OWNED *owned, size_t nof_owned, size_t *count)
+{
+    PAGE *pages = NULL;
+    size_t n = 0;
+    size_t capacity = 0;
+    unsigned long cursor = 0; /* first byte not looked at yet */
+
+    for (size_t i = 0; i < nof_owned; i++) {
+        unsigned long start = owned[i].range.start;
+        unsigned long end = owned[i].range.end;
+
+        /* overlaps count once */
+        if (start < cursor) {
+            start = cursor;
+        }
+        while (start < end) {
+            unsigned long page = start / PAGE_BYTES;
+            unsigned long piece = (page + 1) * PAGE_BYTES;
+            PAGE *p;
+
+            if (piece > end) {
+                piece = end;
+            }
+
+            if (n == 0 || pages[n - 1].page != page) {
+                if (n > 0) {
+                    close_page(&pages[n - 1], cursor);
+                }
+                if (n == capacity) {
+                    size_t more = 2 * capacity + 16;
+                    PAGE *bigger = dalloc(more * sizeof(PAGE));
+                    if (pages != NULL) {
+                        memcpy(bigger, pages, n * sizeof(PAGE));
+                        dfree(pages);
+                    }
+                    pages = bigger;
+                    capacity = more;
+                }
+                p = &pages[n++];
+                p->page = page;
+                p->used = 0;
+                p->gap = 0;
+                p->gap_start = 0;
+                cursor = page * PAGE_BYTES;
+            }
+            p = &pages[n - 1];
+
+            if (start - cursor > p->gap) {
+                p->gap = start - cursor;
+                p->gap_start = cursor;
+            }
+            p->used += piece - start;
+            cursor = start = piece;
+        }
+    }
+    if (n > 0) {
+        close_page(&pages[n - 1], cursor);
+    }
+
+    *count = n;
+    return pages;
+}
+
+static void add_overlap(unsigned long start, unsigned long end,
+                        const SEGMENT *segment, const SEGMENT *other, void *data)
+{
+    ARRAY *overlaps = data;
+    OVERLAP *overlap = array_extend(overlaps, 1, sizeof(OVERLAP));
+
+    overlap->range.start = start;
+    overlap->range.end = end;
+    overlap->segment = segment;
+    overlap->other = other;
+    overlap->order = overlaps->count - 1;
+}
+
+static int compare_overlaps(const void *a, const void *b)
+{
+    const OVERLAP *x = a;
+    const OVERLAP *y = b;
+
+    if (x->range.start != y->range.start) {
+        return (x->range.start < y->range.start) ? -1 : 1;
+    }
+    return (x->order < y->order) ? -1 : (x->order > y->order);
+}
+
+/*
+  The overlaps overlap.c diagnosed, sorted by address; BSS space
+  shared by BSS segments isn't one. *count of them.
+*/
+static OVERLAP *find_overlaps(size_t *count)
+{
+    ARRAY overlaps = { NULL, 0, 0 };
+
+    for_each_overlap(add_overlap, &overlaps);
+    if (overlaps.count > 0) {
+        qsort(overlaps.items, overlaps.count, sizeof(OVERLAP), compare_overlaps);
+    }
+
+    *count = overlaps.count;
+    return overlaps.items;
+}
+
+static const LIMIT *limit_for(const char *name)
+{
+    const LIMIT *limit;
+
+    for (limit = first_limit; limit != NULL; limit = limit->next) {
+        if (strcmp(limit->name, name) == 0) {
+            return limit;
+        }
+    }
+    return NULL;
+}
+
+/* Segments that went outside their limits are errors. */
+static void check_limits(const OWNED *owned, size_t nof_owned)
+{
+    const LIMIT *limit;
+
+    for (limit = first_limit; limit != NULL; limit = limit->next) {
+        bool outside = false;
+        unsigned long low = 0;
+        unsigned long high = 0;
+
+        if (find_segment(limit->name) == NULL) {
+            warning_fmt("Limit for segment '%s' but there's no such segment.", limit->name);
+            continue;
+        }
+
+        for (size_t i = 0; i < nof_owned; i++) {
+            const RANGE *range = &owned[i].range;
+            if (strcmp(owned[i].usage->segment->name, limit->name) != 0) {
+                continue;
+            }
+            if (range->start < limit->low || range->end - 1 > limit->high) {
+                if (!outside || range->start < low) {
+                    low = range->start;
+                }
+                if (!outside || range->end - 1 > high) {
+                    high = range->end - 1;
+                }
+                outside = true;
+            }
+        }
+        if (outside) {
+            error_fmt("Segment '%s' uses $%04lx-$%04lx, outside its limit $%04lx-$%04lx.",
+                      limit->name, low, high, limit->low, limit->high);
+        }
+    }
+}
+
+/* Everything the reports show, worked out once for all of them. */
+typedef struct
+{
+    const OWNED *owned;
+    size_t nof_owned;
+    const PAGE *pages;
+    size_t nof_pages;
+    const OVERLAP *overlaps;
+    size_t nof_overlaps;
+}
+REPORT;
+
+static const char *segment_name(const USAGE *usage)
+{
+    return usage->segment->name;
+}
+
+static void write_text(const REPORT *report, FILE *out)
+{
+    const USAGE *usage;
+
+    fputs("--- Memory Map\n", out);
+    fputs("segment                  used     fill     padding  reserved limit\n", out);
+    for (usage = first_usage; usage != NULL; usage = usage->next) {
+        const LIMIT *limit = limit_for(segment_name(usage));
+        RANGE *ranges;
+        size_t count;
+
+        if (usage->count == 0) {
+            continue;
+        }
+        fprintf(out, "%-24s %-8lu %-8lu %-8lu %-8lu ", segment_name(usage),
+                usage->used, usage->fill, usage->padding, usage->reserved);
+        if (limit != NULL) {
+            fprintf(out, "%04lx-%04lx\n", limit->low, limit->high);
+        }
+        else {
+            fputs("-\n", out);
+        }
+
+        ranges = merged_ranges(report->owned, report->nof_owned, usage, &count);
+        for (size_t i = 0; i < count; i++) {
+            fprintf(out, "    %04lx-%04lx %lu\n", ranges[i].start, ranges[i].end - 1,
+                    ranges[i].end - ranges[i].start);
+        }
+        dfree(ranges);
+    }
+
+    fputs("--- Pages\n", out);
+    fputs("page     used     largest gap\n", out);
+    for (size_t i = 0; i < report->nof_pages; i++) {
+        const PAGE *page = &report->pages[i];
+        fprintf(out, "%04lx     %-8lu ", page->page * PAGE_BYTES, page->used);
+        if (page->gap > 0) {
+            fprintf(out, "%04lx-%04lx %lu\n", page->gap_start,
+                    page->gap_start + page->gap - 1, page->gap);
+        }
+        else {
+            fputs("-\n", out);
+        }
+    }
+
+    fprintf(out, "--- %zu Overlaps\n", report->nof_overlaps);
+    for (size_t i = 0; i < report->nof_overlaps; i++) {
+        const OVERLAP *overlap = &report->overlaps[i];
+        fprintf(out, "%04lx-%04lx %s, %s\n", overlap->range.start, overlap->range.end - 1,
+                overlap->segment->name, overlap->other->name);
+    }
+    fputs("--- End of Memory Map.\n", out);
+}
+
+static void write_json(const REPORT *report, FILE *out)
+{
+    const USAGE *usage;
+    bool first = true;
+
+    fputs("{\"segments\":[", out);
+    for (usage = first_usage; usage != NULL; usage = usage->next) {
+        const LIMIT *limit = limit_for(segment_name(usage));
+        RANGE *ranges;
+        size_t count;
+
+        if (usage->count == 0) {
+            continue;
+        }
+        if (!first) {
+            putc(',', out);
+        }
+        first = false;
+
+        fputs("\n{\"name\":", out);
+        put_json_string(segment_name(usage), out);
+        fprintf(out, ",\"bss\":%s,\"used\":%lu,\"fill\":%lu,\"padding\":%lu,\"reserved\":%lu",
+                (usage->segment->flags & SF_BSS) != 0 ? "true" : "false",
+                usage->used, usage->fill, usage->padding, usage->reserved);
+        if (limit != NULL) {
+            fprintf(out, ",\"limit\":{\"low\":%lu,\"high\":%lu}", limit->low, limit->high);
+        }
+        else {
+            fputs(",\"limit\":null", out);
+        }
+
+        fputs(",\"ranges\":[", out);
+        ranges = merged_ranges(report->owned, report->nof_owned, usage, &count);
+        for (size_t i = 0; i < count; i++) {
+            fprintf(out, "%s{\"start\":%lu,\"length\":%lu}", i > 0 ? "," : "",
+                    ranges[i].start, ranges[i].end - ranges[i].start);
+        }
+        dfree(ranges);
+        fputs("]}", out);
+    }
+
+    fputs("],\n\"pages\":[", out);
+    for (size_t i = 0; i < report->nof_pages; i++) {
+        const PAGE *page = &report->pages[i];
+        fprintf(out, "%s\n{\"start\":%lu,\"used\":%lu,\"gap\":", i > 0 ? "," : "",
+                page->page * PAGE_BYTES, page->used);
+        if (page->gap > 0) {
+            fprintf(out, "{\"start\":%lu,\"length\":%lu}}", page->gap_start, page->gap);
+        }
+        else {
+            fputs("null}", out);
+        }
+    }
+
+    fputs("],\n\"overlaps\":[", out);
+    for (size_t i = 0; i < report->nof_overlaps; i++) {
+        const OVERLAP *overlap = &report->overlaps[i];
+        fputs(i > 0 ? ",\n{\"segments\":[" : "\n{\"segments\":[", out);
+        put_json_string(overlap->segment->name, out);
+        putc(',', out);
+        put_json_string(overlap->other->name, out);
+        fprintf(out, "],\"start\":%lu,\"length\":%lu}", overlap->range.start,
+                overlap->range.end - overlap->range.start);
+    }
+    fputs("]}\n", out);
+}
+
+void write_memory_maps(void)
+{
+    const OUTPUT *output;
+    OWNED *owned;
+    PAGE *pages = NULL;
+    OVERLAP *overlaps = NULL;
+    REPORT report;
+
+    if (!memmap_needed()) {
+        return;
+    }
+
+    owned = sorted_ranges(&report.nof_owned);
+    report.owned = owned;
+    check_limits(owned, report.nof_owned);
+
+    report.nof_pages = report.nof_overlaps = 0;
+    if (first_output != NULL) {
+        pages = used_pages(owned, report.nof_owned, &report.nof_pages);
+        overlaps = find_overlaps(&report.nof_overlaps);
+    }
+    report.pages = pages;
+    report.overlaps = overlaps;
+
+    for (output = first_output; output != NULL; output = output->next) {
+        FILE *out = create_output(output->name);
+        if (out == NULL) {
+            error_fmt("Unable to open memory map file '%s'.", output->name);
+            continue;
+        }
+        if (output->format == MEMMAP_JSON) {
+            write_json(&report, out);
+        }
+        else {
+            write_text(&report, out);
+        }
+        if (ferror(out)) {
+            error_fmt("Problem writing memory map file '%s'.", output->name);
+        }
+        if (!finish_output(out, true)) {
+            warning_fmt("Problem closing memory map file '%s'.", output->name);
+        }
+    }
+
+    if (pages != NULL) {
+        dfree(pages);
+    }
+    if (overlaps != NULL) {
+        dfree(overlaps);
+    }
+    dfree(owned);
+}
+
+/* vim: set tabstop=4 softtabstop=4 expandtab shiftwidth=4 autoindent: */
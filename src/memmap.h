@@ -0,0 +1,113 @@
+#ifndef _DASM_MEMMAP_H
+#define _DASM_MEMMAP_H
+
+/*
+    $Id$
+
+    the DASM macro assembler (aka small systems cross assembler)
+
+    Copyright (c) 1988-2002 by Matthew Dillon.
+    Copyright (c) 1995 by Olaf "Rhialto" Seibert.
+    Copyright (c) 2003-2008 by Andrew Davie.
+    Copyright (c) 2008 by Peter H. Froehlich.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/**
+ * @file
+ *
+ * @brief Memory map, -u and -K options.
+ *
+ * Where each segment put things in the final pass: its address
+ * ranges, how many bytes were code and data, fill from DS and ALIGN,
+ * padding ORG added to the output file in front of them, and space
+ * reserved in BSS segments; for every 256-byte page in use how many
+ * bytes are taken and its largest free gap; and where segments
+ * overlap. That's what it takes to see how full the banks of a
+ * cartridge are.
+ *
+ * -u1name writes this as text, -u2name as a JSON document:
+ *
+ *   {"segments":[{"name":"CODE","bss":false,"used":420,"fill":12,
+ *     "padding":0,"reserved":0,"limit":null,
+ *     "ranges":[{"start":4096,"length":432}]}],
+ *    "pages":[{"start":4096,"used":256,"gap":null}, ...],
+ *    "overlaps":[{"segments":["CODE","DATA"],"start":4200,"length":8}]}
+ *
+ * -Kname=low-high limits segment name to addresses low to high
+ * (inclusive, numbers as in the source); going outside is an error,
+ * so a bank or the zero page overflowing fails the build.
+ */
+
+#include "asm.h"
+
+/**
+ * @brief Memory map formats for -u option.
+ */
+typedef enum
+{
+    /* actual formats */
+    MEMMAP_TEXT = 1,
+    MEMMAP_JSON = 2,
+
+    /* meta data */
+    MEMMAP_MIN = MEMMAP_TEXT,
+    MEMMAP_MAX = MEMMAP_JSON
+}
+memmap_format_t;
+
+/**
+ * @brief Write the memory map in the given format to the named file
+ * at the end, -u option; false if there's no such format.
+ * @pre name != NULL
+ */
+bool add_memmap_output(int format, const char *name);
+
+/**
+ * @brief Limit the named segment to addresses low to high, -K
+ * option; false if that's not a range.
+ * @pre name != NULL
+ */
+bool add_segment_limit(const char *name, unsigned long low, unsigned long high);
+
+/**
+ * @brief Start a new pass, call at the start of every pass;
+ * forgets what the previous pass generated.
+ */
+void begin_memmap_pass(void);
+
+/**
+ * @brief The current segment generated (or, for BSS, reserved)
+ * length bytes at org; fill is true for DS and ALIGN.
+ * @note Does nothing unless some memory map or limit was requested.
+ */
+void memmap_append(unsigned long org, size_t length, bool fill);
+
+/**
+ * @brief ORG padding added length bytes to the output file in
+ * front of what the current segment generates next.
+ */
+void memmap_padding(unsigned long length);
+
+/**
+ * @brief Check the limits and write the memory maps requested,
+ * after the final pass.
+ */
+void write_memory_maps(void);
+
+#endif /* _DASM_MEMMAP_H */
+
+/* vim: set tabstop=4 softtabstop=4 expandtab shiftwidth=4 autoindent: */
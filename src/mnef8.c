@@ -185,7 +185,6 @@ static int parse_value(const char *str, unsigned long *value) {
     else {
         *value = sym->value;
     }
-    free_symbol_list(sym);
 
     return result;
 }
@@ -743,8 +742,9 @@ MNEMONIC MneF8[] = {
      *
      * some instructions have AF_IMP in der addressflag, although
      * they are handled by own handlers and have explicit operands.
-     * this is to keep dasm from clearing the opcode array when
-     * adding the hashtable.
+     * this used to keep dasm from clearing the opcode array when
+     * adding the hashtable; now it just documents that opcode[0]
+     * is the (only) opcode.
      *
      * the only instructions that are handled by v_mnemonic are
      * those with implicit operands.
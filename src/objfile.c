@@ -0,0 +1,311 @@
+/*
+    $Id$
+
+    the DASM macro assembler (aka small systems cross assembler)
+
+    Copyright (c) 1988-2002 by Matthew Dillon.
+    Copyright (c) 1995 by Olaf "Rhialto" Seibert.
+    Copyright (c) 2003-2008 by Andrew Davie.
+    Copyright (c) 2008 by Peter H. Froehlich.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/**
+ * @file
+ */
+
+#if defined(__WINDOWS__) || defined(_WIN32) || defined(_WIN64)
+#	define HAVE_MMAP 0
+#else
+	/* open(2), mmap(2) and friends */
+#	define _POSIX_C_SOURCE 200809L
+#	define HAVE_MMAP 1
+#endif
+
+#include "objfile.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool valid_object_format(int format)
+{
+    return (format == OBJECT_DEFAULT || format == OBJECT_RAS
+            || format == OBJECT_RAW || format == OBJECT_RASX);
+}
+
+/* 16-bit number, LSB first. */
+static unsigned long get_word(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+/* 32-bit number, LSB first. */
+static unsigned long get_long(const unsigned char *p)
+{
+    return get_word(p) | (get_word(p + 2) << 16);
+}
+
+/*
+  Get all of the file into memory; we map it if we can, the
+  kernel reads it as we walk through it. Sets memory, mapped,
+  and size; returns the contents or NULL with *error set.
+*/
+static const unsigned char *load_contents(OBJFILE *obj, const char **error)
+{
+    FILE *f;
+    long size;
+    unsigned char *data;
+
+#if HAVE_MMAP
+    {
+        struct stat st;
+        int fd = open(obj->name, O_RDONLY);
+
+        if (fd < 0) {
+            *error = "unable to open input file";
+            return NULL;
+        }
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map != MAP_FAILED) {
+                (void) close(fd);
+                obj->memory = map;
+                obj->mapped = true;
+                obj->size = st.st_size;
+                return map;
+            }
+        }
+        (void) close(fd);
+    }
+#endif
+
+    /* no mmap(2), empty, or not a regular file: read it all */
+    f = fopen(obj->name, "rb");
+    if (f == NULL) {
+        *error = "unable to open input file";
+        return NULL;
+    }
+    if (fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) < 0 || fseek(f, 0, SEEK_SET) != 0) {
+        (void) fclose(f);
+        *error = "unable to read input file";
+        return NULL;
+    }
+    data = malloc(size > 0 ? size : 1);
+    if (data == NULL) {
+        (void) fclose(f);
+        *error = "out of memory";
+        return NULL;
+    }
+    if (fread(data, 1, size, f) != (size_t) size) {
+        (void) fclose(f);
+        free(data);
+        *error = "unable to read input file";
+        return NULL;
+    }
+    (void) fclose(f);
+
+    obj->memory = data;
+    obj->size = size;
+    return data;
+}
+
+/* Append a segment, empty ones carry nothing so we drop them. */
+static void add_segment(OBJFILE *obj, unsigned long org, size_t length,
+                        const unsigned char *data)
+{
+    OBJSEGMENT *seg;
+
+    if (length == 0) {
+        return;
+    }
+
+    if (obj->count == 0 || org < obj->lowest) {
+        obj->lowest = org;
+    }
+    if (obj->count == 0 || org + length > obj->highest) {
+        obj->highest = org + length;
+    }
+
+    seg = &obj->segments[obj->count++];
+    seg->org = org;
+    seg->length = length;
+    seg->data = data;
+}
+
+static bool allocate_segments(OBJFILE *obj, size_t count)
+{
+    obj->segments = malloc((count > 0 ? count : 1) * sizeof(OBJSEGMENT));
+    return obj->segments != NULL;
+}
+
+/* Check and cut format 2, origin + length + data over and over. */
+static const char *cut_ras(OBJFILE *obj, const unsigned char *data)
+{
+    size_t count = 0;
+    size_t at;
+
+    for (at = 0; at < obj->size; at += 4 + get_word(data + at + 2)) {
+        if (obj->size - at < 4) {
+            return "segment header cut short";
+        }
+        if (obj->size - at - 4 < get_word(data + at + 2)) {
+            return "segment longer than the rest of the file";
+        }
+        count += 1;
+    }
+
+    if (!allocate_segments(obj, count)) {
+        return "out of memory";
+    }
+    for (at = 0; at < obj->size; at += 4 + get_word(data + at + 2)) {
+        add_segment(obj, get_word(data + at), get_word(data + at + 2), data + at + 4);
+    }
+
+    return NULL;
+}
+
+/* Check and cut extended RAS, going through the index. */
+static const char *cut_rasx(OBJFILE *obj, const unsigned char *data)
+{
+    size_t count;
+    size_t index;
+    size_t i;
+
+    if (obj->size < RASX_HEADER + RASX_TRAILER
+        || memcmp(data, RASX_MAGIC, 4) != 0
+        || memcmp(data + obj->size - 4, RASX_MAGIC, 4) != 0) {
+        return "not an extended RAS file";
+    }
+
+    count = get_long(data + 4);
+    index = get_long(data + obj->size - RASX_TRAILER);
+    if (index < RASX_HEADER || index > obj->size - RASX_TRAILER
+        || (obj->size - RASX_TRAILER - index) / RASX_ENTRY != count
+        || (obj->size - RASX_TRAILER - index) % RASX_ENTRY != 0) {
+        return "extended RAS index is damaged";
+    }
+
+    if (!allocate_segments(obj, count)) {
+        return "out of memory";
+    }
+    for (i = 0; i < count; i++) {
+        const unsigned char *entry = data + index + i * RASX_ENTRY;
+        unsigned long org = get_long(entry);
+        size_t length = get_long(entry + 4);
+        size_t offset = get_long(entry + 8);
+
+        /* the data has to be in front of the index, after its header */
+        if (offset < RASX_HEADER + RASX_SEGMENT || offset > index
+            || index - offset < length
+            || get_long(data + offset - RASX_SEGMENT) != org
+            || get_long(data + offset - RASX_SEGMENT + 4) != length) {
+            return "extended RAS index is damaged";
+        }
+        add_segment(obj, org, length, data + offset);
+    }
+
+    return NULL;
+}
+
+const char *load_object(const char *name, object_format_t format, OBJFILE *obj)
+{
+    const unsigned char *data;
+    const char *error = NULL;
+
+    assert(name != NULL);
+    assert(valid_object_format(format));
+    assert(obj != NULL);
+
+    memset(obj, 0, sizeof(OBJFILE));
+    obj->name = name;
+
+    data = load_contents(obj, &error);
+    if (data == NULL) {
+        return error;
+    }
+
+    switch (format) {
+        case OBJECT_DEFAULT:
+            /* DASM writes nothing at all if nothing was generated */
+            if (obj->size == 0) {
+                break;
+            }
+            if (obj->size < 2) {
+                error = "Unexcepted end of input file!";
+            }
+            else if (!allocate_segments(obj, 1)) {
+                error = "out of memory";
+            }
+            else {
+                add_segment(obj, get_word(data), obj->size - 2, data + 2);
+            }
+            break;
+        case OBJECT_RAS:
+            error = cut_ras(obj, data);
+            break;
+        case OBJECT_RAW:
+            if (!allocate_segments(obj, 1)) {
+                error = "out of memory";
+            }
+            else {
+                add_segment(obj, 0, obj->size, data);
+            }
+            break;
+        case OBJECT_RASX:
+            error = cut_rasx(obj, data);
+            break;
+        default:
+            assert(false);
+            break;
+    }
+
+    if (error != NULL) {
+        unload_object(obj);
+    }
+    return error;
+}
+
+void unload_object(OBJFILE *obj)
+{
+    assert(obj != NULL);
+
+    free(obj->segments);
+    obj->segments = NULL;
+    obj->count = 0;
+
+#if HAVE_MMAP
+    if (obj->mapped) {
+        (void) munmap(obj->memory, obj->size);
+        obj->memory = NULL;
+        obj->mapped = false;
+        return;
+    }
+#endif
+    free(obj->memory);
+    obj->memory = NULL;
+}
+
+/* vim: set tabstop=4 softtabstop=4 expandtab shiftwidth=4 autoindent: */
@@ -0,0 +1,122 @@
+#ifndef _DASM_OBJFILE_H
+#define _DASM_OBJFILE_H
+
+/*
+    $Id$
+
+    the DASM macro assembler (aka small systems cross assembler)
+
+    Copyright (c) 1988-2002 by Matthew Dillon.
+    Copyright (c) 1995 by Olaf "Rhialto" Seibert.
+    Copyright (c) 2003-2008 by Andrew Davie.
+    Copyright (c) 2008 by Peter H. Froehlich.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/**
+ * @file
+ *
+ * @brief Reading DASM object files, for ftohex and ftobin.
+ *
+ * The whole file is mapped into memory (or read, if we can't
+ * map it) and cut into its segments; all lengths are checked
+ * before anyone gets to see a segment, so a broken file is an
+ * error up front and not halfway through the output. This
+ * doesn't depend on the rest of DASM (no dalloc, no errors).
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Object file formats, same numbers as DASM's -f option.
+ */
+typedef enum
+{
+    OBJECT_DEFAULT = 1, /* origin (16 bits) + data */
+    OBJECT_RAS = 2, /* origin (16 bits) + length (16 bits) + data, repeat */
+    OBJECT_RAW = 3, /* data */
+    OBJECT_RASX = 6 /* extended RAS, see below */
+}
+object_format_t;
+
+/*
+  Extended RAS, all numbers 32 bits LSB first:
+
+    "RASX" count                    header
+    origin length (length bytes)    segment, count times
+    origin length offset            index entry, count times
+    index "RASX"                    trailer
+
+  offset is where the data of a segment starts in the file, index
+  is where the first index entry starts; a loader can go straight
+  to any segment from the last eight bytes of the file.
+*/
+#define RASX_MAGIC "RASX"
+#define RASX_HEADER 8
+#define RASX_SEGMENT 8
+#define RASX_ENTRY 12
+#define RASX_TRAILER 8
+
+/**
+ * @brief Segment of an object file; data points into the file.
+ */
+typedef struct
+{
+    unsigned long org;
+    size_t length;
+    const unsigned char *data;
+}
+OBJSEGMENT;
+
+/**
+ * @brief An object file loaded by load_object().
+ */
+typedef struct
+{
+    const char *name;
+    size_t size;
+    /* segments in the order the file has them */
+    size_t count;
+    OBJSEGMENT *segments;
+    /* lowest address and one past the highest, if count > 0 */
+    unsigned long lowest;
+    unsigned long highest;
+    /* what to give back, mapped or malloc(3)ed */
+    void *memory;
+    bool mapped;
+}
+OBJFILE;
+
+/**
+ * @brief Valid object file format?
+ */
+bool valid_object_format(int format);
+
+/**
+ * @brief Load the named object file of the given format; NULL if
+ * that worked, otherwise an error message (and nothing to unload).
+ */
+const char *load_object(const char *name, object_format_t format, OBJFILE *obj);
+
+/**
+ * @brief Give back everything load_object() got us.
+ */
+void unload_object(OBJFILE *obj);
+
+#endif /* _DASM_OBJFILE_H */
+
+/* vim: set tabstop=4 softtabstop=4 expandtab shiftwidth=4 autoindent: */
@@ -29,8 +29,15 @@
  */
 
 #include "asm.h"
+#include "addrmap.h"
 #include "dalloc.h"
 #include "errors.h"
+#include "files.h"
+#include "image.h"
+#include "listing.h"
+#include "memmap.h"
+#include "overlap.h"
+#include "passes.h"
 #include "symbols.h"
 #include "util.h"
 #include "version.h"
@@ -46,6 +53,9 @@ unsigned char Gen[256];
 static unsigned char OrgFill = DEFORGFILL;
 int	 Glen;
 
+/* genfill() is generating, DS and ALIGN fill for the memory map */
+static bool Filling = false;
+
 static void genfill(int32_t fill, long bytes, int size);
 static void pushif(bool xbool);
 static int get_hex_digit(char c);
@@ -157,6 +167,7 @@ void v_mnemonic(const char *str, MNEMONIC *mne)
     short opidx;
     SYMBOL *symbase;
     unsigned int opsize;
+    bool pinned;
 
     assert(str != NULL);
     assert(mne != NULL);
@@ -164,6 +175,7 @@ void v_mnemonic(const char *str, MNEMONIC *mne)
     Csegment->flags |= SF_REF;
     programlabel();
     symbase = eval(str, true);
+    pinned = next_instruction_pinned();
 
     if (bTrace) {
         printf("PC: %04lx  MNEMONIC: %s  addrmode: %d  ", Csegment->org, mne->name, symbase->addrmode);
@@ -192,13 +204,17 @@ void v_mnemonic(const char *str, MNEMONIC *mne)
     else {
         opsize = (sym->value != 0) ? 1 : 0;
     }
+    if (pinned) {
+        /* oscillated in earlier passes, see check_convergence() */
+        opsize = 2;
+    }
 
     while (badcode(mne,addrmode) && convert_address_mode(addrmode) != 0) {
         addrmode = convert_address_mode(addrmode);
     }
 
     if (bTrace) {
-        printf("mnemask: %08lx adrmode: %d  Cvt[am]: %d\n", mne->okmask, addrmode, convert_address_mode(addrmode));
+        printf("mnemask: %08lx adrmode: %d  Cvt[am]: %d\n", (unsigned long) mne->okmask, addrmode, convert_address_mode(addrmode));
     }
 
     if (badcode(mne,addrmode)) {
@@ -208,7 +224,6 @@ void v_mnemonic(const char *str, MNEMONIC *mne)
         asmerr( ERROR_ILLEGAL_ADDRESSING_MODE, false, sBuffer );
         */
         error_fmt("Invalid addressing mode '%s %s'.", mne->name, str);
-        free_symbol_list(symbase);
         return;
     }
 
@@ -220,7 +235,6 @@ void v_mnemonic(const char *str, MNEMONIC *mne)
             asmerr( ERROR_ILLEGAL_FORCED_ADDRESSING_MODE, false, mne->name );
             */
             error_fmt("Invalid forced addressing mode on '%s'.", mne->name);
-            free_symbol_list(symbase);
             return;
         }
     }
@@ -236,7 +250,7 @@ void v_mnemonic(const char *str, MNEMONIC *mne)
             char sBuffer[128];
             */
 
-            if ((sym->flags & SYM_UNKNOWN) != 0) {
+            if ((sym->flags & SYM_UNKNOWN) != 0 || pinned) {
                 break;
             }
 
@@ -249,7 +263,7 @@ void v_mnemonic(const char *str, MNEMONIC *mne)
         }
         addrmode = convert_address_mode(addrmode);
     }
-    opcode = mne->opcode[addrmode];
+    opcode = mnemonic_opcode(mne, addrmode);
     opidx = 1 + (opcode > 0xFF);
     if (opidx == 2) {
         Gen[0] = opcode >> 8;
@@ -398,8 +412,8 @@ void v_mnemonic(const char *str, MNEMONIC *mne)
         }
     }
     Glen = opidx;
+    note_instruction_length(Glen);
     generate();
-    free_symbol_list(symbase);
 }
 
 /*
@@ -443,8 +457,8 @@ void v_list(const char *str, MNEMONIC UNUSED(*dummy))
 }
 
 /*
-  @brief Return a malloc()ed duplicate of the given string
-  with leading and trailing quotation marks removed.
+  @brief Return a duplicate of the given string, good until the end
+  of the line, with leading and trailing quotation marks removed.
 */
 static char *getfilename(const char *str)
 {
@@ -468,7 +482,7 @@ static char *getfilename(const char *str)
         str++;
     }
 
-    buf = checked_strdup(str);
+    buf = strcpy(scratch_alloc(SCRATCH_LINE, strlen(str) + 1), str);
 
     /* Find trailing quote and kill it. */
     for (end = buf; *end != '\0' && *end != '\"'; ++end);
@@ -488,52 +502,177 @@ v_include(const char *str, MNEMONIC UNUSED(*dummy))
     buf = getfilename(str);
 
     pushinclude(buf);
+}
+
+/*
+  For INCBIN "name", offset, length: cut the name in buf (as returned
+  by getfilename()) short and return where offset and length start in
+  str; NULL if they're not there.
+*/
+static const char *incbin_arguments(const char *str, char *buf)
+{
+    const char *rest;
+
+    if (*str == '\"') {
+        rest = strchr(str + 1, '\"');
+        if (rest == NULL) {
+            return NULL;
+        }
+        rest++;
+    }
+    else {
+        char *comma = strchr(buf, ',');
+        if (comma == NULL) {
+            return NULL;
+        }
+        rest = str + (comma - buf);
+        while (comma > buf && comma[-1] == ' ') {
+            comma--;
+        }
+        *comma = '\0';
+    }
+
+    while (*rest == ' ') {
+        rest++;
+    }
+
+    return (*rest == ',') ? rest + 1 : NULL;
+}
+
+/* INCBIN with offset and (optional) length, sizing passes never read. */
+static void incbin_slice(const char *name, const char *args)
+{
+    SYMBOL *sym = eval(args, false);
+    const unsigned char *contents;
+    size_t size;
+    long offset;
+    long length;
+
+    assert(sym != NULL);
+
+    if ((sym->flags & SYM_UNKNOWN) != 0 ||
+        (sym->next != NULL && (sym->next->flags & SYM_UNKNOWN) != 0)) {
+        ++Redo;
+        Redo_why |= REASON_INCBIN_NOT_RESOLVED;
+        /* a known length still holds its space, labels after it stay put */
+        if (sym->next != NULL && (sym->next->flags & SYM_UNKNOWN) == 0
+            && sym->next->value > 0) {
+            generate_from(NULL, sym->next->value);
+        }
+        return;
+    }
+
+    if (!file_size(name, &size)) {
+        if (report_missing_file(name)) {
+            warning_fmt("Unable to open binary include file '%s'.", name);
+        }
+        return;
+    }
+
+    offset = sym->value;
+    if (offset < 0 || (unsigned long) offset > size) {
+        error_fmt("INCBIN offset %ld is outside of '%s' (%zu bytes).", offset, name, size);
+        return;
+    }
+
+    length = (sym->next != NULL) ? sym->next->value : (long) (size - offset);
+    if (length < 0 || (unsigned long) length > size - offset) {
+        error_fmt("INCBIN length %ld at offset %ld is outside of '%s' (%zu bytes).",
+            length, offset, name, size);
+        return;
+    }
 
-    dfree(buf);
+    if (length == 0) {
+        return;
+    }
+
+    if (Redo != 0) {
+        /* generate_from() doesn't look at the data anyway */
+        generate_from(NULL, length);
+        return;
+    }
+
+    if (!file_slice(name, offset, length, &contents)) {
+        error_fmt("Unable to read binary include file '%s'.", name);
+        return;
+    }
+    generate_from(contents, length);
 }
 
 void
 v_incbin(const char *str, MNEMONIC UNUSED(*dummy))
 {
     char *buf;
-    FILE *binfile;
+    const char *args;
+    const unsigned char *contents;
+    size_t size;
 
     assert(str != NULL);
 
     programlabel();
     buf = getfilename(str);
+    args = incbin_arguments(str, buf);
 
-    binfile = pfopen(buf, "rb");
-    if (binfile != NULL) {
-        if (Redo != 0) {
-            /* optimize: don't actually read the file if not needed */
-            fseek(binfile, 0, SEEK_END);
-            Glen = ftell(binfile);
-            generate();     /* does not access Gen[] if Redo is set */
-        }
-        else {
-            for (;;) {
-                Glen = fread(Gen, 1, sizeof(Gen), binfile);
-                if (Glen <= 0) {
-                    break;
-                }
-                generate();
-            }
-        }
-        if (fclose(binfile) != 0) {
-            warning_fmt("Problem closing binary include file '%s'.", buf);
+    if (args != NULL) {
+        incbin_slice(buf, args);
+    }
+    else if (file_contents(buf, &contents, &size)) {
+        /* straight from the file cache, no need to copy through Gen[] */
+        if (size > 0) {
+            generate_from(contents, size);
         }
     }
-    else {
+    else if (report_missing_file(buf)) {
         warning_fmt("Unable to open binary include file '%s'.", buf);
     }
 
-    dfree(buf);
     Glen = 0;		    /* don't list hexdump */
 }
 
 
 
+/*
+  Segments by name, so switching between them doesn't get slower
+  with every segment the source has; they're never deleted.
+*/
+#define SEGHASHSIZE ((size_t)(1<<7))
+#define SEGHASHAND (SEGHASHSIZE-1)
+
+static SEGMENT *SegHash[SEGHASHSIZE];
+static size_t nof_segments = 0;
+
+SEGMENT *find_segment(const char *name)
+{
+    SEGMENT *seg;
+
+    assert(name != NULL);
+
+    seg = SegHash[(size_t) hash_bytes(HASH_BYTES_INIT, name, strlen(name)) & SEGHASHAND];
+    while (seg != NULL && strcmp(name, seg->name) != 0) {
+        seg = seg->hnext;
+    }
+    return seg;
+}
+
+SEGMENT *new_segment(const char *name, bool bss)
+{
+    SEGMENT *seg = dalloc(sizeof(SEGMENT)); /* [phf] was zero regular */
+    size_t hash = (size_t) hash_bytes(HASH_BYTES_INIT, name, strlen(name)) & SEGHASHAND;
+
+    seg->name = checked_strdup(name);
+    seg->number = nof_segments++;
+    seg->flags= seg->rflags = seg->initflags = seg->initrflags = SF_UNKNOWN;
+    if (bss)
+        seg->flags |= SF_BSS;
+
+    seg->next = Seglist;
+    Seglist = seg;
+    seg->hnext = SegHash[hash];
+    SegHash[hash] = seg;
+
+    return seg;
+}
+
 void
 v_seg(const char *str, MNEMONIC UNUSED(*dummy))
 {
@@ -546,22 +685,15 @@ v_seg(const char *str, MNEMONIC UNUSED(*dummy))
         warning_fmt("Segments must have a name!");
     }
 
-    for (seg = Seglist; seg != NULL; seg = seg->next) {
-        if (strcmp(str, seg->name) == 0) {
-            Csegment = seg;
-            programlabel();
-            /* [phf] seems like a reasonable message, wish I could print more info */
-            notice_fmt("Resuming segment %s.", strlen(str) == 0 ? "with no name" : str);
-            return;
-        }
+    seg = find_segment(str);
+    if (seg != NULL) {
+        Csegment = seg;
+        programlabel();
+        /* [phf] seems like a reasonable message, wish I could print more info */
+        notice_fmt("Resuming segment %s.", strlen(str) == 0 ? "with no name" : str);
+        return;
     }
-    Csegment = seg = dalloc(sizeof(SEGMENT)); /* [phf] was zero regular */
-    seg->next = Seglist;
-    seg->name = checked_strdup(str);
-    seg->flags= seg->rflags = seg->initflags = seg->initrflags = SF_UNKNOWN;
-    Seglist = seg;
-    if (Mnext == AM_BSS)
-        seg->flags |= SF_BSS;
+    Csegment = new_segment(str, Mnext == AM_BSS);
     /* [phf] seems like a reasonable message, wish I could print more info */
     notice_fmt("Created segment %s.", strlen(str) == 0 ? "with no name" : str);
     programlabel();
@@ -610,8 +742,8 @@ static int get_hex_digit(char c)
         error_fmt("Bad hex digit '%c'!", c);
         /* TODO: refactor into error handling code? */
         (void) puts("(Must be a valid hex digit)");
-        if (FI_listfile != NULL) {
-            fputs("(Must be a valid hex digit)\n", FI_listfile);
+        if (listing_active()) {
+            list_text("(Must be a valid hex digit)\n");
         }
     }
     assert(0 <= value && value <= 15);
@@ -709,7 +841,6 @@ v_dc(const char *str, MNEMONIC *mne)
                         ++Redo;
                         Redo_why |= REASON_DV_NOT_RESOLVED_PROBABLY;
                     }
-                    free_symbol_list(tmp);
                 }
                 switch(Mnext) {
                 default: /* TODO: defense? or AM_BYTE really default? [phf] */
@@ -756,7 +887,6 @@ v_dc(const char *str, MNEMONIC *mne)
                     ++Redo;
                     Redo_why |= REASON_DV_NOT_RESOLVED_COULD;
                 }
-                free_symbol_list(tmp);
             }
             switch(Mnext) {
             default: /* TODO: defense? [phf] */
@@ -793,7 +923,6 @@ v_dc(const char *str, MNEMONIC *mne)
         }
     }
     generate();
-    free_symbol_list(sym);
 }
 
 
@@ -834,7 +963,6 @@ v_ds(const char *str, MNEMONIC UNUSED(*dummy))
                 genfill(filler, sym->value, mult);
             }
         }
-        free_symbol_list(sym);
     }
     /* TODO: what if eval returns NULL? */
     assert(sym != NULL);
@@ -885,7 +1013,6 @@ v_org(const char *str, MNEMONIC UNUSED(*dummy))
     }
 
     programlabel();
-    free_symbol_list(sym);
 }
 
 void
@@ -916,7 +1043,6 @@ v_rorg(const char *str, MNEMONIC UNUSED(*dummy))
         }
     }
     programlabel();
-    free_symbol_list(sym);
 }
 
 void
@@ -979,7 +1105,6 @@ v_align(const char *str, MNEMONIC UNUSED(*dummy))
             }
         }
     }
-    free_symbol_list(sym);
     programlabel();
 }
 
@@ -991,6 +1116,21 @@ v_subroutine(const char UNUSED(*str), MNEMONIC UNUSED(*dummy))
     programlabel();
 }
 
+/*
+  Set symbol lab to the value of expression sym; expressions live in
+  the line scratch arena so lab needs its own copy of any string.
+*/
+static void
+assign_symbol(SYMBOL *lab, const SYMBOL *sym)
+{
+    if ((lab->flags & SYM_STRING) != 0) {
+        dfree(lab->string);
+    }
+    lab->value = sym->value;
+    lab->flags = sym->flags & (SYM_UNKNOWN|SYM_STRING);
+    lab->string = ((sym->flags & SYM_STRING) != 0) ? checked_strdup(sym->string) : NULL;
+}
+
 void
 v_equ(const char *str, MNEMONIC *dummy)
 {
@@ -1068,10 +1208,8 @@ v_equ(const char *str, MNEMONIC *dummy)
         }
     }
 
-    lab->value = sym->value;
-    lab->flags = sym->flags & (SYM_UNKNOWN|SYM_STRING);
-    lab->string = sym->string;
-    sym->flags &= ~(SYM_STRING|SYM_MACRO);
+    assign_symbol(lab, sym);
+    note_definition(lab);
 
     /* List the value */
     {
@@ -1086,8 +1224,6 @@ v_equ(const char *str, MNEMONIC *dummy)
         Gen[Glen++] = v >>  8;
         Gen[Glen++] = v;
     }
-
-    free_symbol_list(sym);
 }
 
 void
@@ -1110,6 +1246,7 @@ v_eqm(const char *str, MNEMONIC UNUSED(*dummy))
     lab->value = 0;
     lab->flags = SYM_STRING | SYM_SET | SYM_MACRO;
     lab->string = checked_strdup(str);
+    note_definition(lab);
 }
 
 void
@@ -1133,16 +1270,17 @@ v_echo(const char *str, MNEMONIC UNUSED(*dummy))
                 len = snprintf(buf, sizeof(buf), "$%lx", s->value);
                 assert(len < (int)sizeof(buf));
             }
-            if (FI_listfile != NULL) {
-                fprintf(FI_listfile, " %s", buf);
+            if (listing_active()) {
+                list_text(" %s", buf);
             }
             printf(" %s", buf);
         }
     }
     (void) puts("");
-    if (FI_listfile != NULL) {
-        putc('\n', FI_listfile);
+    if (listing_active()) {
+        list_text("\n");
     }
+    Echoed = true;
 }
 
 void v_set(const char *str, MNEMONIC UNUSED(*dummy))
@@ -1157,11 +1295,8 @@ void v_set(const char *str, MNEMONIC UNUSED(*dummy))
     if (lab == NULL) {
         lab = create_symbol(Av[0], strlen(Av[0]));
     }
-    lab->value = sym->value;
-    lab->flags = sym->flags & (SYM_UNKNOWN|SYM_STRING);
-    lab->string = sym->string;
-    sym->flags &= ~(SYM_STRING|SYM_MACRO);
-    free_symbol_list(sym);
+    assign_symbol(lab, sym);
+    note_definition(lab);
 }
 
 void
@@ -1181,7 +1316,7 @@ v_execmac(const char *str, MACRO *mac)
         return;
     }
     ++Mlevel;
-    base = dalloc(STRLISTSIZE + strlen(str) + 1); /* [phf] was regular */
+    base = scratch_alloc(SCRATCH_PASS, STRLISTSIZE + strlen(str) + 1); /* [phf] was regular */
     base->next = NULL;
     strcpy(base->buf, str);
     psl = &base->next;
@@ -1189,7 +1324,7 @@ v_execmac(const char *str, MACRO *mac)
         const char *sone = str; /* used to be "s1" which clashed with "sl" [phf] */
         while (*str != '\0' && *str != '\n' && *str != ',')
             ++str;
-        sl = dalloc(STRLISTSIZE + (str-sone) + 1); /* [phf] was regular */
+        sl = scratch_alloc(SCRATCH_PASS, STRLISTSIZE + (str-sone) + 1); /* [phf] was regular */
         sl->next = NULL;
         *psl = sl;
         psl = &sl->next;
@@ -1237,17 +1372,13 @@ void
 v_endm(const char UNUSED(*str), MNEMONIC UNUSED(*dummy))
 {
     INCFILE *inc = pIncfile;
-    STRLIST *args, *an;
 
     assert(inc != NULL);
 
     /* programlabel(); contrary to documentation */
     if ((inc->flags & INF_MACRO) != 0) {
         --Mlevel;
-        for (args = inc->args; args != NULL; args = an) {
-            an = args->next;
-            dfree(args);
-        }
+        /* inc->args are in SCRATCH_PASS, see v_execmac() */
         Localindex = inc->saveidx;
 
         Localdollarindex = inc->savedolidx;
@@ -1275,7 +1406,6 @@ v_ifconst(const char *str, MNEMONIC UNUSED(*dummy))
     sym = eval(str, false);
     assert(sym != NULL);
     pushif(sym->flags == 0);
-    free_symbol_list(sym);
 }
 
 void
@@ -1288,7 +1418,6 @@ v_ifnconst(const char *str, MNEMONIC UNUSED(*dummy))
     sym = eval(str, false);
     assert(sym != NULL);
     pushif(sym->flags != 0);
-    free_symbol_list(sym);
 }
 
 void
@@ -1317,7 +1446,6 @@ v_if(const char *str, MNEMONIC UNUSED(*dummy))
     else {
         pushif(!!sym->value);
     }
-    free_symbol_list(sym);
 }
 
 void v_else(const char UNUSED(*str), MNEMONIC UNUSED(*dummy))
@@ -1363,7 +1491,6 @@ void v_repeat(const char *str, MNEMONIC UNUSED(*dummy))
     assert(sym != NULL);
     if (sym->value == 0) {
         pushif(0);
-        free_symbol_list(sym);
         return;
     }
 
@@ -1373,8 +1500,6 @@ void v_repeat(const char *str, MNEMONIC UNUSED(*dummy))
     if (sym->value < 0)
     {
         pushif( 0 );
-        free_symbol_list(sym);
-
         /* [phf] removed
         asmerr( ERROR_REPEAT_NEGATIVE, false, NULL );
         */
@@ -1392,13 +1517,12 @@ void v_repeat(const char *str, MNEMONIC UNUSED(*dummy))
         rp->seek = ftell(pIncfile->fi);
     }
     rp->lineno = pIncfile->lineno;
-    rp->count = sym->value;
+    rp->count = rp->total = sym->value;
     if ((rp->flags = sym->flags) != 0) {
         ++Redo;
         Redo_why |= REASON_REPEAT_NOT_RESOLVED;
     }
     Reploop = rp;
-    free_symbol_list(sym);
     pushif(1);
 }
 
@@ -1429,92 +1553,12 @@ v_repend(const char UNUSED(*str), MNEMONIC UNUSED(*dummy))
     /* TODO: is this an error or a warning or what? [phf] */
 }
 
-static STRLIST *incdirlist;
-
 void
 v_incdir(const char *str, MNEMONIC UNUSED(*dummy))
 {
-    STRLIST **tail;
-    char *buf;
-    bool found = false;
     assert(str != NULL);
 
-    buf = getfilename(str);
-
-    for (tail = &incdirlist; *tail != NULL; tail = &(*tail)->next) {
-        if (strcmp((*tail)->buf, buf) == 0) {
-            found = true;
-        }
-    }
-
-    if (!found) {
-        STRLIST *newdir;
-        newdir = dalloc(STRLISTSIZE + strlen(buf) + 1); /* [phf] was small */
-        strcpy(newdir->buf, buf);
-        *tail = newdir;
-    }
-
-    dfree(buf);
-}
-
-static void
-addpart(char *dest, const char *dir, const char *file)
-{
-#if 0	/* not needed here */
-    if (strchr(file, ':')) {
-        strcpy(dest, file);
-    }
-    else
-#endif
-    {
-        int pos;
-
-        strcpy(dest, dir);
-        pos = strlen(dest);
-        if (pos > 0 && dest[pos-1] != ':' && dest[pos-1] != '/') {
-            dest[pos] = '/';
-            pos++;
-        }
-        strcpy(dest + pos, file);
-    }
-}
-
-FILE *
-pfopen(const char *name, const char *mode)
-{
-    FILE *f;
-    STRLIST *incdir;
-    char *buf;
-
-    assert(name != NULL);
-    assert(mode != NULL);
-
-    f = fopen(name, mode);
-    if (f != NULL) {
-        return f;
-    }
-
-    /* Don't use the incdirlist for absolute pathnames */
-    if (strchr(name, ':')) {
-        return NULL;
-    }
-
-    /* TODO: the above looks like an Amiga leftover? the 512 below
-       is fishy as well, wow... [phf] */
-
-    buf = dalloc(512); /* [phf] was zero regular */
-
-    for (incdir = incdirlist; incdir; incdir = incdir->next) {
-        addpart(buf, incdir->buf, name);
-
-        f = fopen(buf, mode);
-        if (f != NULL) {
-            break;
-        }
-    }
-
-    dfree(buf);
-    return f;
+    add_include_directory(getfilename(str));
 }
 
 
@@ -1523,15 +1567,34 @@ static long Seekback;
 
 void
 generate(void)
+{
+    generate_from(Gen, Glen);
+}
+
+/*
+  Like generate() but for data that isn't in Gen[], INCBIN for example;
+  data is only used in the final pass, so sizing passes can pass NULL.
+*/
+void
+generate_from(const unsigned char *data, size_t length)
 {
     if (Redo == 0)
     {
+        if ((Csegment->flags & SF_UNKNOWN) == 0)
+        {
+            overlap_append(Csegment->org, length);
+            memmap_append(Csegment->org, length, Filling);
+        }
+
         if ((Csegment->flags & SF_BSS) == 0)
         {
             static unsigned long org;
 
-            for (int i = Glen - 1; i >= 0; --i)
-                CheckSum += Gen[i];
+            for (size_t i = 0; i < length; ++i)
+                CheckSum += data[i];
+
+            image_append(Csegment, Csegment->org, data, length);
+            map_append(Csegment->org, data, length);
 
             if (Fisclear)
             {
@@ -1585,13 +1648,20 @@ generate(void)
                     exit(EXIT_FAILURE); /* TODO: necessary? why in the first place? */
                 }
 
+                memmap_padding(Csegment->org - org);
                 while (Csegment->org != org)
                 {
                     putc(OrgFill, FI_temp);
                     ++org;
                 }
 
-                fwrite(Gen, Glen, 1, FI_temp);
+                fwrite(data, length, 1, FI_temp);
+                break;
+
+            case FORMAT_HEX:
+            case FORMAT_SREC:
+            case FORMAT_RASX:
+                /* written from the image in closegenerate() */
                 break;
 
             case FORMAT_RAS:
@@ -1613,19 +1683,19 @@ generate(void)
                     putc(0, FI_temp);
                 }
 
-                fwrite(Gen, Glen, 1, FI_temp);
-                Seglen += Glen;
+                fwrite(data, length, 1, FI_temp);
+                Seglen += length;
                 break;
 
             }
-            org += Glen;
+            org += length;
         }
     }
 
-    Csegment->org += Glen;
+    Csegment->org += length;
 
     if ((Csegment->flags & SF_RORG) != 0) {
-        Csegment->rorg += Glen;
+        Csegment->rorg += length;
     }
 }
 
@@ -1638,6 +1708,13 @@ void closegenerate(void)
             putc(((Seglen >> 8) & 0xFF), FI_temp);
             fseek(FI_temp, 0L, 2);
         }
+        else if (image_format(F_format)) {
+            write_image(F_format, FI_temp, F_outfile);
+        }
+        report_overlaps();
+        write_image_outputs();
+        write_address_maps();
+        write_memory_maps();
     }
 }
 
@@ -1703,11 +1780,13 @@ static void genfill(int32_t fill, long entries, int size)
             break;
     }
 
+    Filling = true;
     for (Glen = size_of_gen; bytes > size_of_gen; bytes -= size_of_gen) {
         generate();
     }
     Glen = bytes;
     generate();
+    Filling = false;
 }
 
 static void pushif(bool xbool)
@@ -0,0 +1,381 @@
+/*
+    $Id$
+
+    the DASM macro assembler (aka small systems cross assembler)
+
+    Copyright (c) 1988-2002 by Matthew Dillon.
+    Copyright (c) 1995 by Olaf "Rhialto" Seibert.
+    Copyright (c) 2003-2008 by Andrew Davie.
+    Copyright (c) 2008 by Peter H. Froehlich.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/**
+ * @file
+ */
+
+
+#include "overlap.h"
+
+#include "errors.h"
+#include "util.h"
+
+#include <assert.h>
+
+#define NONE ((size_t) -1)
+
+/* Where the bytes from address on came from; file is NONE if unknown. */
+typedef struct
+{
+    unsigned long address;
+    size_t file;
+    unsigned long line;
+}
+RUN;
+
+/*
+  Addresses start up to end (not included) a segment generated
+  without a break; a node of a treap by start, max is the largest
+  end in its subtree. Its runs are first_run to last_run.
+*/
+typedef struct
+{
+    unsigned long start;
+    unsigned long end;
+    unsigned long max;
+    size_t left;
+    size_t right;
+    uint32_t priority;
+    bool bss;
+    const SEGMENT *segment;
+    size_t first_run;
+    size_t last_run;
+}
+NODE;
+
+/* Addresses start up to end of node that other generated before. */
+typedef struct
+{
+    unsigned long start;
+    unsigned long end;
+    size_t node;
+    size_t other;
+    RUN site;
+    RUN other_site;
+}
+FOUND;
+
+/* Kept from pass to pass. */
+static ARRAY nodes;
+static ARRAY runs;
+static ARRAY found;
+
+/* Roots of the trees for initialized data and for BSS. */
+static size_t data_root = NONE;
+static size_t bss_root = NONE;
+
+/* The node we're extending, not in a tree yet. */
+static size_t pending = NONE;
+
+/* For treap priorities, the same every pass. */
+static uint32_t random_state;
+
+#define NODE_AT(i) (&((NODE *) nodes.items)[i])
+#define RUN_AT(i) (&((RUN *) runs.items)[i])
+#define FOUND_AT(i) (&((FOUND *) found.items)[i])
+
+void begin_overlap_pass(void)
+{
+    nodes.count = 0;
+    runs.count = 0;
+    found.count = 0;
+    data_root = bss_root = pending = NONE;
+    random_state = 2463534242u;
+}
+
+/* xorshift, good enough to keep a treap balanced */
+static uint32_t next_random(void)
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+/* Line we're at, macro expansions are where the macro was used. */
+static RUN current_site(unsigned long address)
+{
+    RUN site;
+
+    site.address = address;
+    if (!current_source_line(&site.file, &site.line)) {
+        site.file = NONE;
+        site.line = 0;
+    }
+    return site;
+}
+
+static void update(size_t i)
+{
+    NODE *node = NODE_AT(i);
+
+    node->max = node->end;
+    if (node->left != NONE && NODE_AT(node->left)->max > node->max) {
+        node->max = NODE_AT(node->left)->max;
+    }
+    if (node->right != NONE && NODE_AT(node->right)->max > node->max) {
+        node->max = NODE_AT(node->right)->max;
+    }
+}
+
+static size_t rotate_right(size_t i)
+{
+    size_t left = NODE_AT(i)->left;
+
+    NODE_AT(i)->left = NODE_AT(left)->right;
+    NODE_AT(left)->right = i;
+    update(i);
+    update(left);
+    return left;
+}
+
+static size_t rotate_left(size_t i)
+{
+    size_t right = NODE_AT(i)->right;
+
+    NODE_AT(i)->right = NODE_AT(right)->left;
+    NODE_AT(right)->left = i;
+    update(i);
+    update(right);
+    return right;
+}
+
+/* Put node i into the treap at root, returns the new root. */
+static size_t insert(size_t root, size_t i)
+{
+    NODE *node;
+
+    if (root == NONE) {
+        update(i);
+        return i;
+    }
+
+    node = NODE_AT(root);
+    if (NODE_AT(i)->start < node->start) {
+        node->left = insert(node->left, i);
+        if (NODE_AT(node->left)->priority > node->priority) {
+            return rotate_right(root);
+        }
+    }
+    else {
+        node->right = insert(node->right, i);
+        if (NODE_AT(node->right)->priority > node->priority) {
+            return rotate_left(root);
+        }
+    }
+    update(root);
+    return root;
+}
+
+/*
+  Some node in the tree at root that has addresses in start up to
+  end, NONE if there's none. If the left subtree reaches past start
+  but has nothing for us, nothing to the right will either since it
+  all starts after that.
+*/
+static size_t find(size_t root, unsigned long start, unsigned long end)
+{
+    size_t i = root;
+
+    while (i != NONE) {
+        const NODE *node = NODE_AT(i);
+        if (node->start < end && start < node->end) {
+            return i;
+        }
+        if (node->left != NONE && NODE_AT(node->left)->max > start) {
+            i = node->left;
+        }
+        else {
+            i = node->right;
+        }
+    }
+    return NONE;
+}
+
+/* The run of node i that generated address. */
+static const RUN *run_of(size_t i, unsigned long address)
+{
+    size_t low = NODE_AT(i)->first_run;
+    size_t high = NODE_AT(i)->last_run;
+
+    /* last run starting at or before address */
+    while (low < high) {
+        size_t middle = low + (high - low + 1) / 2;
+        if (RUN_AT(middle)->address <= address) {
+            low = middle;
+        }
+        else {
+            high = middle - 1;
+        }
+    }
+    return RUN_AT(low);
+}
+
+/* Check what node i gets next against everything before it. */
+static void check(size_t i, const RUN *site, unsigned long end, bool bss)
+{
+    size_t other = find(data_root, site->address, end);
+    const NODE *node;
+    FOUND *last;
+    FOUND *overlap;
+    unsigned long start;
+
+    if (other == NONE && !bss) {
+        other = find(bss_root, site->address, end);
+    }
+    if (other == NONE) {
+        return;
+    }
+
+    node = NODE_AT(other);
+    start = (node->start > site->address) ? node->start : site->address;
+    if (node->end < end) {
+        end = node->end;
+    }
+
+    /* more of the same overlap, one message is enough */
+    last = (found.count > 0) ? FOUND_AT(found.count - 1) : NULL;
+    if (last != NULL && last->node == i && last->other == other && start <= last->end) {
+        if (end > last->end) {
+            last->end = end;
+        }
+        return;
+    }
+
+    overlap = array_extend(&found, 1, sizeof(FOUND));
+    overlap->start = start;
+    overlap->end = end;
+    overlap->node = i;
+    overlap->other = other;
+    overlap->site = *site;
+    overlap->other_site = *run_of(other, start);
+}
+
+/* Put the pending node into its tree. */
+static void close_pending(void)
+{
+    if (pending != NONE) {
+        if (NODE_AT(pending)->bss) {
+            bss_root = insert(bss_root, pending);
+        }
+        else {
+            data_root = insert(data_root, pending);
+        }
+        pending = NONE;
+    }
+}
+
+void overlap_append(unsigned long org, size_t length)
+{
+    bool bss = (Csegment->flags & SF_BSS) != 0;
+    RUN site;
+    NODE *node;
+    RUN *last;
+
+    if (length == 0) {
+        return;
+    }
+
+    site = current_site(org);
+
+    if (pending != NONE && NODE_AT(pending)->segment == Csegment
+        && NODE_AT(pending)->end == org) {
+        check(pending, &site, org + length, bss);
+        node = NODE_AT(pending);
+        node->end += length;
+        last = RUN_AT(node->last_run);
+        if (last->file != site.file || last->line != site.line) {
+            *(RUN *) array_extend(&runs, 1, sizeof(RUN)) = site;
+            node->last_run = runs.count - 1;
+        }
+        return;
+    }
+
+    close_pending();
+    check(nodes.count, &site, org + length, bss);
+
+    *(RUN *) array_extend(&runs, 1, sizeof(RUN)) = site;
+    node = array_extend(&nodes, 1, sizeof(NODE));
+    node->start = org;
+    node->end = node->max = org + length;
+    node->left = node->right = NONE;
+    node->priority = next_random();
+    node->bss = bss;
+    node->segment = Csegment;
+    node->first_run = node->last_run = runs.count - 1;
+    pending = nodes.count - 1;
+}
+
+static const char *file_of(const RUN *run)
+{
+    return (run->file != NONE) ? source_file_name(run->file) : "command line";
+}
+
+void report_overlaps(void)
+{
+    for (size_t i = 0; i < found.count; i++) {
+        const FOUND *overlap = FOUND_AT(i);
+        const NODE *node = NODE_AT(overlap->node);
+        const NODE *other = NODE_AT(overlap->other);
+        const char *file = file_of(&overlap->site);
+        unsigned long line = overlap->site.line;
+
+        if (node->bss) {
+            notify_at_fmt(ERRORLEVEL_WARNING, file, line,
+                "Space $%04lx-$%04lx reserved in segment '%s' overlaps bytes from %s:%lu in segment '%s'.",
+                overlap->start, overlap->end - 1, node->segment->name,
+                file_of(&overlap->other_site), overlap->other_site.line, other->segment->name);
+        }
+        else if (other->bss) {
+            notify_at_fmt(ERRORLEVEL_WARNING, file, line,
+                "Bytes $%04lx-$%04lx in segment '%s' overlap space reserved at %s:%lu in segment '%s'.",
+                overlap->start, overlap->end - 1, node->segment->name,
+                file_of(&overlap->other_site), overlap->other_site.line, other->segment->name);
+        }
+        else {
+            notify_at_fmt(ERRORLEVEL_ERROR, file, line,
+                "Bytes $%04lx-$%04lx in segment '%s' overlap bytes from %s:%lu in segment '%s'.",
+                overlap->start, overlap->end - 1, node->segment->name,
+                file_of(&overlap->other_site), overlap->other_site.line, other->segment->name);
+        }
+    }
+}
+
+void for_each_overlap(void (*visit)(unsigned long start, unsigned long end,
+                                     const SEGMENT *segment, const SEGMENT *other,
+                                     void *data),
+                      void *data)
+{
+    assert(visit != NULL);
+
+    for (size_t i = 0; i < found.count; i++) {
+        const FOUND *overlap = FOUND_AT(i);
+        visit(overlap->start, overlap->end, NODE_AT(overlap->node)->segment,
+              NODE_AT(overlap->other)->segment, data);
+    }
+}
+
+/* vim: set tabstop=4 softtabstop=4 expandtab shiftwidth=4 autoindent: */
@@ -0,0 +1,80 @@
+#ifndef _DASM_OVERLAP_H
+#define _DASM_OVERLAP_H
+
+/*
+    $Id$
+
+    the DASM macro assembler (aka small systems cross assembler)
+
+    Copyright (c) 1988-2002 by Matthew Dillon.
+    Copyright (c) 1995 by Olaf "Rhialto" Seibert.
+    Copyright (c) 2003-2008 by Andrew Davie.
+    Copyright (c) 2008 by Peter H. Froehlich.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/**
+ * @file
+ *
+ * @brief Segments and ORG regions generating the same addresses.
+ *
+ * Every run of bytes the pass generates (or, in BSS segments,
+ * reserves) is recorded with the line it came from; runs that
+ * continue the last one in the same segment just extend it, the
+ * others go into interval trees by address, one for initialized
+ * data and one for BSS. Each run is checked against the trees as
+ * it is recorded, O(log n) for n separate runs, so this is always
+ * on. Two initialized runs sharing an address are an error, BSS
+ * space over initialized data is a warning; BSS over BSS is how
+ * variables share RAM and fine. Nothing is reported until the
+ * final pass is done, since addresses may still move until then,
+ * and then each message gives both source lines. The memory map
+ * lists the same overlaps.
+ */
+
+#include "asm.h"
+
+/**
+ * @brief Start a new pass, call at the start of every pass;
+ * forgets what the previous pass generated.
+ */
+void begin_overlap_pass(void);
+
+/**
+ * @brief The current segment generated (or, for BSS, reserved)
+ * length bytes at org on the current line.
+ */
+void overlap_append(unsigned long org, size_t length);
+
+/**
+ * @brief Report the overlaps the final pass found.
+ */
+void report_overlaps(void);
+
+/**
+ * @brief Call visit for every overlap of the final pass, in the
+ * order they were found: addresses start up to end (not included)
+ * of segment overlap what other generated (or reserved) before.
+ * @pre visit != NULL
+ */
+void for_each_overlap(void (*visit)(unsigned long start, unsigned long end,
+                                     const SEGMENT *segment, const SEGMENT *other,
+                                     void *data),
+                      void *data);
+
+#endif /* _DASM_OVERLAP_H */
+
+/* vim: set tabstop=4 softtabstop=4 expandtab shiftwidth=4 autoindent: */
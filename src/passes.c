@@ -0,0 +1,431 @@
+/*
+    $Id$
+
+    the DASM macro assembler (aka small systems cross assembler)
+
+    Copyright (c) 1988-2002 by Matthew Dillon.
+    Copyright (c) 1995 by Olaf "Rhialto" Seibert.
+    Copyright (c) 2003-2008 by Andrew Davie.
+    Copyright (c) 2008 by Peter H. Froehlich.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/**
+ * @file
+ */
+
+#include "passes.h"
+
+#include "asm.h"
+#include "dalloc.h"
+#include "errors.h"
+#include "symbols.h"
+#include "util.h"
+
+#include <assert.h>
+
+/*
+  What we know about an instruction. Instructions are known by
+  where they come from: file and line, and the macros, includes,
+  and REPEAT iterations they're in; counting them would go wrong
+  as soon as an IF on an unresolved symbol changes how many a
+  pass sees.
+*/
+typedef struct
+{
+    /* where it comes from, see key_context() */
+    uint64_t key;
+    /* next in hash chain, number + 1, 0 at the end */
+    size_t hnext;
+    /* length in the latest pass, 0 if never seen */
+    size_t length;
+    /* shortest and longest length so far */
+    size_t shortest;
+    size_t longest;
+    /* last pass in which the length changed */
+    int changed_pass;
+    /* forced to its larger encoding? */
+    bool pinned;
+    /* where we first saw it change, for the report */
+    char *file;
+    unsigned long line;
+}
+INSTRUCTION;
+
+/*
+  Instructions live in fixed-size chunks in the order we first
+  saw them, that's the order of the report. Passes mostly see
+  them in that order again, so we check the one after the last
+  first; only if that's not it do we need a hash table on the
+  keys, and we only build it then.
+*/
+#define CHUNK_INSTRUCTIONS 128
+
+typedef struct _CHUNK CHUNK;
+struct _CHUNK
+{
+    CHUNK *next;
+    INSTRUCTION insns[CHUNK_INSTRUCTIONS];
+};
+
+/*
+  Fingerprints of the most recent passes, indexed by pass
+  modulo FINGERPRINTS; cycles longer than that go unnoticed
+  but -p will catch those eventually.
+*/
+#define FINGERPRINTS 256
+
+/* How to deal with oscillating sources for -R option. */
+static oscillation_mode_t F_oscillation = OSCILLATION_DEFAULT;
+
+/* Pass we're in right now. */
+static int current_pass = 0;
+
+/* All instructions seen so far, in the order we first saw them. */
+static CHUNK *first_chunk = NULL;
+static CHUNK **chunks = NULL;
+static size_t nof_chunks = 0;
+static size_t nof_instructions = 0;
+
+/* Hash chains on INSTRUCTION.key, number + 1; size is 2^n, 0 if none yet. */
+static size_t *instruction_hash = NULL;
+static size_t nof_buckets = 0;
+
+/* Number of the instruction v_mnemonic() is working on, + 1. */
+static size_t current = 0;
+
+/* Fingerprints at the end of recent passes. */
+static uint64_t fingerprints[FINGERPRINTS];
+
+/* Oldest pass we may compare against; pinning changes the rules. */
+static int first_comparable_pass = 1;
+
+bool valid_oscillation_mode(int mode)
+{
+    return (OSCILLATION_MIN <= mode && mode <= OSCILLATION_MAX);
+}
+
+void set_oscillation_mode(oscillation_mode_t mode)
+{
+    assert(valid_oscillation_mode(mode));
+    F_oscillation = mode;
+}
+
+void begin_pass_tracking(int pass)
+{
+    current_pass = pass;
+    current = 0;
+}
+
+/* REPEAT iterations going on in file, outermost first. */
+static uint64_t key_repeats(uint64_t hash, const REPLOOP *rp, const INCFILE *file)
+{
+    if (rp == NULL) {
+        return hash;
+    }
+
+    hash = key_repeats(hash, rp->next, file);
+    if (rp->file == file) {
+        unsigned long iteration = rp->total - rp->count;
+        hash = hash_bytes(hash, &rp->lineno, sizeof(rp->lineno));
+        hash = hash_bytes(hash, &iteration, sizeof(iteration));
+    }
+    return hash;
+}
+
+/* Where the current line comes from, all the way out to the source. */
+static uint64_t key_context(uint64_t hash, const INCFILE *file)
+{
+    if (file == NULL) {
+        return hash;
+    }
+
+    hash = key_context(hash, file->next);
+    if (file->name != NULL) {
+        hash = hash_bytes(hash, file->name, strlen(file->name) + 1);
+    }
+    hash = hash_bytes(hash, &file->lineno, sizeof(file->lineno));
+    return key_repeats(hash, Reploop, file);
+}
+
+static INSTRUCTION *instruction(size_t number)
+{
+    return &chunks[number / CHUNK_INSTRUCTIONS]->insns[number % CHUNK_INSTRUCTIONS];
+}
+
+static void hash_instruction(size_t number)
+{
+    INSTRUCTION *insn = instruction(number);
+    size_t *bucket = &instruction_hash[insn->key & (nof_buckets - 1)];
+
+    insn->hnext = *bucket;
+    *bucket = number + 1;
+}
+
+/* Put all instructions into their hash chains, with room to grow. */
+static void hash_instructions(void)
+{
+    size_t count = (nof_buckets == 0) ? 1024 : nof_buckets;
+
+    while (count < 2 * nof_instructions) {
+        count *= 2;
+    }
+    if (instruction_hash != NULL) {
+        dfree(instruction_hash);
+    }
+    instruction_hash = dalloc(count * sizeof(size_t));
+    memset(instruction_hash, 0, count * sizeof(size_t));
+    nof_buckets = count;
+
+    for (size_t i = 0; i < nof_instructions; i++) {
+        hash_instruction(i);
+    }
+}
+
+static size_t new_instruction(uint64_t key)
+{
+    size_t number = nof_instructions;
+
+    if (number % CHUNK_INSTRUCTIONS == 0) {
+        CHUNK *chunk = dalloc(sizeof(CHUNK));
+        memset(chunk, 0, sizeof(CHUNK)); /* never seen */
+        if (nof_chunks % 64 == 0) {
+            CHUNK **more = dalloc((nof_chunks + 64) * sizeof(CHUNK *));
+            if (chunks != NULL) {
+                memcpy(more, chunks, nof_chunks * sizeof(CHUNK *));
+                dfree(chunks);
+            }
+            chunks = more;
+        }
+        if (nof_chunks > 0) {
+            chunks[nof_chunks - 1]->next = chunk;
+        }
+        else {
+            first_chunk = chunk;
+        }
+        chunks[nof_chunks++] = chunk;
+    }
+
+    instruction(number)->key = key;
+    nof_instructions += 1;
+
+    if (instruction_hash != NULL) {
+        if (nof_instructions > nof_buckets / 2) {
+            hash_instructions();
+        }
+        else {
+            hash_instruction(number);
+        }
+    }
+
+    return number;
+}
+
+bool next_instruction_pinned(void)
+{
+    uint64_t key = key_context(HASH_BYTES_INIT, pIncfile);
+    size_t number = current; /* the one after the last */
+
+    if (number < nof_instructions && instruction(number)->key == key) {
+        /* same order as before, the usual case */
+    }
+    else if (number == nof_instructions && instruction_hash == NULL) {
+        /*
+          Everything so far came in the order we know, so all known
+          instructions were seen in this pass already; a new one it is.
+        */
+        number = new_instruction(key);
+    }
+    else {
+        if (instruction_hash == NULL) {
+            hash_instructions();
+        }
+        number = instruction_hash[key & (nof_buckets - 1)];
+        while (number != 0 && instruction(number - 1)->key != key) {
+            number = instruction(number - 1)->hnext;
+        }
+        number = (number != 0) ? number - 1 : new_instruction(key);
+    }
+
+    current = number + 1;
+    return instruction(number)->pinned;
+}
+
+void note_instruction_length(size_t length)
+{
+    INSTRUCTION *insn;
+
+    assert(current != 0);
+    assert(length > 0);
+
+    insn = instruction(current - 1);
+
+    if (insn->length == 0) {
+        insn->shortest = insn->longest = length;
+    }
+    else if (insn->length != length) {
+        insn->changed_pass = current_pass;
+
+        if (insn->file == NULL) {
+            /* macro expansions report the line that expanded them */
+            INCFILE *file = pIncfile;
+            while (file != NULL && (file->flags & INF_MACRO) != 0) {
+                file = file->next;
+            }
+            if (file != NULL) {
+                insn->file = checked_strdup(file->name);
+                insn->line = file->lineno;
+            }
+        }
+    }
+
+    if (length < insn->shortest) {
+        insn->shortest = length;
+    }
+    if (length > insn->longest) {
+        insn->longest = length;
+    }
+    insn->length = length;
+}
+
+static uint64_t fingerprint_segments(uint64_t hash)
+{
+    const SEGMENT *seg;
+
+    for (seg = Seglist; seg != NULL; seg = seg->next) {
+        hash = hash_bytes(hash, &seg->org, sizeof(seg->org));
+        hash = hash_bytes(hash, &seg->rorg, sizeof(seg->rorg));
+        hash = hash_bytes(hash, &seg->flags, sizeof(seg->flags));
+        hash = hash_bytes(hash, &seg->rflags, sizeof(seg->rflags));
+    }
+
+    return hash;
+}
+
+/* Print all instructions whose length changed after the given pass. */
+static size_t ShowOscillatingLines(int pass)
+{
+    const CHUNK *chunk;
+    size_t nOscillating = 0;
+    size_t i;
+
+    for (chunk = first_chunk; chunk != NULL; chunk = chunk->next) {
+        for (i = 0; i < CHUNK_INSTRUCTIONS; i++) {
+            const INSTRUCTION *insn = &chunk->insns[i];
+            if (insn->changed_pass > pass) {
+                if (nOscillating == 0) {
+                    printf("--- Oscillating Line List\n");
+                }
+                printf(
+                    "%s (%lu): %zu or %zu bytes%s\n",
+                    (insn->file != NULL) ? insn->file : "?",
+                    insn->line,
+                    insn->shortest,
+                    insn->longest,
+                    insn->pinned ? " (pinned)" : ""
+                );
+                nOscillating++;
+            }
+        }
+    }
+
+    if (nOscillating > 0) {
+        printf(
+            "--- %zu Oscillating Line%c\n\n",
+            nOscillating,
+            (nOscillating == 1) ? ' ' : 's'
+        );
+    }
+
+    return nOscillating;
+}
+
+/* Pin all instructions whose length changed after the given pass. */
+static size_t pin_oscillating_lines(int pass)
+{
+    CHUNK *chunk;
+    size_t nPinned = 0;
+    size_t i;
+
+    for (chunk = first_chunk; chunk != NULL; chunk = chunk->next) {
+        for (i = 0; i < CHUNK_INSTRUCTIONS; i++) {
+            INSTRUCTION *insn = &chunk->insns[i];
+            if (insn->changed_pass > pass && !insn->pinned) {
+                insn->pinned = true;
+                nPinned++;
+            }
+        }
+    }
+
+    return nPinned;
+}
+
+convergence_t check_convergence(int pass)
+{
+    uint64_t fingerprint;
+    int earlier;
+    int oldest;
+
+    assert(pass >= 1);
+
+    fingerprint = fingerprint_symbols(HASH_BYTES_INIT, pass);
+    fingerprint = fingerprint_segments(fingerprint);
+    fingerprints[pass % FINGERPRINTS] = fingerprint;
+
+    oldest = pass - FINGERPRINTS + 1;
+    if (oldest < first_comparable_pass) {
+        oldest = first_comparable_pass;
+    }
+
+    for (earlier = pass - 1; earlier >= oldest; earlier--) {
+        if (fingerprints[earlier % FINGERPRINTS] == fingerprint) {
+            break;
+        }
+    }
+    if (earlier < oldest) {
+        return CONVERGENCE_CONTINUE;
+    }
+
+    /*
+      If the pass ended just like the one before, nothing changed
+      and nothing oscillates; the source is simply stuck.
+    */
+    if (pass - earlier > 1) {
+        printf(
+            "--- Pass %d ended like pass %d, passes repeat every %d.\n",
+            pass, earlier, pass - earlier
+        );
+        (void) ShowOscillatingSymbols(earlier);
+        (void) ShowOscillatingLines(earlier);
+    }
+
+    if (F_oscillation == OSCILLATION_PIN) {
+        size_t nPinned = pin_oscillating_lines(earlier);
+        if (nPinned > 0) {
+            warning_fmt(
+                "Pinned %zu oscillating instruction%s to the larger encoding.",
+                nPinned, (nPinned == 1) ? "" : "s"
+            );
+            /* states before pinning don't predict anything anymore */
+            first_comparable_pass = pass + 1;
+            return CONVERGENCE_PINNED;
+        }
+    }
+
+    return CONVERGENCE_CYCLE;
+}
+
+/* vim: set tabstop=4 softtabstop=4 expandtab shiftwidth=4 autoindent: */
@@ -0,0 +1,112 @@
+#ifndef _DASM_PASSES_H
+#define _DASM_PASSES_H
+
+/*
+    $Id$
+
+    the DASM macro assembler (aka small systems cross assembler)
+
+    Copyright (c) 1988-2002 by Matthew Dillon.
+    Copyright (c) 1995 by Olaf "Rhialto" Seibert.
+    Copyright (c) 2003-2008 by Andrew Davie.
+    Copyright (c) 2008 by Peter H. Froehlich.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/**
+ * @file
+ *
+ * @brief Noticing when assembler passes go in circles.
+ *
+ * At the end of each pass that needs another one we take a
+ * fingerprint of all symbol values and segment origins. Since
+ * a pass only depends on the state the previous pass left us
+ * in, a fingerprint we've seen before means the passes repeat
+ * forever; we can stop right there instead of burning all the
+ * passes -p allows. Instructions are numbered in the order
+ * v_mnemonic() sees them so we can tell which ones keep
+ * changing size, and (optionally) pin them to their larger
+ * encoding to break the cycle.
+ */
+
+#include "asm.h"
+
+/**
+ * @brief How to deal with oscillating sources, -R option.
+ */
+typedef enum
+{
+    /* actual modes */
+    OSCILLATION_REPORT, /* report and stop */
+    OSCILLATION_PIN, /* pin larger encoding and keep going */
+
+    /* meta data */
+    OSCILLATION_MIN = OSCILLATION_REPORT,
+    OSCILLATION_DEFAULT = OSCILLATION_REPORT,
+    OSCILLATION_MAX = OSCILLATION_PIN
+}
+oscillation_mode_t;
+
+/**
+ * @brief Valid oscillation mode for -R option?
+ */
+bool valid_oscillation_mode(int mode);
+
+/**
+ * @brief Set oscillation mode, -R option.
+ */
+void set_oscillation_mode(oscillation_mode_t mode);
+
+/**
+ * @brief Start numbering instructions from scratch, call at the
+ * start of every pass.
+ */
+void begin_pass_tracking(int pass);
+
+/**
+ * @brief Advance to the next instruction; true if it has been
+ * pinned to its larger encoding.
+ * @note Call once per v_mnemonic(), before choosing the encoding.
+ */
+bool next_instruction_pinned(void);
+
+/**
+ * @brief Record the length of the current instruction.
+ */
+void note_instruction_length(size_t length);
+
+/**
+ * @brief What check_convergence() decided.
+ */
+typedef enum
+{
+    CONVERGENCE_CONTINUE, /* no cycle (yet), do another pass */
+    CONVERGENCE_PINNED, /* cycle, but we pinned some instructions */
+    CONVERGENCE_CYCLE /* cycle, passes will repeat forever */
+}
+convergence_t;
+
+/**
+ * @brief Check whether the pass that just ended repeats an
+ * earlier one; if so, print the symbols and lines that
+ * oscillate.
+ * @pre the pass needs another one, Redo != 0
+ */
+convergence_t check_convergence(int pass);
+
+#endif /* _DASM_PASSES_H */
+
+/* vim: set tabstop=4 softtabstop=4 expandtab shiftwidth=4 autoindent: */
@@ -30,12 +30,16 @@
 #include "symbols.h"
 
 #include "asm.h"
+#include "addrmap.h"
 #include "dalloc.h"
 #include "errors.h"
+#include "files.h"
 #include "util.h"
 #include "version.h"
+#include "xref.h"
 
 #include <assert.h>
+#include <ctype.h>
 #include <limits.h>
 
 /*
@@ -49,17 +53,47 @@
 static SYMBOL *SHash[SHASHSIZE];
 
 /* Special symbols returned by find_symbol. */
-static SYMBOL special_org; /* "." or current origin (PC) */
-static SYMBOL special_dv_eqm; /* ".." or special symbol in EQM as part of DV */
-static SYMBOL special_checksum; /* "..." or current checksum */
+static SYMBOL special_org = {.number = SYMBOL_SPECIAL}; /* "." or current origin (PC) */
+static SYMBOL special_dv_eqm = {.number = SYMBOL_SPECIAL}; /* ".." or special symbol in EQM as part of DV */
+static SYMBOL special_checksum = {.number = SYMBOL_SPECIAL}; /* "..." or current checksum */
 
 /* Name of symbol file if we should write one. */
 /*@null@*/
 static const char *symbol_file_name = NULL;
 
-/* Custom memory management for SYMBOLs.  */
+/* Another symbol file to write, -S option. */
+typedef struct _SYMBOL_OUTPUT SYMBOL_OUTPUT;
+struct _SYMBOL_OUTPUT
+{
+    SYMBOL_OUTPUT *next;
+    int format;
+    const char *name;
+};
+
+/* Symbol files to write at the end, in the order given. */
+static SYMBOL_OUTPUT *first_symbol_output = NULL;
+static SYMBOL_OUTPUT *last_symbol_output = NULL;
+
+/*
+  What fingerprint_symbols() remembers about each symbol between
+  passes, indexed by SYMBOL.number; keeping this out of SYMBOL keeps
+  lookups to a single cache line.
+*/
+typedef struct
+{
+    /* value at the end of the previous pass */
+    long value;
+    /* last pass that ended with a different value than the one before */
+    int changed_pass;
+}
+HISTORY;
+
 /*@null@*/
-static SYMBOL *symbol_free_list = NULL;
+static HISTORY *history = NULL;
+static size_t history_size = 0;
+
+/* Symbols created so far, next SYMBOL.number. */
+static uint32_t nof_symbols = 0;
 
 /* How to sort the symbol table for -T option. */
 static sortmode_t F_sortmode = SORTMODE_DEFAULT;
@@ -181,11 +215,20 @@ SYMBOL *create_symbol(const char *str, size_t len)
            there was no "else" at all originally [phf] */
     }
 
-    sym = alloc_symbol();
-    name = dalloc(len+1); /* [phf] was small */
-    memcpy(name, str, len); /* small_alloc zeros the array for us */ /* TODO: should be strdup? */
+    assert(len <= UINT16_MAX);
+    assert(nof_symbols < UINT32_MAX);
+
+    sym = dalloc(sizeof(SYMBOL)); /* [phf] was small */
+    if (len < sizeof(sym->short_name)) {
+        name = sym->short_name;
+    }
+    else {
+        name = dalloc(len+1); /* [phf] was small */
+    }
+    memcpy(name, str, len); /* dalloc zeros the array for us */
     sym->name = name;
     sym->namelen = len;
+    sym->number = nof_symbols++;
     hash = hash_symbol(str, len);
     sym->next = SHash[hash];
     sym->flags = SYM_UNKNOWN;
@@ -283,56 +326,100 @@ void programlabel(void)
     }
     sym->value = pc;
     sym->flags = (sym->flags & ~SYM_UNKNOWN) | (cflags & SYM_UNKNOWN);
+    note_definition(sym);
+}
+
+void note_definition(const SYMBOL *sym)
+{
+    map_symbol(sym);
+    xref_definition(sym);
 }
 
 SYMBOL *alloc_symbol(void)
+{
+    return scratch_alloc(SCRATCH_LINE, sizeof(SYMBOL));
+}
+
+void clear_all_symbol_refs(void)
 {
     SYMBOL *sym;
+    size_t i;
 
-    if (symbol_free_list != NULL) {
-        sym = symbol_free_list;
-        symbol_free_list = symbol_free_list->next;
-        memset(sym, 0, sizeof(SYMBOL));
-    }
-    else {
-        sym = dalloc(sizeof(SYMBOL)); /* [phf] was small */
+    for (i = 0; i < SHASHSIZE; i++) {
+        for (sym = SHash[i]; sym != NULL; sym = sym->next) {
+            sym->flags &= ~SYM_REF;
+        }
     }
-
-    return sym;
 }
 
-static void free_symbol(SYMBOL *sym)
+uint64_t fingerprint_symbols(uint64_t hash, int pass)
 {
-    assert(sym != NULL);
+    SYMBOL *sym;
+    size_t i;
 
-    if ((sym->flags & SYM_STRING) != 0) {
-        dfree(sym->string); /* TODO: really how we allocate those? [phf] */
+    /* symbols created since last time start out as 0, like before */
+    if (history_size < nof_symbols) {
+        HISTORY *old = history;
+        size_t old_size = history_size;
+
+        while (history_size < nof_symbols) {
+            history_size = (history_size == 0) ? 1024 : history_size * 2;
+        }
+        history = dalloc(history_size * sizeof(HISTORY));
+        if (old != NULL) {
+            memcpy(history, old, old_size * sizeof(HISTORY));
+            dfree(old);
+        }
     }
-    sym->next = symbol_free_list;
-    symbol_free_list = sym;
-}
 
-void free_symbol_list(SYMBOL *sym)
-{
-    SYMBOL *next;
+    for (i = 0; i < SHASHSIZE; i++) {
+        for (sym = SHash[i]; sym != NULL; sym = sym->next) {
+            /* SYM_REF is per pass and gets cleared anyway */
+            dasm_flag_t flags = sym->flags & ~SYM_REF;
 
-    while (sym != NULL) {
-        next = sym->next;
-        free_symbol(sym);
-        sym = next;
+            hash = hash_bytes(hash, &sym->value, sizeof(sym->value));
+            hash = hash_bytes(hash, &flags, sizeof(flags));
+            if ((sym->flags & SYM_STRING) != 0) {
+                hash = hash_bytes(hash, sym->string, strlen(sym->string));
+            }
+
+            if (sym->value != history[sym->number].value) {
+                history[sym->number].value = sym->value;
+                history[sym->number].changed_pass = pass;
+            }
+        }
     }
+
+    return hash;
 }
 
-void clear_all_symbol_refs(void)
+size_t ShowOscillatingSymbols(int pass)
 {
     SYMBOL *sym;
+    size_t nOscillating = 0;
     size_t i;
 
     for (i = 0; i < SHASHSIZE; i++) {
         for (sym = SHash[i]; sym != NULL; sym = sym->next) {
-            sym->flags &= ~SYM_REF;
+            if (history[sym->number].changed_pass > pass) {
+                if (nOscillating == 0) {
+                    printf("--- Oscillating Symbol List\n");
+                }
+                printf("%-24s %s\n", sym->name, sftos(sym->value, sym->flags));
+                nOscillating++;
+            }
         }
     }
+
+    if (nOscillating > 0) {
+        printf(
+            "--- %zu Oscillating Symbol%c\n\n",
+            nOscillating,
+            (nOscillating == 1) ? ' ' : 's'
+        );
+    }
+
+    return nOscillating;
 }
 
 static size_t nof_unresolved_symbols(void)
@@ -384,117 +471,404 @@ size_t ShowUnresolvedSymbols(void)
     return nUnresolved;
 }
 
-static int CompareAlpha( const void *arg1, const void *arg2 )
+/*
+  Sorting the symbol table. Every symbol gets a key up front so we
+  don't compare names over and over: the address, or the first eight
+  bytes of the name in lower case (the name is compared case-insensitive
+  like strcasecmp(3) did, see below), with the rest of the lowered name
+  for the rare ties. The sort is a stable merge sort, so symbols that
+  compare equal stay in hash table order like they did with qsort(3).
+
+  TODO: Note that we compare labels case-insensitive here which
+  is not quite right; I believe we should be case-sensitive as
+  in other contexts where symbols (labels) are compared. But
+  the old CompareAlpha() was case-insensitive as well, so I
+  didn't want to change that right now... [phf]
+*/
+typedef struct
 {
-    /* Simple alphabetic ordering comparison function for quicksort */
+    uint64_t key;
+    /* name in lower case, NULL when sorting by address */
+    const char *lowered;
+    SYMBOL *sym;
+}
+SORTKEY;
 
-    const SYMBOL *sym1 = *(SYMBOL * const *) arg1;
-    const SYMBOL *sym2 = *(SYMBOL * const *) arg2;
+#define PREFIX_BYTES 8
 
-    /*
-       The cast above is wild, thank goodness the Linux man page
-       for qsort(3) has an example explaining it... :-) [phf]
-
-       TODO: Note that we compare labels case-insensitive here which
-       is not quite right; I believe we should be case-sensitive as
-       in other contexts where symbols (labels) are compared. But
-       the old CompareAlpha() was case-insensitive as well, so I
-       didn't want to change that right now... [phf]
-    */
-
-    return strcasecmp(sym1->name, sym2->name);
+static int compare_keys(const SORTKEY *a, const SORTKEY *b)
+{
+    if (a->key != b->key) {
+        return (a->key < b->key) ? -1 : 1;
+    }
+    /* equal prefixes and one name is shorter, then both are equal */
+    if (a->lowered == NULL || a->sym->namelen < PREFIX_BYTES) {
+        return 0;
+    }
+    return strcmp(a->lowered + PREFIX_BYTES, b->lowered + PREFIX_BYTES);
 }
 
-static int CompareAddress( const void *arg1, const void *arg2 )
+static void merge_sort(SORTKEY *keys, SORTKEY *scratch, size_t count)
 {
-    /* Simple numeric ordering comparison function for quicksort */
+    size_t half = count / 2;
+    size_t i, j, k;
+
+    if (count < 2) {
+        return;
+    }
 
-    const SYMBOL *sym1 = *(SYMBOL * const *) arg1;
-    const SYMBOL *sym2 = *(SYMBOL * const *) arg2;
+    merge_sort(keys, scratch, half);
+    merge_sort(keys + half, scratch, count - half);
+
+    /* already in order, common when sorting by address */
+    if (compare_keys(&keys[half - 1], &keys[half]) <= 0) {
+        return;
+    }
 
-    return sym1->value - sym2->value;
+    memcpy(scratch, keys, half * sizeof(SORTKEY));
+    for (i = 0, j = half, k = 0; i < half; k++) {
+        if (j < count && compare_keys(&keys[j], &scratch[i]) < 0) {
+            keys[k] = keys[j++];
+        }
+        else {
+            keys[k] = scratch[i++];
+        }
+    }
 }
 
-/*
-  Display symbol table. Sorted if enough memory, unsorted otherwise.
-*/
-void ShowSymbols(FILE *file)
+SYMBOL **sort_symbols(size_t *count)
 {
-    SYMBOL **symArray;
+    SORTKEY *keys;
+    SORTKEY *scratch;
+    SYMBOL **sorted;
     SYMBOL *sym;
-    size_t i;
-    size_t nSymbols = 0;
-
-    fprintf(file, "--- Symbol List");
+    char *lowered = NULL;
+    char *p;
+    size_t bytes = 0;
+    size_t n = 0;
 
-    /* First count the number of symbols */
-    for (i = 0; i < SHASHSIZE; i++) {
+    for (size_t i = 0; i < SHASHSIZE; i++) {
         for (sym = SHash[i]; sym != NULL; sym = sym->next) {
-            nSymbols++;
+            bytes += sym->namelen + 1;
+            n++;
         }
     }
 
-    /* [phf] stop sorting code from allocating 0 bytes */
-    if (nSymbols <= 0) {
-        fprintf(file, "\nNo symbols to show.\n");
-        goto no_symbols_to_show;
+    *count = n;
+    if (n == 0) {
+        return NULL;
     }
 
-    /* Malloc an array of pointers to data */
-    symArray = (SYMBOL**) dalloc(nSymbols * sizeof(SYMBOL*)); /* [phf] was a REAL malloc(3)!!! */
-    if (symArray == NULL) {
-        fprintf(file, " (unsorted - not enough memory to sort!)\n");
+    keys = dalloc(n * sizeof(SORTKEY));
+    if (F_sortmode == SORTMODE_ALPHA) {
+        lowered = dalloc(bytes);
+    }
 
-        /* Display complete symbol table */
-        for (i = 0; i < SHASHSIZE; i++) {
-            for (sym = SHash[i]; sym != NULL; sym = sym->next) {
-                fprintf(file, "%-24s %s\n", sym->name, sftos(sym->value, sym->flags));
+    p = lowered;
+    n = 0;
+    for (size_t i = 0; i < SHASHSIZE; i++) {
+        for (sym = SHash[i]; sym != NULL; sym = sym->next) {
+            SORTKEY *key = &keys[n++];
+            key->sym = sym;
+            key->lowered = p;
+            if (F_sortmode == SORTMODE_ADDRESS) {
+                /* flip the sign bit so negative values come first */
+                key->key = (uint64_t) sym->value ^ (UINT64_C(1) << 63);
             }
+            else {
+                key->key = 0;
+                for (size_t j = 0; j <= sym->namelen; j++) {
+                    /* strcasecmp(3) in the C locale, only A-Z change */
+                    p[j] = (char) tolower((unsigned char) sym->name[j]);
+                    if (j < PREFIX_BYTES) {
+                        key->key |= (uint64_t) (unsigned char) p[j] << (8 * (PREFIX_BYTES - 1 - j));
+                    }
+                }
+                p += sym->namelen + 1;
+            }
+        }
+    }
+
+    scratch = dalloc((n / 2 + 1) * sizeof(SORTKEY));
+    merge_sort(keys, scratch, n);
+    dfree(scratch);
+
+    sorted = dalloc(n * sizeof(SYMBOL *));
+    for (size_t i = 0; i < n; i++) {
+        sorted[i] = keys[i].sym;
+    }
+
+    if (lowered != NULL) {
+        dfree(lowered);
+    }
+    dfree(keys);
+
+    return sorted;
+}
+
+/*
+  Symbol files are formatted into a buffer by hand, fprintf(3) for
+  every field of every symbol adds up with tens of thousands.
+*/
+typedef struct
+{
+    FILE *file;
+    size_t used;
+    bool failed;
+    char buffer[16384];
+}
+WRITER;
+
+static void flush_writer(WRITER *w)
+{
+    if (w->used > 0 && fwrite(w->buffer, 1, w->used, w->file) != w->used) {
+        w->failed = true;
+    }
+    w->used = 0;
+}
+
+static void put(WRITER *w, const char *text, size_t length)
+{
+    while (length > 0) {
+        size_t room = sizeof(w->buffer) - w->used;
+        if (room == 0) {
+            flush_writer(w);
+            room = sizeof(w->buffer);
+        }
+        if (room > length) {
+            room = length;
+        }
+        memcpy(w->buffer + w->used, text, room);
+        w->used += room;
+        text += room;
+        length -= room;
+    }
+}
+
+static void put_string(WRITER *w, const char *s)
+{
+    put(w, s, strlen(s));
+}
+
+/* Like "%-*s". */
+static void put_padded(WRITER *w, const char *s, size_t length, size_t width)
+{
+    static const char blanks[] = "                        ";
+
+    put(w, s, length);
+    while (length < width) {
+        size_t n = width - length;
+        if (n > sizeof(blanks) - 1) {
+            n = sizeof(blanks) - 1;
         }
+        put(w, blanks, n);
+        length += n;
+    }
+}
+
+/* Like "%0*lx" or "%ld". */
+static void put_number(WRITER *w, unsigned long n, unsigned int base, size_t width)
+{
+    static const char digits[] = "0123456789abcdef";
+    char text[32];
+    size_t i = sizeof(text);
+
+    do {
+        text[--i] = digits[n % base];
+        n /= base;
+    } while (n > 0 || sizeof(text) - i < width);
+
+    put(w, text + i, sizeof(text) - i);
+}
+
+/* What sftos() makes of value and flags. */
+static void put_value(WRITER *w, const SYMBOL *sym)
+{
+    bool paren = (sym->flags & (SYM_MASREF|SYM_SET)) != 0;
+    char marks[4] = {
+        paren ? '(' : ' ',
+        ((sym->flags & SYM_MASREF) != 0) ? 'R' : ' ',
+        ((sym->flags & SYM_SET) != 0) ? 'S' : ' ',
+        paren ? ')' : ' '
+    };
+
+    put_number(w, (unsigned long) sym->value, 16, 4);
+    put(w, ((sym->flags & SYM_UNKNOWN) != 0) ? " ???? " : "      ", 6);
+    put(w, ((sym->flags & SYM_STRING) != 0) ? "str " : "    ", 4);
+    put(w, ((sym->flags & SYM_MACRO) != 0) ? "eqm " : "    ", 4);
+    put(w, marks, sizeof(marks));
+}
+
+static void write_dasm_symbols(WRITER *w, SYMBOL **sorted, size_t count)
+{
+    put_string(w, "--- Symbol List");
+
+    if (count == 0) {
+        put_string(w, "\nNo symbols to show.\n");
+    }
+    else if (F_sortmode == SORTMODE_ADDRESS) {
+        put_string(w, " (sorted by address)\n");
     }
     else {
-        size_t nPtr = 0;
+        put_string(w, " (sorted by symbol)\n");
+    }
 
-        /* Copy the element pointers into the symbol array */
-        for (i = 0; i < SHASHSIZE; i++) {
-            for (sym = SHash[i]; sym != NULL; sym = sym->next) {
-                symArray[nPtr++] = sym;
-            }
+    for (size_t i = 0; i < count; i++) {
+        const SYMBOL *sym = sorted[i];
+
+        /* "%-24s %-12s", what sftos() gives is longer than 12 */
+        put_padded(w, sym->name, sym->namelen, 24);
+        put(w, " ", 1);
+        put_value(w, sym);
+
+        if ((sym->flags & SYM_STRING) != 0) {
+            /* If a string, display actual string */
+            put(w, " \"", 2);
+            put_string(w, sym->string);
+            put(w, "\"", 1);
+        }
+        put(w, "\n", 1);
+    }
+
+    put_string(w, "--- End of Symbol List.\n");
+}
+
+/*
+  VICE monitor labels, load them with "ll"; VICE labels start
+  with a '.' and have only letters, digits and underscores, so
+  local symbols like "3.loop" become ".3_loop".
+*/
+static void write_vice_symbols(WRITER *w, SYMBOL **sorted, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        const SYMBOL *sym = sorted[i];
+
+        /* only addresses, VICE has nothing else */
+        if ((sym->flags & (SYM_UNKNOWN|SYM_STRING|SYM_MACRO)) != 0
+            || sym->value < 0 || sym->value > 0xFFFF) {
+            continue;
         }
 
-        if (F_sortmode == SORTMODE_ADDRESS) {
-            /* Sort via address */
-            fprintf(file, " (sorted by address)\n");
-            qsort(symArray, nPtr, sizeof(SYMBOL*), CompareAddress);
+        put(w, "al C:", 5);
+        put_number(w, (unsigned long) sym->value, 16, 4);
+        put(w, " .", 2);
+        for (size_t j = 0; j < sym->namelen; j++) {
+            char c = sym->name[j];
+            put(w, (isalnum((unsigned char) c) || c == '_') ? &c : "_", 1);
         }
-        else if (F_sortmode == SORTMODE_ALPHA) {
-            /* Sort via name */
-            fprintf(file, " (sorted by symbol)\n");
-            qsort(symArray, nPtr, sizeof(SYMBOL*), CompareAlpha);
+        put(w, "\n", 1);
+    }
+}
+
+/* Field of a CSV file, quoted if it has to be (RFC 4180). */
+static void put_csv(WRITER *w, const char *s)
+{
+    if (strpbrk(s, ",\"\r\n") == NULL) {
+        put_string(w, s);
+        return;
+    }
+
+    put(w, "\"", 1);
+    for (; *s != '\0'; s++) {
+        put(w, s, 1);
+        if (*s == '"') {
+            put(w, "\"", 1);
+        }
+    }
+    put(w, "\"", 1);
+}
+
+/*
+  Comma-separated values for spreadsheets and scripts: name, value
+  in decimal, flags (U unknown, T string, M EQM, R referenced, S
+  SET), and the string if it is one.
+*/
+static void write_csv_symbols(WRITER *w, SYMBOL **sorted, size_t count)
+{
+    put_string(w, "name,value,flags,string\n");
+
+    for (size_t i = 0; i < count; i++) {
+        const SYMBOL *sym = sorted[i];
+        char flags[6];
+        size_t n = 0;
+
+        put_csv(w, sym->name);
+        put(w, ",", 1);
+        if (sym->value < 0) {
+            put(w, "-", 1);
+            put_number(w, -(unsigned long) sym->value, 10, 1);
         }
         else {
-            assert(false);
+            put_number(w, (unsigned long) sym->value, 10, 1);
         }
 
-        /* Now display sorted list */
-
-        for (i = 0; i < nPtr; i++) {
-            /* TODO: format is different here that above [phf] */
-            fprintf(file, "%-24s %-12s", symArray[i]->name, sftos(symArray[i]->value, symArray[i]->flags));
+        if ((sym->flags & SYM_UNKNOWN) != 0) {
+            flags[n++] = 'U';
+        }
+        if ((sym->flags & SYM_STRING) != 0) {
+            flags[n++] = 'T';
+        }
+        if ((sym->flags & SYM_MACRO) != 0) {
+            flags[n++] = 'M';
+        }
+        if ((sym->flags & SYM_MASREF) != 0) {
+            flags[n++] = 'R';
+        }
+        if ((sym->flags & SYM_SET) != 0) {
+            flags[n++] = 'S';
+        }
+        put(w, ",", 1);
+        put(w, flags, n);
 
-            if ((symArray[i]->flags & SYM_STRING) != 0) {
-                /* If a string, display actual string */
-                /* TODO: we don't do this above? [phf] */
-                fprintf(file, " \"%s\"", symArray[i]->string);
-            }
-            fprintf(file, "\n");
+        put(w, ",", 1);
+        if ((sym->flags & SYM_STRING) != 0) {
+            put_csv(w, sym->string);
         }
+        put(w, "\n", 1);
+    }
+}
+
+/* Write the sorted symbols in the given format, false if that failed. */
+static bool write_symbols(int format, FILE *file, SYMBOL **sorted, size_t count)
+{
+    WRITER *w = dalloc(sizeof(WRITER));
+    bool ok;
 
-        dfree(symArray);
+    w->file = file;
+    switch (format) {
+        case SYMBOLS_DASM:
+            write_dasm_symbols(w, sorted, count);
+            break;
+        case SYMBOLS_VICE:
+            write_vice_symbols(w, sorted, count);
+            break;
+        case SYMBOLS_CSV:
+            write_csv_symbols(w, sorted, count);
+            break;
+        default:
+            assert(false);
+            break;
     }
+    flush_writer(w);
+    ok = !w->failed;
+    dfree(w);
 
-no_symbols_to_show:
-    fputs("--- End of Symbol List.\n", file);
+    return ok;
+}
+
+/*
+  Display symbol table, sorted according to -T option.
+*/
+void ShowSymbols(FILE *file)
+{
+    size_t count;
+    SYMBOL **sorted = sort_symbols(&count);
+
+    (void) write_symbols(SYMBOLS_DASM, file, sorted, count);
+
+    if (sorted != NULL) {
+        dfree(sorted);
+    }
 }
 
 /* Functions for writing symbol files. */
@@ -506,25 +880,76 @@ void set_symbol_file_name(const char *name)
     symbol_file_name = name;
 }
 
-void DumpSymbolTable(void)
+bool valid_symbol_format(int format)
 {
-    if (symbol_file_name == NULL) {
-        /* no name, nothing to do */
-        return;
+    return (SYMBOLS_MIN <= format && format <= SYMBOLS_MAX);
+}
+
+bool add_symbol_output(int format, const char *name)
+{
+    SYMBOL_OUTPUT *output;
+
+    assert(name != NULL);
+
+    if (!valid_symbol_format(format)) {
+        return false;
     }
 
-    FILE *fi = fopen(symbol_file_name, "w");
+    output = dalloc(sizeof(SYMBOL_OUTPUT));
+    output->format = format;
+    output->name = name;
+
+    if (last_symbol_output == NULL) {
+        first_symbol_output = output;
+    }
+    else {
+        last_symbol_output->next = output;
+    }
+    last_symbol_output = output;
+
+    return true;
+}
+
+static void dump_symbols(int format, const char *name, SYMBOL **sorted, size_t count)
+{
+    FILE *fi = create_output(name);
     if (fi == NULL) {
-        warning_fmt("Unable to open symbol dump file '%s'.",
-                    symbol_file_name);
+        warning_fmt("Unable to open symbol dump file '%s'.", name);
+        return;
+    }
+
+    if (!write_symbols(format, fi, sorted, count)) {
+        warning_fmt("Problem writing symbol file '%s'.", name);
+    }
+
+    if (!finish_output(fi, true)) {
+        warning_fmt("Problem closing symbol file '%s'.", name);
+    }
+}
+
+void DumpSymbolTable(void)
+{
+    const SYMBOL_OUTPUT *output;
+    SYMBOL **sorted;
+    size_t count;
+
+    if (symbol_file_name == NULL && first_symbol_output == NULL) {
+        /* no name, nothing to do */
         return;
     }
 
-    ShowSymbols(fi);
+    /* sorted once for all of them */
+    sorted = sort_symbols(&count);
+
+    if (symbol_file_name != NULL) {
+        dump_symbols(SYMBOLS_DASM, symbol_file_name, sorted, count);
+    }
+    for (output = first_symbol_output; output != NULL; output = output->next) {
+        dump_symbols(output->format, output->name, sorted, count);
+    }
 
-    if (fclose(fi) != 0) {
-        warning_fmt("Problem closing symbol file '%s'.",
-                    symbol_file_name);
+    if (sorted != NULL) {
+        dfree(sorted);
     }
 }
 
@@ -34,17 +34,46 @@
 
 #include "asm.h"
 
+#include <stdint.h>
+
 void programlabel(void);
 void ShowSymbols(FILE *file);
 size_t ShowUnresolvedSymbols(void);
 void DumpSymbolTable(void);
 
+/**
+ * @brief The current line defined sym (label, EQU, SET, or EQM);
+ * tells the address map and the cross-reference where.
+ */
+void note_definition(const SYMBOL *sym);
+
+/**
+ * @brief All symbols in the order of the -T option, *count of them;
+ * give the array back with dfree(), NULL if there are no symbols.
+ */
+SYMBOL **sort_symbols(size_t *count);
+
 /**
  * @brief Remove the SYM_REF flag from all symbols in the
  * hash table.
  */
 void clear_all_symbol_refs(void);
 
+/**
+ * @brief Fold the values and flags of all symbols into hash at the
+ * end of the given pass; symbols whose value differs from the end
+ * of the previous pass remember that they changed in this pass.
+ * @note Used to recognize passes that repeat an earlier one.
+ */
+uint64_t fingerprint_symbols(uint64_t hash, int pass);
+
+/**
+ * @brief Print all symbols whose value changed after the given pass,
+ * return how many there were.
+ * @pre fingerprint_symbols() was called at the end of this pass
+ */
+size_t ShowOscillatingSymbols(int pass);
+
 /**
  * @brief Set the special symbol for ".." used as part of
  * a DV pseudo-op.
@@ -57,9 +86,8 @@ void set_special_dv_symbol(int value, dasm_flag_t flags);
  * @brief Create symbol with given name and add it to the hash table.
  * @warning Truncates names to MAX_SYM_LEN!
  * @note Generates custom names for local symbols (those starting
- * with '.' or ending with '$'). Uses alloc_symbol() internally.
- * Uses small_alloc() internally for the name of the symbol. The
- * created symbol is SYM_UNKNOWN.
+ * with '.' or ending with '$'). Uses dalloc() internally for the
+ * symbol and its name. The created symbol is SYM_UNKNOWN.
  * @pre str != NULL && len > 0
  */
 SYMBOL *create_symbol(const char *str, size_t len);
@@ -77,18 +105,13 @@ SYMBOL *create_symbol(const char *str, size_t len);
 SYMBOL *find_symbol(const char *str, size_t len);
 
 /**
- * @brief Allocate a fresh symbol.
- * @note Uses small_alloc() internally and manages a custom
- * free list of symbols to reuse memory.
+ * @brief Allocate a fresh symbol for an expression result.
+ * @note Comes from the SCRATCH_LINE arena, so the symbol (and
+ * its string, if any) is gone once the current line is done;
+ * copy whatever needs to outlive the line.
  */
 SYMBOL *alloc_symbol(void);
 
-/**
- * @brief Free zero or more symbols.
- * @note Manages a custom free list of symbols to reuse memory.
- */
-void free_symbol_list(SYMBOL *sym);
-
 /**
  * @brief A symbol file of the given name will be produced.
  * @warning Can only be called once!
@@ -96,6 +119,34 @@ void free_symbol_list(SYMBOL *sym);
  */
 void set_symbol_file_name(const char *name);
 
+/**
+ * @brief Symbol file formats for -S option.
+ */
+typedef enum
+{
+    /* actual formats */
+    SYMBOLS_DASM = 1, /* what -s writes, Stella reads it too */
+    SYMBOLS_VICE = 2, /* VICE monitor labels */
+    SYMBOLS_CSV = 3, /* comma-separated values */
+
+    /* meta data */
+    SYMBOLS_MIN = SYMBOLS_DASM,
+    SYMBOLS_MAX = SYMBOLS_CSV
+}
+symbol_format_t;
+
+/**
+ * @brief Valid symbol file format for -S option?
+ */
+bool valid_symbol_format(int format);
+
+/**
+ * @brief Also write the symbols in the given format to the named
+ * file, -S option; false if there's no such format.
+ * @pre name != NULL
+ */
+bool add_symbol_output(int format, const char *name);
+
 /**
  * @brief Sort mode for symbol table for -T option.
  */
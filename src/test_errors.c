@@ -33,6 +33,7 @@
 #include "errors.h"
 
 #include "asm.h"
+#include "listing.h"
 #include "util.h"
 
 #include <assert.h>
@@ -40,7 +41,8 @@
 #include <string.h>
 
 /* fakes for unit test */
-FILE *FI_listfile = NULL;
+bool listing_active(void) { return false; }
+void list_text(const char *format, ...) { (void) format; }
 char *F_listfile = NULL;
 INCFILE *pIncfile = NULL;
 
@@ -63,6 +65,22 @@ int main(int argc, char *argv[])
     warning_fmt(WARNING_RANGE, "CRAZY", "DEBUG", 2, 14);
     error_fmt(WARNING_RANGE, "CRAZY", "DEBUG", 2, 14);
     fatal_fmt(WARNING_RANGE, "CRAZY", "FATAL", 2, 14);
+    notify_at_fmt(ERRORLEVEL_ERROR, "otherFileName", 11, WARNING_RANGE, "CRAZY", "ELSEWHERE", 2, 14);
+    /* messages in a pass wait for flush_errors(), once per line */
+    {
+        size_t errors = number_of_errors();
+        begin_error_pass();
+        error_fmt(WARNING_RANGE, "CRAZY", "PASS", 2, 14);
+        error_fmt(WARNING_RANGE, "CRAZY", "PASS", 2, 14);
+        assert(number_of_errors() == errors + 1);
+        end_error_pass();
+        flush_errors();
+        /* the next pass forgets them */
+        begin_error_pass();
+        assert(number_of_errors() == errors);
+        end_error_pass();
+        flush_errors();
+    }
     panic_fmt(WARNING_RANGE, "CRAZY", "DEBUG", 2, 14);
     return EXIT_SUCCESS;
 }
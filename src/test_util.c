@@ -35,6 +35,7 @@
 #include "asm.h"
 #include "dalloc.h"
 #include "errors.h"
+#include "listing.h"
 
 #include <assert.h>
 #include <stdlib.h>
@@ -55,7 +56,8 @@ void debug(error_t _error, const char *s)
 #endif
 
 /* fakes for unit test */
-FILE *FI_listfile = NULL;
+bool listing_active(void) { return false; }
+void list_text(const char *format, ...) { (void) format; }
 char *F_listfile = NULL;
 INCFILE *pIncfile = NULL;
 
@@ -130,11 +132,82 @@ int main(int argc, char *argv[])
     assert(res == 25);
     assert(strcmp(fuffer, "Therearesomanygoodthings!") == 0);
 
+    /* SHA-256 test vectors, the long one in pieces that straddle blocks */
+    {
+        static const char *const vectors[][2] = {
+            {"", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+            {"abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+            {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+             "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"},
+        };
+        SHA256 sha;
+        unsigned char digest[SHA256_DIGEST];
+        char hex[2 * SHA256_DIGEST + 1];
+
+        for (size_t v = 0; v < sizeof(vectors) / sizeof(vectors[0]); v++) {
+            size_t length = strlen(vectors[v][0]);
+            sha256_init(&sha);
+            sha256_update(&sha, vectors[v][0], length / 3);
+            sha256_update(&sha, vectors[v][0] + length / 3, length - length / 3);
+            sha256_final(&sha, digest);
+            for (size_t i = 0; i < SHA256_DIGEST; i++) {
+                sprintf(hex + 2 * i, "%02x", digest[i]);
+            }
+            assert(strcmp(hex, vectors[v][1]) == 0);
+        }
+        puts("SHA-256 digests match!");
+    }
+
+    /* JSON strings, through a temporary file */
+    {
+        FILE *f = tmpfile();
+        char json[64];
+        size_t length;
+
+        assert(f != NULL);
+        put_json_string("a\"b\\c\n\x01\xc3\xa4", f);
+        rewind(f);
+        length = fread(json, 1, sizeof(json) - 1, f);
+        json[length] = '\0';
+        (void) fclose(f);
+        assert(strcmp(json, "\"a\\\"b\\\\c\\u000a\\u0001\xc3\xa4\"") == 0);
+        puts("JSON strings match!");
+    }
+
+    /* growing arrays keep what they had */
+    {
+        ARRAY array = { NULL, 0, 0 };
+        int *items;
+
+        for (int i = 0; i < 1000; i++) {
+            *(int *) array_extend(&array, 1, sizeof(int)) = i;
+        }
+        items = array_extend(&array, 3, sizeof(int));
+        items[0] = items[1] = items[2] = -1;
+        assert(array.count == 1003 && array.capacity >= 1003);
+        items = array.items;
+        for (int i = 0; i < 1000; i++) {
+            assert(items[i] == i);
+        }
+        assert(items[1002] == -1);
+        dfree(array.items);
+        puts("Arrays grow!");
+    }
+
     /* fake a current file */
     pIncfile = malloc(sizeof(INCFILE));
     pIncfile->next = NULL;
     pIncfile->name = checked_strdup("someFileName");
     pIncfile->lineno = 47;
+    pIncfile->flags = 0;
+    {
+        size_t file;
+        unsigned long line;
+
+        assert(current_source_line(&file, &line));
+        assert(line == 47 && strcmp(source_file_name(file), "someFileName") == 0);
+        puts("Source lines match!");
+    }
     /* enable all messages */
     set_error_level(ERRORLEVEL_DEBUG);
     /* the tests */
@@ -156,6 +229,30 @@ int main(int argc, char *argv[])
     assert(one < two);
     printf("Second small_alloc()ed returned %p!\n", two);
     one = dalloc(10240); /* [phf] was small */
+    /* recycled and large blocks must come back zeroed, too */
+    for (size_t size = 1; size <= 40000; size = size * 3 + 1) {
+        unsigned char *block = dalloc(size);
+        memset(block, 0xff, size);
+        dfree(block);
+        block = dalloc(size);
+        for (size_t i = 0; i < size; i++) {
+            assert(block[i] == 0);
+        }
+        dfree(block);
+    }
+    puts("Recycled blocks zeroed!");
+    /* scratch memory comes back zeroed after a reset, big or not */
+    for (int round = 0; round < 2; round++) {
+        for (size_t size = 1; size <= 40000; size = size * 3 + 1) {
+            unsigned char *block = scratch_alloc(SCRATCH_LINE, size);
+            for (size_t i = 0; i < size; i++) {
+                assert(block[i] == 0);
+            }
+            memset(block, 0xff, size);
+        }
+        scratch_reset(SCRATCH_LINE);
+    }
+    puts("Scratch blocks zeroed!");
     dfree_all();
     return EXIT_SUCCESS;
 }
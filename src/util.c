@@ -87,6 +87,249 @@ unsigned int hash_string(const char *string, size_t length)
     return hash;
 }
 
+uint64_t hash_bytes(uint64_t hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = data;
+
+    assert(data != NULL || size == 0);
+
+    while (size-- != 0)
+    {
+        hash ^= *bytes++;
+        hash *= UINT64_C(1099511628211);
+    }
+
+    return hash;
+}
+
+/* SHA-256 as in FIPS 180-4. */
+
+static const uint32_t sha256_constants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_block(SHA256 *sha, const unsigned char *block)
+{
+    uint32_t w[64];
+    uint32_t a, b, c, d, e, f, g, h;
+    int i;
+
+    for (i = 0; i < 16; i++) {
+        w[i] = (uint32_t) block[4*i] << 24 | (uint32_t) block[4*i+1] << 16
+             | (uint32_t) block[4*i+2] << 8 | (uint32_t) block[4*i+3];
+    }
+    for (i = 16; i < 64; i++) {
+        uint32_t s0 = ROTR(w[i-15], 7) ^ ROTR(w[i-15], 18) ^ (w[i-15] >> 3);
+        uint32_t s1 = ROTR(w[i-2], 17) ^ ROTR(w[i-2], 19) ^ (w[i-2] >> 10);
+        w[i] = w[i-16] + s0 + w[i-7] + s1;
+    }
+
+    a = sha->state[0]; b = sha->state[1]; c = sha->state[2]; d = sha->state[3];
+    e = sha->state[4]; f = sha->state[5]; g = sha->state[6]; h = sha->state[7];
+
+    for (i = 0; i < 64; i++) {
+        uint32_t t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25))
+                    + ((e & f) ^ (~e & g)) + sha256_constants[i] + w[i];
+        uint32_t t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22))
+                    + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    sha->state[0] += a; sha->state[1] += b; sha->state[2] += c; sha->state[3] += d;
+    sha->state[4] += e; sha->state[5] += f; sha->state[6] += g; sha->state[7] += h;
+}
+
+#undef ROTR
+
+void sha256_init(SHA256 *sha)
+{
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+
+    assert(sha != NULL);
+
+    memcpy(sha->state, initial, sizeof(initial));
+    sha->length = 0;
+    sha->used = 0;
+}
+
+void sha256_update(SHA256 *sha, const void *data, size_t size)
+{
+    const unsigned char *bytes = data;
+
+    assert(sha != NULL);
+    assert(data != NULL || size == 0);
+
+    sha->length += size;
+
+    if (sha->used > 0) {
+        size_t take = sizeof(sha->block) - sha->used;
+        if (take > size) {
+            take = size;
+        }
+        memcpy(sha->block + sha->used, bytes, take);
+        sha->used += take;
+        bytes += take;
+        size -= take;
+        if (sha->used < sizeof(sha->block)) {
+            return;
+        }
+        sha256_block(sha, sha->block);
+        sha->used = 0;
+    }
+
+    for (; size >= sizeof(sha->block); bytes += 64, size -= 64) {
+        sha256_block(sha, bytes);
+    }
+
+    memcpy(sha->block, bytes, size);
+    sha->used = size;
+}
+
+void sha256_final(SHA256 *sha, unsigned char digest[SHA256_DIGEST])
+{
+    uint64_t bits;
+    int i;
+
+    assert(sha != NULL);
+    assert(digest != NULL);
+
+    bits = sha->length * 8;
+
+    sha->block[sha->used++] = 0x80;
+    if (sha->used > 56) {
+        memset(sha->block + sha->used, 0, 64 - sha->used);
+        sha256_block(sha, sha->block);
+        sha->used = 0;
+    }
+    memset(sha->block + sha->used, 0, 56 - sha->used);
+    for (i = 0; i < 8; i++) {
+        sha->block[56 + i] = (unsigned char) (bits >> (56 - 8 * i));
+    }
+    sha256_block(sha, sha->block);
+
+    for (i = 0; i < 8; i++) {
+        digest[4*i] = (unsigned char) (sha->state[i] >> 24);
+        digest[4*i+1] = (unsigned char) (sha->state[i] >> 16);
+        digest[4*i+2] = (unsigned char) (sha->state[i] >> 8);
+        digest[4*i+3] = (unsigned char) sha->state[i];
+    }
+}
+
+void put_json_string(const char *s, FILE *out)
+{
+    assert(s != NULL);
+    assert(out != NULL);
+
+    putc('"', out);
+    for (; *s != '\0'; s++) {
+        unsigned char c = (unsigned char) *s;
+        if (c == '"' || c == '\\') {
+            putc('\\', out);
+            putc(c, out);
+        }
+        else if (c < 0x20) {
+            fprintf(out, "\\u%04x", c);
+        }
+        else {
+            putc(c, out);
+        }
+    }
+    putc('"', out);
+}
+
+void *array_extend(ARRAY *array, size_t count, size_t size)
+{
+    assert(array != NULL);
+    assert(size > 0);
+
+    if (array->capacity - array->count < count) {
+        size_t capacity = 2 * array->capacity + count + 256;
+        void *items = dalloc(capacity * size);
+        if (array->items != NULL) {
+            memcpy(items, array->items, array->count * size);
+            dfree(array->items);
+        }
+        array->items = items;
+        array->capacity = capacity;
+    }
+    array->count += count;
+    return (char *) array->items + (array->count - count) * size;
+}
+
+/* Files we have seen, and the last one we looked up. */
+static char **file_names = NULL;
+static size_t nof_file_names = 0;
+static const char *last_name = NULL;
+static size_t last_file = 0;
+
+/* Index of the named file in file_names, added if it isn't there. */
+static size_t file_index(const char *name)
+{
+    size_t i;
+
+    /* the same file over and over, usually */
+    if (name == last_name && strcmp(file_names[last_file], name) == 0) {
+        return last_file;
+    }
+
+    for (i = 0; i < nof_file_names; i++) {
+        if (strcmp(file_names[i], name) == 0) {
+            break;
+        }
+    }
+    if (i == nof_file_names) {
+        char **more = dalloc((nof_file_names + 1) * sizeof(char *));
+        if (file_names != NULL) {
+            memcpy(more, file_names, nof_file_names * sizeof(char *));
+            dfree(file_names);
+        }
+        file_names = more;
+        file_names[nof_file_names++] = checked_strdup(name);
+    }
+
+    last_name = name;
+    last_file = i;
+    return last_file;
+}
+
+bool current_source_line(size_t *file, unsigned long *line)
+{
+    const INCFILE *inc = pIncfile;
+
+    assert(file != NULL);
+    assert(line != NULL);
+
+    while (inc != NULL && (inc->flags & INF_MACRO) != 0) {
+        inc = inc->next;
+    }
+    if (inc == NULL) {
+        return false;
+    }
+
+    *file = file_index(inc->name);
+    *line = inc->lineno;
+    return true;
+}
+
+const char *source_file_name(size_t file)
+{
+    assert(file < nof_file_names);
+    return file_names[file];
+}
+
 char *checked_strdup(const char *s)
 {
   assert(s != NULL);
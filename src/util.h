@@ -34,6 +34,9 @@
 
 #include "platform.h"
 
+#include <stdint.h>
+#include <stdio.h>
+
 /**
  * @brief
  *   An excellent hash function for strings.
@@ -44,6 +47,104 @@
 
 unsigned int hash_string(const char *string, size_t length);
 
+/**
+ * @brief
+ *   Fold size bytes at data into a running 64-bit hash (FNV-1a);
+ *   start with HASH_BYTES_INIT. Good for fingerprints, not for
+ *   anything cryptographic.
+ *
+ * @pre
+ *   data != NULL || size == 0
+ */
+
+#define HASH_BYTES_INIT UINT64_C(14695981039346656037)
+
+uint64_t hash_bytes(uint64_t hash, const void *data, size_t size);
+
+/**
+ * @brief
+ *   SHA-256 digests, for when we have to trust a hash to tell
+ *   different contents apart, like the result cache does. Call
+ *   sha256_init(), then sha256_update() for all the data, then
+ *   sha256_final() for the digest.
+ */
+
+#define SHA256_DIGEST 32
+
+typedef struct
+{
+    uint32_t state[8];
+    uint64_t length;
+    unsigned char block[64];
+    size_t used;
+}
+SHA256;
+
+void sha256_init(SHA256 *sha);
+
+/**
+ * @pre
+ *   data != NULL || size == 0
+ */
+
+void sha256_update(SHA256 *sha, const void *data, size_t size);
+
+void sha256_final(SHA256 *sha, unsigned char digest[SHA256_DIGEST]);
+
+/**
+ * @brief
+ *   Write s to out as a JSON string, quotes and all; bytes from
+ *   0x80 up go out as they are, so UTF-8 stays UTF-8.
+ */
+
+void put_json_string(const char *s, FILE *out);
+
+/**
+ * @brief
+ *   A growing array; items are dalloc()ed and copied when it runs
+ *   out of room, which doesn't happen often if it's kept from pass
+ *   to pass. An array of all zeros is empty.
+ */
+
+typedef struct
+{
+    void *items;
+    size_t count;
+    size_t capacity;
+}
+ARRAY;
+
+/**
+ * @brief
+ *   Room for count more items of the given size at the end of
+ *   array, returns the first of them.
+ *
+ * @pre
+ *   array != NULL && size > 0
+ */
+
+void *array_extend(ARRAY *array, size_t count, size_t size);
+
+/**
+ * @brief
+ *   Line of the source file being read, macro expansions are
+ *   where the macro was used; the file is an index into a table
+ *   of file names kept for the whole run. False if there's no
+ *   file (command line).
+ *
+ * @pre
+ *   file != NULL && line != NULL
+ */
+
+bool current_source_line(size_t *file, unsigned long *line);
+
+/**
+ * @brief
+ *   Name of a file current_source_line() gave us.
+ */
+
+const char *source_file_name(size_t file);
+
 /**
  * @brief
  *   Return a fresh copy of the given string. Memory is
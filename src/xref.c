@@ -0,0 +1,418 @@
+/*
+    $Id$
+
+    the DASM macro assembler (aka small systems cross assembler)
+
+    Copyright (c) 1988-2002 by Matthew Dillon.
+    Copyright (c) 1995 by Olaf "Rhialto" Seibert.
+    Copyright (c) 2003-2008 by Andrew Davie.
+    Copyright (c) 2008 by Peter H. Froehlich.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/**
+ * @file
+ */
+
+#include "xref.h"
+
+#include "dalloc.h"
+#include "errors.h"
+#include "files.h"
+#include "symbols.h"
+#include "util.h"
+
+#include <assert.h>
+
+/* A line in a source file, see current_source_line(). */
+typedef struct
+{
+    uint32_t file;
+    uint32_t line;
+}
+SITE;
+
+/* What we know about a symbol, indexed by SYMBOL.number. */
+typedef struct
+{
+    SITE definition;
+    bool defined;
+    /* references in the order we saw them, in the arena */
+    SITE *references;
+    uint32_t count;
+    uint32_t capacity;
+}
+XREF;
+
+/* A file to write the cross-reference to, -x option. */
+typedef struct _OUTPUT OUTPUT;
+struct _OUTPUT
+{
+    OUTPUT *next;
+    int format;
+    const char *name;
+};
+
+/*
+  References live in an arena of blocks, reset every pass; a symbol
+  that runs out of room gets twice as much and leaves the old room
+  behind, so at most half of it is wasted.
+*/
+#define BLOCK_SITES 8192
+
+typedef struct _BLOCK BLOCK;
+struct _BLOCK
+{
+    BLOCK *next;
+    size_t size;
+    size_t used;
+    SITE sites[];
+};
+
+static BLOCK *first_block = NULL;
+static BLOCK *current_block = NULL;
+
+static XREF *xrefs = NULL;
+static size_t nof_xrefs = 0;
+
+/* Files to write at the end, in the order given. */
+static OUTPUT *first_output = NULL;
+static OUTPUT *last_output = NULL;
+
+bool add_xref_output(int format, const char *name)
+{
+    OUTPUT *output;
+
+    assert(name != NULL);
+
+    if (format < XREF_MIN || format > XREF_MAX) {
+        return false;
+    }
+
+    output = dalloc(sizeof(OUTPUT));
+    output->format = format;
+    output->name = name;
+
+    if (last_output == NULL) {
+        first_output = output;
+    }
+    else {
+        last_output->next = output;
+    }
+    last_output = output;
+
+    return true;
+}
+
+static bool xref_needed(void)
+{
+    return first_output != NULL;
+}
+
+void begin_xref_pass(void)
+{
+    BLOCK *block;
+
+    for (block = first_block; block != NULL; block = block->next) {
+        block->used = 0;
+    }
+    current_block = first_block;
+
+    if (xrefs != NULL) {
+        memset(xrefs, 0, nof_xrefs * sizeof(XREF));
+    }
+}
+
+static SITE *allocate_sites(size_t count)
+{
+    BLOCK *block = current_block;
+
+    while (block != NULL && block->size - block->used < count) {
+        block = block->next;
+    }
+
+    if (block == NULL) {
+        size_t size = (count > BLOCK_SITES) ? count : BLOCK_SITES;
+        BLOCK **last = &first_block;
+
+        block = dalloc(sizeof(BLOCK) + size * sizeof(SITE));
+        block->size = size;
+        while (*last != NULL) {
+            last = &(*last)->next;
+        }
+        *last = block;
+    }
+
+    current_block = block;
+    block->used += count;
+    return block->sites + block->used - count;
+}
+
+/* Entry for sym, there's one for every symbol there is. */
+static XREF *xref_for(const SYMBOL *sym)
+{
+    if (sym->number >= nof_xrefs) {
+        size_t count = 2 * nof_xrefs + sym->number + 1024;
+        XREF *more = dalloc(count * sizeof(XREF));
+        if (xrefs != NULL) {
+            memcpy(more, xrefs, nof_xrefs * sizeof(XREF));
+            dfree(xrefs);
+        }
+        xrefs = more;
+        nof_xrefs = count;
+    }
+
+    return &xrefs[sym->number];
+}
+
+/*
+  Line in a source file we're at, false if there's none (command
+  line); macro expansions are where the macro was used.
+*/
+static bool current_site(SITE *site)
+{
+    size_t file;
+    unsigned long line;
+
+    if (!current_source_line(&file, &line)) {
+        return false;
+    }
+
+    site->file = (uint32_t) file;
+    site->line = (uint32_t) line;
+    return true;
+}
+
+void xref_definition(const SYMBOL *sym)
+{
+    XREF *xref;
+
+    assert(sym != NULL);
+
+    if (!xref_needed()) {
+        return;
+    }
+
+    xref = xref_for(sym);
+    if (!xref->defined && current_site(&xref->definition)) {
+        xref->defined = true;
+    }
+}
+
+void xref_reference(const SYMBOL *sym)
+{
+    XREF *xref;
+    SITE site;
+
+    assert(sym != NULL);
+
+    /* "." and friends aren't in the symbol table */
+    if (!xref_needed() || sym->number == SYMBOL_SPECIAL || !current_site(&site)) {
+        return;
+    }
+
+    xref = xref_for(sym);
+
+    /* once per line is enough, also for REPEAT */
+    if (xref->count > 0
+        && xref->references[xref->count - 1].file == site.file
+        && xref->references[xref->count - 1].line == site.line) {
+        return;
+    }
+
+    if (xref->count == xref->capacity) {
+        uint32_t capacity = (xref->capacity == 0) ? 4 : 2 * xref->capacity;
+        SITE *more = allocate_sites(capacity);
+        if (xref->count > 0) {
+            memcpy(more, xref->references, xref->count * sizeof(SITE));
+        }
+        xref->references = more;
+        xref->capacity = capacity;
+    }
+    xref->references[xref->count++] = site;
+}
+
+/* What we know about sym, NULL if the final pass never saw it. */
+static const XREF *xref_of(const SYMBOL *sym)
+{
+    const XREF *xref;
+
+    if (sym->number >= nof_xrefs) {
+        return NULL;
+    }
+    xref = &xrefs[sym->number];
+    return (xref->defined || xref->count > 0) ? xref : NULL;
+}
+
+static void put_site(const SITE *site, FILE *out)
+{
+    fprintf(out, "%s:%lu", source_file_name(site->file), (unsigned long) site->line);
+}
+
+/* Name and value like in the symbol file, without the flags. */
+static void put_name_value(const SYMBOL *sym, FILE *out)
+{
+    char value[32];
+
+    if ((sym->flags & SYM_STRING) != 0) {
+        strcpy(value, "str");
+    }
+    else if ((sym->flags & SYM_UNKNOWN) != 0) {
+        strcpy(value, "????");
+    }
+    else {
+        snprintf(value, sizeof(value), "%04lx", (unsigned long) sym->value);
+    }
+    fprintf(out, "%-24s %-8s", sym->name, value);
+}
+
+/* Name, value, definition, and references of a symbol. */
+static void put_xref(const SYMBOL *sym, const XREF *xref, FILE *out)
+{
+    put_name_value(sym, out);
+    putc(' ', out);
+    if (xref->defined) {
+        put_site(&xref->definition, out);
+    }
+    else {
+        putc('-', out);
+    }
+    for (uint32_t j = 0; j < xref->count; j++) {
+        fputs(j == 0 ? ", " : " ", out);
+        put_site(&xref->references[j], out);
+    }
+    putc('\n', out);
+}
+
+/* Symbols defined and referenced count times, with a heading. */
+static void write_text_summary(SYMBOL **sorted, size_t count, uint32_t times,
+                               const char *what, FILE *out)
+{
+    size_t n = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        const XREF *xref = xref_of(sorted[i]);
+        if (xref != NULL && xref->defined && xref->count == times) {
+            n += 1;
+        }
+    }
+
+    fprintf(out, "--- %zu %s\n", n, what);
+    for (size_t i = 0; i < count; i++) {
+        const XREF *xref = xref_of(sorted[i]);
+        if (xref != NULL && xref->defined && xref->count == times) {
+            put_xref(sorted[i], xref, out);
+        }
+    }
+}
+
+static void write_text(SYMBOL **sorted, size_t count, FILE *out)
+{
+    fputs("--- Cross Reference\n", out);
+    fputs("name                     value    defined, referenced\n", out);
+
+    for (size_t i = 0; i < count; i++) {
+        const XREF *xref = xref_of(sorted[i]);
+        if (xref != NULL) {
+            put_xref(sorted[i], xref, out);
+        }
+    }
+
+    write_text_summary(sorted, count, 0, "Unused Symbols", out);
+    write_text_summary(sorted, count, 1, "Symbols Referenced Once", out);
+    fputs("--- End of Cross Reference.\n", out);
+}
+
+static void put_json_site(const SITE *site, FILE *out)
+{
+    fputs("{\"file\":", out);
+    put_json_string(source_file_name(site->file), out);
+    fprintf(out, ",\"line\":%lu}", (unsigned long) site->line);
+}
+
+static void write_json(SYMBOL **sorted, size_t count, FILE *out)
+{
+    for (size_t i = 0; i < count; i++) {
+        const SYMBOL *sym = sorted[i];
+        const XREF *xref = xref_of(sym);
+        if (xref == NULL) {
+            continue;
+        }
+
+        fputs("{\"name\":", out);
+        put_json_string(sym->name, out);
+        if ((sym->flags & (SYM_STRING|SYM_UNKNOWN)) != 0) {
+            fputs(",\"value\":null", out);
+        }
+        else {
+            fprintf(out, ",\"value\":%ld", sym->value);
+        }
+        fputs(",\"defined\":", out);
+        if (xref->defined) {
+            put_json_site(&xref->definition, out);
+        }
+        else {
+            fputs("null", out);
+        }
+        fputs(",\"references\":[", out);
+        for (uint32_t j = 0; j < xref->count; j++) {
+            if (j > 0) {
+                putc(',', out);
+            }
+            put_json_site(&xref->references[j], out);
+        }
+        fputs("]}\n", out);
+    }
+}
+
+void write_cross_references(void)
+{
+    const OUTPUT *output;
+    SYMBOL **sorted;
+    size_t count;
+
+    if (!xref_needed()) {
+        return;
+    }
+
+    sorted = sort_symbols(&count);
+
+    for (output = first_output; output != NULL; output = output->next) {
+        FILE *out = create_output(output->name);
+        if (out == NULL) {
+            warning_fmt("Unable to open cross-reference file '%s'.", output->name);
+            continue;
+        }
+        if (output->format == XREF_TEXT) {
+            write_text(sorted, count, out);
+        }
+        else {
+            write_json(sorted, count, out);
+        }
+        if (ferror(out)) {
+            warning_fmt("Problem writing cross-reference file '%s'.", output->name);
+        }
+        if (!finish_output(out, true)) {
+            warning_fmt("Problem closing cross-reference file '%s'.", output->name);
+        }
+    }
+
+    if (sorted != NULL) {
+        dfree(sorted);
+    }
+}
+
+/* vim: set tabstop=4 softtabstop=4 expandtab shiftwidth=4 autoindent: */
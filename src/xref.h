@@ -0,0 +1,102 @@
+#ifndef _DASM_XREF_H
+#define _DASM_XREF_H
+
+/*
+    $Id$
+
+    the DASM macro assembler (aka small systems cross assembler)
+
+    Copyright (c) 1988-2002 by Matthew Dillon.
+    Copyright (c) 1995 by Olaf "Rhialto" Seibert.
+    Copyright (c) 2003-2008 by Andrew Davie.
+    Copyright (c) 2008 by Peter H. Froehlich.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/**
+ * @file
+ *
+ * @brief Cross-reference, -x option.
+ *
+ * For every symbol, where the final pass defined it and every line
+ * that referenced it; then the symbols defined but never referenced
+ * and those referenced just once, good places to look for dead code
+ * and tables that waste ROM. References inside macros count where
+ * the macro was used, like errors do. Symbols the final pass neither
+ * defined nor referenced (defined on the command line and not used,
+ * or only used in IFs that went the other way) are left out.
+ *
+ * The report comes as text (format 1) or as JSON lines (format 2),
+ * one object per symbol:
+ *
+ *   {"name":"table","value":4096,"defined":{"file":"game.asm","line":12},
+ *    "references":[{"file":"game.asm","line":40}]}
+ *
+ * value is null for strings and unknown values, defined is null for
+ * symbols defined on the command line or not at all.
+ */
+
+#include "asm.h"
+
+/**
+ * @brief Cross-reference formats for -x option.
+ */
+typedef enum
+{
+    /* actual formats */
+    XREF_TEXT = 1,
+    XREF_JSON = 2,
+
+    /* meta data */
+    XREF_MIN = XREF_TEXT,
+    XREF_MAX = XREF_JSON
+}
+xref_format_t;
+
+/**
+ * @brief Write the cross-reference in the given format to the named
+ * file at the end, -x option; false if there's no such format.
+ * @pre name != NULL
+ */
+bool add_xref_output(int format, const char *name);
+
+/**
+ * @brief Start a new pass, call at the start of every pass;
+ * forgets what the previous pass found.
+ */
+void begin_xref_pass(void);
+
+/**
+ * @brief The current line defined sym; only the first definition
+ * in a pass counts.
+ * @note Does nothing unless a cross-reference was requested.
+ */
+void xref_definition(const SYMBOL *sym);
+
+/**
+ * @brief The current line referenced sym.
+ * @note Does nothing unless a cross-reference was requested.
+ */
+void xref_reference(const SYMBOL *sym);
+
+/**
+ * @brief Write the cross-references requested, after the final pass.
+ */
+void write_cross_references(void);
+
+#endif /* _DASM_XREF_H */
+
+/* vim: set tabstop=4 softtabstop=4 expandtab shiftwidth=4 autoindent: */
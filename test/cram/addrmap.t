@@ -0,0 +1,61 @@
+-a writes one JSON object per line for everything that generated
+bytes, with the source line and the macros being expanded.
+
+  $ cat <<'EOF' >m.asm
+  >  processor 6502
+  >  mac load
+  >  lda #{1}
+  >  inner {1}
+  >  endm
+  >  mac inner
+  >  sta {1}
+  >  endm
+  >  org $1000
+  > start nop
+  >  load 5
+  >  seg DATA
+  >  org $2000
+  >  rorg $8000
+  >  dc.b 1,2
+  >  rend
+  > EOF
+
+  $ $TESTDIR/dasm m.asm -f3 -om.bin -am.json -Am.idx
+  $ cat m.json
+  {"address":4096,"rorg":null,"segment":"INITIAL CODE SEGMENT","bytes":"ea","file":"m.asm","line":10,"macros":[]}
+  {"address":4097,"rorg":null,"segment":"INITIAL CODE SEGMENT","bytes":"a905","file":"m.asm","line":11,"macros":[{"name":"load","line":1}]}
+  {"address":4099,"rorg":null,"segment":"INITIAL CODE SEGMENT","bytes":"8505","file":"m.asm","line":11,"macros":[{"name":"load","line":2},{"name":"inner","line":1}]}
+  {"address":8192,"rorg":32768,"segment":"DATA","bytes":"0102","file":"m.asm","line":15,"macros":[]}
+
+-A writes the same as a binary index sorted by address: a header,
+fixed size entries, macro frames, symbols, strings, and the bytes.
+
+  $ od -An -tx1 -N40 m.idx
+   44 4d 41 50 01 00 00 00 04 00 00 00 03 00 00 00
+   a8 00 00 00 01 00 00 00 d8 00 00 00 f0 00 00 00
+   21 01 00 00 00 00 00 00
+  $ od -An -tx1 -j72 -N32 m.idx
+   01 10 00 00 02 00 00 00 ff ff ff ff 06 00 00 00
+   00 00 00 00 0b 00 00 00 00 00 00 00 01 00 00 00
+
+The symbols say where they were defined.
+
+  $ od -An -tx1 -j216 -N24 m.idx
+   2b 00 00 00 00 10 00 00 00 00 00 00 00 00 00 00
+   0a 00 00 00 ff ff ff ff
+
+REPEAT loops are frames too, with the iteration counting from 0.
+
+  $ cat <<'EOF' >r.asm
+  >  processor 6502
+  >  org 0
+  >  repeat 2
+  >  nop
+  >  repend
+  > EOF
+  $ $TESTDIR/dasm r.asm -f3 -or.bin -Ar.idx
+  $ od -An -tx1 -j8 -N8 r.idx
+   02 00 00 00 02 00 00 00
+  $ od -An -tx1 -j104 -N32 r.idx
+   15 00 00 00 03 00 00 00 00 00 00 00 ff ff ff ff
+   15 00 00 00 03 00 00 00 01 00 00 00 ff ff ff ff
@@ -0,0 +1,67 @@
+With -C DASM keeps the outputs of a run in a cache directory, under the
+command line and the contents of every file the run looked at. Running
+again with nothing changed writes the outputs from the cache.
+
+  $ mkdir cache inc
+  $ echo "VALUE = 1" >inc/value.h
+  $ cat <<EOF >c.asm
+  >  processor 6502
+  >  org 0
+  >  incdir "inc"
+  >  include "value.h"
+  >  .byte VALUE
+  > EOF
+
+  $ $TESTDIR/dasm c.asm -f3 -oc.bin -lc.lst -sc.sym -Ccache
+  $ ls cache | sed 's/^[0-9a-f]\{64\}//' | sort
+  .m
+  .r
+  $ cat cache/*.m | sed 's/[0-9a-f]\{64\}/HASH/'
+  + HASH c.asm
+  - value.h
+  + HASH inc/value.h
+
+  $ rm c.bin c.lst c.sym
+  $ $TESTDIR/dasm c.asm -f3 -oc.bin -lc.lst -sc.sym -Ccache
+  $ od -An -tx1 c.bin
+   01
+  $ grep -c VALUE c.sym
+  1
+  $ grep -c "FILE c.asm" c.lst
+  2
+
+A changed include means assembling again, and another result.
+
+  $ echo "VALUE = 2" >inc/value.h
+  $ $TESTDIR/dasm c.asm -f3 -oc.bin -lc.lst -sc.sym -Ccache
+  $ od -An -tx1 c.bin
+   02
+  $ ls cache | wc -l | tr -d ' '
+  3
+
+So does a file showing up where DASM looked for it before.
+
+  $ echo "VALUE = 3" >value.h
+  $ $TESTDIR/dasm c.asm -f3 -oc.bin -lc.lst -sc.sym -Ccache
+  $ od -An -tx1 c.bin
+   03
+
+Runs with warnings are not cached.
+
+  $ echo " include \"missing.h\"" >>c.asm
+  $ $TESTDIR/dasm c.asm -f3 -oc.bin -Ccache
+  c.asm (6): warning: Unable to open include file 'missing.h'.
+  $ $TESTDIR/dasm c.asm -f3 -oc.bin -Ccache
+  c.asm (6): warning: Unable to open include file 'missing.h'.
+
+Neither are runs that ECHO something, a hit wouldn't print it.
+
+  $ cat <<'EOF' >e.asm
+  >  processor 6502
+  >  org 0
+  >  echo "hello"
+  > EOF
+  $ $TESTDIR/dasm e.asm -f3 -oe.bin -Ccache
+   hello
+  $ $TESTDIR/dasm e.asm -f3 -oe.bin -Ccache
+   hello
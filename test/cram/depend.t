@@ -0,0 +1,44 @@
+With -B DASM writes a make rule saying the object file depends on the
+source, every file it includes, and every file INCBIN reads, where they
+were found after searching the INCDIR directories. Files that couldn't be
+found are listed as well, in every directory DASM looked for them, so the
+target is rebuilt once they show up in any of them.
+
+  $ mkdir inc
+  $ echo " .byte 1" >a.h
+  $ echo " .byte 2" >"inc/b h.h"
+  $ printf 'x' >inc/data.bin
+  $ cat <<EOF >dep.asm
+  >  .processor 6502
+  >  .org 0
+  >  .include "a.h"
+  >  .incdir "inc"
+  >  .include "b h.h"
+  >  .incbin "data.bin"
+  >  .include "a.h"
+  > EOF
+
+  $ $TESTDIR/dasm dep.asm -f3 -odep.bin -Bdep.d
+  $ cat dep.d
+  dep.bin: \
+   dep.asm \
+   a.h \
+   inc/b\ h.h \
+   inc/data.bin
+  
+  dep.asm:
+  
+  a.h:
+  
+  inc/b\ h.h:
+  
+  inc/data.bin:
+
+  $ echo ' .include "new.h"' >>dep.asm
+  $ $TESTDIR/dasm dep.asm -f3 -odep.bin -Bdep.d
+  dep.asm (8): warning: Unable to open include file 'new.h'.
+  $ grep new.h dep.d
+   new.h \
+   inc/new.h
+  new.h:
+  inc/new.h:
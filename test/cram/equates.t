@@ -29,8 +29,9 @@ think we should change that behavior.
    $20
 
 Note that redefining "one" with an .equ directive does lead to errors;
-but it results in repeated errors as DASM tries to run pass after pass
-to maybe resolve the problem. Not sure what to do about that:
+DASM tries to run pass after pass to maybe resolve the problem, but we
+only get to see the errors from the last one. Not sure what else to do
+about that:
 
   $ cat <<EOF >equates.asm
   >  .processor 6502
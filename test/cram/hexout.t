@@ -0,0 +1,58 @@
+DASM writes Intel HEX (-f4) and Motorola S-records (-f5) itself, from the
+image of everything the final pass generated; gaps between segments stay
+gaps and BSS segments don't show up. With -F the same image is written to
+more files in one run.
+
+  $ cat <<EOF >hex.asm
+  >  .processor 6502
+  >  .org \$1000
+  >  .ds 20, \$aa
+  >  .org \$2000
+  >  .byte 1, 2, 3
+  >  seg.u ram
+  >  .org \$80
+  >  .ds 4
+  >  seg code
+  >  .org \$fff8
+  >  .word \$1234, \$5678, \$9abc, \$def0
+  > EOF
+
+  $ $TESTDIR/dasm hex.asm -f4 -ohex.hex -F5hex.s19 -F5hex2.s19
+  $ cat hex.hex
+  :10100000AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA40\r (esc)
+  :04101000AAAAAAAA34\r (esc)
+  :03200000010203D7\r (esc)
+  :08FFF80034127856BC9AF0DEC9\r (esc)
+  :00000001FF\r (esc)
+  $ cat hex.s19
+  S0030000FC\r (esc)
+  S1131000AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA3C\r (esc)
+  S1071010AAAAAAAA30\r (esc)
+  S1062000010203D3\r (esc)
+  S10BFFF834127856BC9AF0DEC5\r (esc)
+  S5030004F8\r (esc)
+  S9030000FC\r (esc)
+  $ cmp hex.s19 hex2.s19
+
+Addresses above 64K get extended linear address records in Intel HEX, and
+S28 (or S37) records; no record crosses a 64K boundary.
+
+  $ printf ' .processor 6502\n .org $1fff8\n .ds 12, $55\n' >big.asm
+  $ $TESTDIR/dasm big.asm -f5 -obig.s28 -F4big.hex
+  $ cat big.hex
+  :020000040001F9\r (esc)
+  :08FFF800555555555555555559\r (esc)
+  :020000040002F8\r (esc)
+  :0400000055555555A8\r (esc)
+  :00000001FF\r (esc)
+  $ cat big.s28
+  S0030000FC\r (esc)
+  S21001FFF8555555555555555555555555FB\r (esc)
+  S5030001FB\r (esc)
+  S804000000FB\r (esc)
+
+Only formats that are written from the image work with -F.
+
+  $ $TESTDIR/dasm big.asm -F3big.bin
+  ***panic***: Illegal format specification for -F, must be 4, 5, or 6
+  [1]
@@ -0,0 +1,67 @@
+DASM remembers where it found each include file, and that it didn't find
+one, so it doesn't search the include directories again and again. A file
+that can't be found is reported once per pass no matter how often it is
+included; once INCDIR adds a directory that has it, it's found.
+
+  $ mkdir inc
+  $ echo " .byte 1, 2" >inc/data.h
+  $ cat <<EOF >inc.asm
+  >  .processor 6502
+  >  .org 0
+  >  .repeat 3
+  >  .include "data.h"
+  >  .repend
+  >  .incdir "inc"
+  >  .include "data.h"
+  > EOF
+
+  $ $TESTDIR/dasm inc.asm -f3 -oinc.bin
+  inc.asm (4): warning: Unable to open include file 'data.h'.
+  $ od -An -tx1 inc.bin
+   01 02
+
+INCBIN can include just part of a file, given an offset and optionally a
+length; only that part is read. Parts outside of the file are errors.
+
+  $ printf 'abcdefgh' >data.bin
+  $ cat <<EOF >slice.asm
+  >  .processor 6502
+  >  .org 0
+  >  .incbin "data.bin", 6
+  >  .incbin "data.bin", 1, 2
+  > EOF
+
+  $ $TESTDIR/dasm slice.asm -f3 -oslice.bin
+  $ od -An -c slice.bin
+     g   h   b   c
+
+  $ cat <<EOF >outside.asm
+  >  .processor 6502
+  >  .org 0
+  >  .incbin "data.bin", 9
+  >  .incbin "data.bin", 4, 5
+  > EOF
+
+  $ $TESTDIR/dasm outside.asm -f3 -ooutside.bin
+  outside.asm (3): error: INCBIN offset 9 is outside of 'data.bin' (8 bytes).
+  outside.asm (4): error: INCBIN length 5 at offset 4 is outside of 'data.bin' (8 bytes).
+  [1]
+  $ test -e outside.bin
+  [1]
+
+An offset that isn't known yet still reserves a known length, so the labels
+after the INCBIN don't move and cost another pass.
+
+  $ cat <<'EOF' >later.asm
+  >  .processor 6502
+  >  .org 0
+  >  .incbin "data.bin", offset, 2
+  > after
+  >  .byte after
+  > offset = 3
+  > EOF
+
+  $ $TESTDIR/dasm later.asm -f3 -olater.bin -v1 | grep -c "START OF PASS"
+  2
+  $ od -An -c later.bin
+     d   e 002
@@ -0,0 +1,89 @@
+-u1 writes a memory map: what every segment generated, fill from DS
+and ALIGN, BSS space, how full every page is, and where segments
+overlap. Outputs are only written by a run without errors, so the
+overlap here is BSS space over code, which is just a warning.
+
+  $ cat <<'EOF' >m.asm
+  >  processor 6502
+  >  seg.u ZP
+  >  org $80
+  > a ds 3
+  > b ds.w 2
+  >  seg CODE
+  >  org $f000
+  > start lda a
+  >  sta b
+  >  ds 4,$ea
+  >  align 16
+  >  org $f100
+  >  dc.b 1,2,3
+  >  seg.u DATA
+  >  org $f0fe
+  >  ds 5
+  >  seg CODE
+  >  org $fffc
+  >  dc.w start,start
+  > EOF
+
+  $ $TESTDIR/dasm m.asm -f4 -om.hex -u1m.txt -u2m.json
+  m.asm (16): warning: Space $f100-$f102 reserved in segment 'DATA' overlaps bytes from m.asm:13 in segment 'CODE'.
+  $ cat m.txt
+  --- Memory Map
+  segment                  used     fill     padding  reserved limit
+  ZP                       0        0        0        7        -
+      0080-0086 7
+  CODE                     11       12       0        0        -
+      f000-f00f 16
+      f100-f102 3
+      fffc-ffff 4
+  DATA                     0        0        0        5        -
+      f0fe-f102 5
+  --- Pages
+  page     used     largest gap
+  0000     7        0000-007f 128
+  f000     18       f010-f0fd 238
+  f100     3        f103-f1ff 253
+  ff00     4        ff00-fffb 252
+  --- 1 Overlaps
+  f100-f102 DATA, CODE
+  --- End of Memory Map.
+
+-u2 writes the same as one JSON document.
+
+  $ cat m.json
+  {"segments":[
+  {"name":"ZP","bss":true,"used":0,"fill":0,"padding":0,"reserved":7,"limit":null,"ranges":[{"start":128,"length":7}]},
+  {"name":"CODE","bss":false,"used":11,"fill":12,"padding":0,"reserved":0,"limit":null,"ranges":[{"start":61440,"length":16},{"start":61696,"length":3},{"start":65532,"length":4}]},
+  {"name":"DATA","bss":true,"used":0,"fill":0,"padding":0,"reserved":5,"limit":null,"ranges":[{"start":61694,"length":5}]}],
+  "pages":[
+  {"start":0,"used":7,"gap":{"start":0,"length":128}},
+  {"start":61440,"used":18,"gap":{"start":61456,"length":238}},
+  {"start":61696,"used":3,"gap":{"start":61699,"length":253}},
+  {"start":65280,"used":4,"gap":{"start":65280,"length":252}}],
+  "overlaps":[
+  {"segments":["DATA","CODE"],"start":61696,"length":3}]}
+
+ORG padding in formats 1 and 3 counts for the segment after it.
+
+  $ cat <<'EOF' >p.asm
+  >  processor 6502
+  >  org $1000
+  >  dc.b 1
+  >  org $1010
+  >  dc.b 2
+  > EOF
+
+  $ $TESTDIR/dasm p.asm -f1 -op.bin -u1p.txt
+  $ head -4 p.txt
+  --- Memory Map
+  segment                  used     fill     padding  reserved limit
+  INITIAL CODE SEGMENT     2        0        15       0        -
+      1000-1000 1
+
+-K limits a segment to an address range, going outside is an error.
+
+  $ $TESTDIR/dasm m.asm -f4 -om.hex -KZP='$80-$84' -KCODE=0xf000-0xffff -KNONE=1-2
+  m.asm (16): warning: Space $f100-$f102 reserved in segment 'DATA' overlaps bytes from m.asm:13 in segment 'CODE'.
+  error: Segment 'ZP' uses $0080-$0086, outside its limit $0080-$0084.
+  warning: Limit for segment 'NONE' but there's no such segment.
+  [1]
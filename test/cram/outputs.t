@@ -0,0 +1,62 @@
+DASM writes its outputs to temporary files and only puts them in place once
+they are complete. An output that comes out just like the existing file
+doesn't replace it, so its modification time stays the same and make
+doesn't rebuild anything depending on it.
+
+  $ printf ' .processor 6502\n .org 0\n .byte 1\n' >out.asm
+  $ $TESTDIR/dasm out.asm -f3 -oout.bin -lout.lst -sout.sym
+  $ touch -t 200101010000 out.bin out.lst out.sym
+  $ touch -t 200201010000 stamp
+  $ $TESTDIR/dasm out.asm -f3 -oout.bin -lout.lst -sout.sym
+  $ for f in out.bin out.lst out.sym; do [ $f -ot stamp ] && echo "$f untouched"; done
+  out.bin untouched
+  out.lst untouched
+  out.sym untouched
+
+Changed contents replace the file.
+
+  $ printf ' .processor 6502\n .org 0\n .byte 2\n' >out.asm
+  $ $TESTDIR/dasm out.asm -f3 -oout.bin
+  $ [ out.bin -nt stamp ] && echo replaced
+  replaced
+  $ od -An -tx1 out.bin
+   02
+
+If assembly is aborted the old file stays and there is no temporary file
+left behind.
+
+  $ printf ' .processor 6502\n .org 0\n .byte 3\n .err\n' >out.asm
+  $ $TESTDIR/dasm out.asm -f3 -oout.bin
+  out.asm (4): ***panic***: ERR pseudo-op encountered, aborting assembly!
+  [1]
+  $ od -An -tx1 out.bin
+   02
+  $ ls out.bin*
+  out.bin
+
+So does an ordinary error.
+
+  $ printf ' .processor 6502\n .org 0\n .byte 3\n bogus 1\n' >out.asm
+  $ $TESTDIR/dasm out.asm -f3 -oout.bin
+  out.asm (4): error: Unknown mnemonic 'bogus'!
+  [1]
+  $ od -An -tx1 out.bin
+   02
+
+An output that is a symlink replaces the file the link points to, the link
+stays. The replaced file keeps its permissions.
+
+  $ printf ' .processor 6502\n .org 0\n .byte 4\n' >out.asm
+  $ mkdir real
+  $ printf 'x' >real/out.bin
+  $ chmod 600 real/out.bin
+  $ ln -s real/out.bin link.bin
+  $ $TESTDIR/dasm out.asm -f3 -olink.bin
+  $ [ -L link.bin ] && echo link
+  link
+  $ od -An -tx1 real/out.bin
+   04
+  $ ls -l real/out.bin | cut -c1-10
+  -rw-------
+  $ ls real
+  out.bin
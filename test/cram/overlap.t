@@ -0,0 +1,41 @@
+Generating bytes at addresses something else already generated bytes
+at is an error, reported after the final pass with both lines.
+
+  $ cat <<'EOF' >o.asm
+  >  processor 6502
+  >  mac two
+  >  dc.b {1},{1}
+  >  endm
+  >  org $1000
+  >  dc.b 1,2,3,4
+  >  two 5
+  >  org $1002
+  >  dc.b 9
+  >  seg DATA
+  >  org $1005
+  >  dc.b 6,6
+  > EOF
+
+  $ $TESTDIR/dasm o.asm -f4 -oo.hex
+  o.asm (9): error: Bytes $1002-$1002 in segment 'INITIAL CODE SEGMENT' overlap bytes from o.asm:6 in segment 'INITIAL CODE SEGMENT'.
+  o.asm (12): error: Bytes $1005-$1005 in segment 'DATA' overlap bytes from o.asm:7 in segment 'INITIAL CODE SEGMENT'.
+  [1]
+
+BSS space over generated bytes is a warning, BSS segments sharing
+addresses are fine.
+
+  $ cat <<'EOF' >b.asm
+  >  processor 6502
+  >  org $f000
+  >  lda #0
+  >  seg.u RAM
+  >  org $f001
+  > a ds 2
+  >  seg.u MORE
+  >  org $f001
+  > b ds 2
+  > EOF
+
+  $ $TESTDIR/dasm b.asm -f3 -ob.bin
+  b.asm (6): warning: Space $f001-$f001 reserved in segment 'RAM' overlaps bytes from b.asm:3 in segment 'INITIAL CODE SEGMENT'.
+  b.asm (9): warning: Space $f001-$f001 reserved in segment 'MORE' overlaps bytes from b.asm:3 in segment 'INITIAL CODE SEGMENT'.
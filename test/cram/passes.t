@@ -0,0 +1,101 @@
+Sources can oscillate between two (or more) layouts: here the size of the
+LDA depends on the value of target, which depends on the size of the LDA.
+DASM notices that pass 3 ended just like pass 1 and stops right away instead
+of burning all the passes -p allows.
+
+  $ cat <<'EOF' >osc.asm
+  >  .processor 6502
+  >  .org 0
+  >  lda target
+  > after
+  > target .equ $102 - after
+  > EOF
+
+  $ $TESTDIR/dasm osc.asm
+  osc.asm (4): error: Label mismatch...
+   --> after 0002                  
+  osc.asm (5): error: EQU: Value mismatch.
+  fatal: Source is not resolvable.
+  old value: $00ff  new value: $0100
+  old value: $0100  new value: $00ff
+  --- Pass 3 ended like pass 1, passes repeat every 2.
+  --- Oscillating Symbol List
+  target                   00ff                  
+  after                    0003              (R )
+  --- 2 Oscillating Symbols
+  
+  --- Oscillating Line List
+  osc.asm (3): 2 or 3 bytes
+  --- 1 Oscillating Line 
+  
+  [1]
+
+With -R1 DASM pins the instructions that keep changing size to their larger
+encoding and tries again; this time the passes converge, and the errors from
+the passes that oscillated are gone with them.
+
+  $ $TESTDIR/dasm osc.asm -R1 -f3 -oosc.bin
+  warning: Pinned 1 oscillating instruction to the larger encoding.
+  old value: $00ff  new value: $0100
+  old value: $0100  new value: $00ff
+  --- Pass 3 ended like pass 1, passes repeat every 2.
+  --- Oscillating Symbol List
+  target                   00ff                  
+  after                    0003              (R )
+  --- 2 Oscillating Symbols
+  
+  --- Oscillating Line List
+  osc.asm (3): 2 or 3 bytes
+  --- 1 Oscillating Line 
+  
+  $ od -An -tx1 osc.bin
+   ad ff 00
+
+Instructions are told apart by where they come from, not by counting them:
+here the NOP comes and goes with the layout, and the lines reported (and
+pinned with -R1) are still the ones that change size.
+
+  $ cat <<'EOF' >ifosc.asm
+  >  .processor 6502
+  >  .org 0
+  >  if target < $100
+  >  nop
+  >  endif
+  >  lda target
+  >  ldy other
+  > after
+  >  ldx other
+  > target .equ $105 - after
+  > other .equ $105 - after
+  > EOF
+
+  $ $TESTDIR/dasm ifosc.asm
+  ifosc.asm (8): error: Label mismatch...
+   --> after 0005                  
+  ifosc.asm (10): error: EQU: Value mismatch.
+  ifosc.asm (11): error: EQU: Value mismatch.
+  fatal: Source is not resolvable.
+  old value: $00ff  new value: $0100
+  old value: $00ff  new value: $0100
+  old value: $0100  new value: $00ff
+  old value: $0100  new value: $00ff
+  --- Pass 3 ended like pass 1, passes repeat every 2.
+  --- Oscillating Symbol List
+  target                   00ff                  
+  after                    0006              (R )
+  other                    00ff                  
+  --- 3 Oscillating Symbols
+  
+  --- Oscillating Line List
+  ifosc.asm (6): 2 or 3 bytes
+  ifosc.asm (7): 2 or 3 bytes
+  ifosc.asm (9): 2 or 3 bytes
+  --- 3 Oscillating Lines
+  
+  [1]
+
+Other modes are rejected.
+
+  $ $TESTDIR/dasm osc.asm -R2
+  ***panic***: Invalid oscillation mode for -R option, must be 0 or 1
+  [1]
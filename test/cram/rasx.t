@@ -0,0 +1,43 @@
+Format 6, extended RAS, has 32-bit origins and lengths and an index of all
+segments at the end; DASM writes it front to back from the image, segments
+in the order the source started them.
+
+  $ cat <<EOF >rasx.asm
+  >  .processor 6502
+  >  .org \$12345678
+  >  .byte 1, 2
+  >  .org \$0
+  >  .byte 3
+  > EOF
+
+  $ $TESTDIR/dasm rasx.asm -f6 -orasx.out -F6again.out
+  $ od -An -tx1 rasx.out
+   52 41 53 58 02 00 00 00 78 56 34 12 02 00 00 00
+   01 02 00 00 00 00 01 00 00 00 03 78 56 34 12 02
+   00 00 00 10 00 00 00 00 00 00 00 01 00 00 00 1a
+   00 00 00 1b 00 00 00 52 41 53 58
+  $ cmp rasx.out again.out
+
+Every DASM segment fills its own part of the image, so switching segments
+back and forth doesn't split their bytes into lots of little segments.
+
+  $ cat <<'EOF' >switch.asm
+  >  processor 6502
+  >  seg A
+  >  org $1000
+  >  seg B
+  >  org $2000
+  >  repeat 3
+  >  seg A
+  >  dc.b 1
+  >  seg B
+  >  dc.b 2
+  >  repend
+  > EOF
+
+  $ $TESTDIR/dasm switch.asm -f6 -oswitch.out
+  $ od -An -tx1 switch.out
+   52 41 53 58 02 00 00 00 00 10 00 00 03 00 00 00
+   01 01 01 00 20 00 00 03 00 00 00 02 02 02 00 10
+   00 00 03 00 00 00 10 00 00 00 00 20 00 00 03 00
+   00 00 1b 00 00 00 1e 00 00 00 52 41 53 58
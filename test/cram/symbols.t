@@ -0,0 +1,55 @@
+-S writes the symbols in other formats too, as many as you like in
+one run; format 1 is what -s writes.
+
+  $ cat <<'EOF' >s.asm
+  >  processor 6502
+  >  org $1000
+  > start nop
+  > .loop jmp .loop
+  > Value = 3
+  > neg = -5
+  > Text set "a,b"
+  > EOF
+
+  $ $TESTDIR/dasm s.asm -f3 -os.bin -ss.sym -S1s1.sym -S2s.lbl -S3s.csv
+  $ cmp s.sym s1.sym
+  $ cat s.sym
+  --- Symbol List (sorted by symbol)
+  0.loop                   1001              (R )
+  neg                      fffffffffffffffb                  
+  start                    1000                  
+  Text                     612c62      str          "a,b"
+  Value                    0003                  
+  --- End of Symbol List.
+
+VICE labels only have the addresses, and only characters VICE takes.
+
+  $ cat s.lbl
+  al C:1001 .0_loop
+  al C:1000 .start
+  al C:0003 .Value
+
+CSV has the value in decimal and the flags spelled out.
+
+  $ cat s.csv
+  name,value,flags,string
+  0.loop,4097,R,
+  neg,-5,,
+  start,4096,,
+  Text,6368354,T,"a,b"
+  Value,3,,
+
+Sorting by address puts negative values first.
+
+  $ $TESTDIR/dasm s.asm -f3 -os.bin -T1 -S3s.csv
+  $ cut -d, -f1 s.csv
+  name
+  neg
+  Value
+  start
+  0.loop
+  Text
+
+  $ $TESTDIR/dasm s.asm -S4s.x
+  ***panic***: Illegal format specification for -S, must be 1, 2, or 3
+  [1]
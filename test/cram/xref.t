@@ -0,0 +1,43 @@
+-x1 writes a cross-reference: where every symbol was defined and
+referenced, then the symbols nobody uses and those used just once.
+References inside macros are where the macro was used.
+
+  $ cat <<'EOF' >x.asm
+  >  processor 6502
+  > once = 5
+  >  mac load
+  >  lda {1}
+  >  endm
+  >  org $1000
+  > start lda table,x
+  >  load table
+  >  jmp start
+  >  repeat 3
+  >  lda once
+  >  repend
+  > table .byte 1,2
+  > dead .byte 3
+  > EOF
+
+  $ $TESTDIR/dasm x.asm -f3 -ox.bin -x1x.txt -x2x.json
+  $ cat x.txt
+  --- Cross Reference
+  name                     value    defined, referenced
+  dead                     1011     x.asm:14
+  once                     0005     x.asm:2, x.asm:11
+  start                    1000     x.asm:7, x.asm:9
+  table                    100f     x.asm:13, x.asm:7 x.asm:8
+  --- 1 Unused Symbols
+  dead                     1011     x.asm:14
+  --- 2 Symbols Referenced Once
+  once                     0005     x.asm:2, x.asm:11
+  start                    1000     x.asm:7, x.asm:9
+  --- End of Cross Reference.
+
+-x2 writes the same as JSON lines.
+
+  $ cat x.json
+  {"name":"dead","value":4113,"defined":{"file":"x.asm","line":14},"references":[]}
+  {"name":"once","value":5,"defined":{"file":"x.asm","line":2},"references":[{"file":"x.asm","line":11}]}
+  {"name":"start","value":4096,"defined":{"file":"x.asm","line":7},"references":[{"file":"x.asm","line":9}]}
+  {"name":"table","value":4111,"defined":{"file":"x.asm","line":13},"references":[{"file":"x.asm","line":7},{"file":"x.asm","line":8}]}
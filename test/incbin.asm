@@ -0,0 +1,20 @@
+; INCBIN tests, borrowing c64_colors.bin.ref for the data.
+
+	processor 6502
+
+SKIP	equ 8
+
+	org $1000
+
+	jmp over		; forward reference, so we get a sizing pass
+data
+	incbin "c64_colors.bin.ref"
+	incbin c64_colors.bin.ref	; again, from the cache this time
+slice
+	incbin "c64_colors.bin.ref", 2, 3	; just the first instruction
+	incbin c64_colors.bin.ref, SKIP		; from SKIP to the end
+	incbin "c64_colors.bin.ref", 11, 0	; nothing at all
+over
+	lda data
+	lda slice
+	rts